@@ -27,7 +27,20 @@ HEADERS += \
     $$PWD/GnToken.h \
     $$PWD/GnFileCache.h \
     $$PWD/GnLexer.h \
-    $$PWD/GnCodeModel.h
+    $$PWD/GnKeywords.h \
+    $$PWD/GnCodeModel.h \
+    $$PWD/GnCst.h \
+    $$PWD/GnFormatter.h \
+    $$PWD/GnDiagnostics.h \
+    $$PWD/GnSearchIndex.h \
+    $$PWD/GnFuzzyIndex.h \
+    $$PWD/GnEvaluator.h \
+    $$PWD/GnGenerator.h \
+    $$PWD/GnCMakeGenerator.h \
+    $$PWD/GnQMakeGenerator.h \
+    $$PWD/GnNinjaGenerator.h \
+    $$PWD/GnCompDbGenerator.h \
+    $$PWD/GnConfigurations.h
 
 SOURCES += \
     $$PWD/GnParser.cpp \
@@ -37,4 +50,16 @@ SOURCES += \
     $$PWD/GnToken.cpp \
     $$PWD/GnFileCache.cpp \
     $$PWD/GnLexer.cpp \
-    $$PWD/GnCodeModel.cpp
+    $$PWD/GnCodeModel.cpp \
+    $$PWD/GnCst.cpp \
+    $$PWD/GnFormatter.cpp \
+    $$PWD/GnDiagnostics.cpp \
+    $$PWD/GnSearchIndex.cpp \
+    $$PWD/GnFuzzyIndex.cpp \
+    $$PWD/GnEvaluator.cpp \
+    $$PWD/GnGenerator.cpp \
+    $$PWD/GnCMakeGenerator.cpp \
+    $$PWD/GnQMakeGenerator.cpp \
+    $$PWD/GnNinjaGenerator.cpp \
+    $$PWD/GnCompDbGenerator.cpp \
+    $$PWD/GnConfigurations.cpp
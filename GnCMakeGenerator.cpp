@@ -0,0 +1,207 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnCMakeGenerator.h"
+#include "GnCodeModel.h"
+#include <QDir>
+#include <algorithm>
+#include <ctype.h>
+using namespace Gn;
+
+CMakeGenerator::CMakeGenerator(Evaluator* e):Generator(e)
+{
+    d_project = e->getModel()->getSourceRoot().dirName().toUtf8();
+}
+
+QByteArray CMakeGenerator::quote(const QByteArray& str)
+{
+    QByteArray res;
+    res.reserve( str.size() + 2 );
+    res += '"';
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        if( c == '"' || c == '\\' || c == '$' || c == ';' )
+            res += '\\';
+        res += c;
+    }
+    res += '"';
+    return res;
+}
+
+static QByteArray onlyFor( const char* lang, const QByteArray& flag )
+{
+    // the flag goes into a generator expression, where '>' and ',' have a meaning
+    QByteArray f = CMakeGenerator::quote(flag);
+    f = f.mid( 1, f.size() - 2 );
+    f.replace( ">", "$<ANGLE-R>" );
+    f.replace( ",", "$<COMMA>" );
+    return "\"$<$<COMPILE_LANGUAGE:" + QByteArray(lang) + ">:" + f + ">\"";
+}
+
+int CMakeGenerator::prepare()
+{
+    d_dirs.clear();
+    d_byDir.clear();
+    d_byDir["//"]; // the root file is always written
+    foreach( const Evaluator::Target* t, d_eval->getTargets() )
+        d_byDir[t->d_dir].append(t);
+    d_dirs = d_byDir.keys();
+    std::sort( d_dirs.begin(), d_dirs.end() );
+    return d_dirs.size();
+}
+
+QByteArray CMakeGenerator::header() const
+{
+    QByteArray out = "# Generated from the GN project " + d_eval->getModel()->getSourceRoot().absolutePath().toUtf8() +
+            "; do not edit\n\n";
+    out += "cmake_minimum_required(VERSION 3.13)\n";
+    QByteArray project = d_project;
+    for( int i = 0; i < project.size(); i++ )
+    {
+        if( !isalnum( (unsigned char)project[i] ) )
+            project[i] = '_';
+    }
+    out += "project(" + project + " C CXX)\n\n";
+    foreach( const QByteArray& dir, d_dirs )
+    {
+        if( dir != "//" )
+            out += "add_subdirectory(" + quote( dir.mid(2) ) + ")\n";
+    }
+    return out;
+}
+
+void CMakeGenerator::generateUnit(int i)
+{
+    const QByteArray& dir = d_dirs.at(i);
+    QByteArray out;
+    if( dir == "//" )
+        out = header();
+    else
+        out = "# Generated from " + dir + "/BUILD.gn; do not edit\n";
+    QList<const Evaluator::Target*> targets = d_byDir.value(dir);
+    foreach( const Evaluator::Target* t, targets )
+        target( out, t );
+    const QString path = dir == "//" ? d_outDir : QDir(d_outDir).absoluteFilePath( QString::fromUtf8( dir.mid(2) ) );
+    writeFile( QDir(path).absoluteFilePath("CMakeLists.txt"), out );
+}
+
+QByteArray CMakeGenerator::path(const QByteArray& sourceAbsolute) const
+{
+    return quote( d_eval->toFilePath(sourceAbsolute).toUtf8() );
+}
+
+void CMakeGenerator::target(QByteArray& out, const Evaluator::Target* t) const
+{
+    const QByteArray name = mangledName(t);
+    out += "\n# " + t->d_label + "\n";
+
+    TargetList link, order;
+    QSet<const Evaluator::Target*> visited;
+    collectDeps( t, link, order, visited );
+    QByteArrayList libs, deps;
+    foreach( const Evaluator::Target* d, link )
+        libs.append( mangledName(d) );
+    foreach( const Evaluator::Target* d, order )
+        deps.append( mangledName(d) );
+
+    if( !d_eval->isBinary(t) )
+    {
+        out += "add_custom_target(" + name + ")\n";
+        libs += deps;
+        if( !libs.isEmpty() )
+            out += "add_dependencies(" + name + " " + libs.join(' ') + ")\n";
+        return;
+    }
+
+    const char* kind = "";
+    if( t->d_type == d_eval->getSymbol("static_library") )
+        kind = " STATIC";
+    else if( t->d_type == d_eval->getSymbol("shared_library") )
+        kind = " SHARED";
+    else if( t->d_type == d_eval->getSymbol("loadable_module") )
+        kind = " MODULE";
+    else if( t->d_type == d_eval->getSymbol("source_set") )
+        kind = " OBJECT";
+    if( t->d_type == d_eval->getSymbol("executable") )
+        out += "add_executable(" + name;
+    else
+        out += "add_library(" + name + kind;
+    foreach( const QByteArray& s, d_eval->getSources(t) )
+        out += "\n    " + path(s);
+    out += ")\n";
+
+    const QByteArray outputName = t->getString(d_eval->getSymbol("output_name"));
+    if( !outputName.isEmpty() )
+        out += "set_target_properties(" + name + " PROPERTIES OUTPUT_NAME " + quote(outputName) + ")\n";
+
+    const Evaluator::Flags f = d_eval->getFlags(t);
+    if( !f.d_includeDirs.isEmpty() )
+    {
+        out += "target_include_directories(" + name + " PRIVATE";
+        foreach( const QByteArray& d, f.d_includeDirs )
+            out += "\n    " + path(d);
+        out += ")\n";
+    }
+    if( !f.d_defines.isEmpty() )
+    {
+        out += "target_compile_definitions(" + name + " PRIVATE";
+        foreach( const QByteArray& d, f.d_defines )
+            out += "\n    " + quote(d);
+        out += ")\n";
+    }
+    if( !f.d_cflags.isEmpty() || !f.d_cflagsC.isEmpty() || !f.d_cflagsCC.isEmpty() || !f.d_asmflags.isEmpty() )
+    {
+        out += "target_compile_options(" + name + " PRIVATE";
+        foreach( const QByteArray& o, f.d_cflags )
+            out += "\n    " + quote(o);
+        foreach( const QByteArray& o, f.d_cflagsC )
+            out += "\n    " + onlyFor("C",o);
+        foreach( const QByteArray& o, f.d_cflagsCC )
+            out += "\n    " + onlyFor("CXX",o);
+        foreach( const QByteArray& o, f.d_asmflags )
+            out += "\n    " + onlyFor("ASM",o);
+        out += ")\n";
+    }
+    foreach( const QByteArray& l, f.d_libs )
+        libs.append( l.startsWith("//") ? path(l) : quote(l) );
+    if( !libs.isEmpty() )
+    {
+        out += "target_link_libraries(" + name + " PRIVATE";
+        foreach( const QByteArray& l, libs )
+            out += "\n    " + l;
+        out += ")\n";
+    }
+    if( !f.d_libDirs.isEmpty() )
+    {
+        out += "target_link_directories(" + name + " PRIVATE";
+        foreach( const QByteArray& d, f.d_libDirs )
+            out += "\n    " + path(d);
+        out += ")\n";
+    }
+    if( !f.d_ldflags.isEmpty() )
+    {
+        out += "target_link_options(" + name + " PRIVATE";
+        foreach( const QByteArray& o, f.d_ldflags )
+            out += "\n    " + quote(o);
+        out += ")\n";
+    }
+    if( !deps.isEmpty() )
+        out += "add_dependencies(" + name + " " + deps.join(' ') + ")\n";
+}
@@ -0,0 +1,58 @@
+#ifndef GNCMAKEGENERATOR_H
+#define GNCMAKEGENERATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnGenerator.h>
+
+/*
+ *  Writes a CMakeLists.txt per source dir with targets to the output dir, mirroring the source tree;
+ *  the one of the root dir also holds the project and the add_subdirectory calls
+ *  - Each dir is a unit, so the dirs are written in parallel
+ *  - Sources and include dirs are absolute paths into the source tree
+ *  - Flags are those of the target and all configs applying to it (see Evaluator::getAllConfigs);
+ *    they are set PRIVATE since the propagation was already done by the Evaluator
+ *  - Targets other than binaries (group, action, copy etc.) become custom targets with dependencies only
+ *  - CMake target names are made from the labels, e.g. "//base/util:strings" -> "base_util_strings"
+*/
+
+namespace Gn
+{
+    class CMakeGenerator : public Generator
+    {
+    public:
+        explicit CMakeGenerator( Evaluator* );
+        void setProjectName( const QByteArray& name ) { d_project = name; }
+
+        static QByteArray quote( const QByteArray& );
+    protected:
+        int prepare();
+        void generateUnit( int );
+        QByteArray header() const;
+        void target( QByteArray& out, const Evaluator::Target* ) const;
+        QByteArray path( const QByteArray& sourceAbsolute ) const;
+    private:
+        QByteArrayList d_dirs; // with targets, sorted, the root dir first
+        QHash<QByteArray,QList<const Evaluator::Target*> > d_byDir;
+        QByteArray d_project;
+    };
+}
+
+#endif // GNCMAKEGENERATOR_H
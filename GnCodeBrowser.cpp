@@ -22,26 +22,31 @@
 #include "GnCodeModel.h"
 #include "GnSynTree.h"
 #include <QApplication>
+#include <QScrollBar>
+#include <QToolTip>
+#include <QFile>
 #include <QtDebug>
 using namespace Gn;
 
-CodeBrowser::CodeBrowser(CodeModel* mdl, QWidget* p):QPlainTextEdit(p),d_goto(0),d_mdl(mdl),d_pushBackLock(false),d_cur(0)
+CodeBrowser::CodeBrowser(CodeModel* mdl, QWidget* p):QPlainTextEdit(p),d_goto(0),d_mdl(mdl),d_pushBackLock(false),d_cur(0),d_hl(0)
 {
     setReadOnly(true);
     setLineWrapMode( QPlainTextEdit::NoWrap );
     setTabStopWidth( 30 );
     setTabChangesFocus(true);
     setMouseTracking(true);
-    new Highlighter( mdl, document() );
+    d_hl = new Highlighter( mdl, document() );
     QFont f;
     f.setStyleHint( QFont::TypeWriter );
     f.setFamily("Mono");
     f.setPointSize(9);
     setFont(f);
+    connect( verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(onScrolled()) );
 }
 
 void CodeBrowser::clear()
 {
+    d_hl->setSourcePath(QByteArray());
     QPlainTextEdit::clear();
     d_sourcePath.clear();
     d_cur = 0;
@@ -51,6 +56,9 @@ void CodeBrowser::clear()
     d_goto = 0;
     d_nonTerms.clear();
     d_find.clear();
+    d_outcomes.clear();
+    d_dead.clear();
+    d_instances.clear();
 }
 
 bool CodeBrowser::loadFile(const QByteArray& path)
@@ -63,35 +71,74 @@ bool CodeBrowser::loadFile(const QByteArray& path)
     d_goto = 0;
     d_nonTerms.clear();
     d_find.clear();
-    QFile in(QString::fromUtf8(d_sourcePath));
-    if( !in.open(QIODevice::ReadOnly) )
+    // the model parsed from the same bytes; the cache only reads the file again if it changed on disk
+    bool ok;
+    const QByteArray content = d_mdl->getFileCache()->readFile( QString::fromUtf8(d_sourcePath), &ok );
+    if( !ok )
         return false;
-    setPlainText( QString::fromLatin1(in.readAll()) );
+    const QString text = QString::fromUtf8(content);
+    // only the first screen is highlighted while the text is set, onScrolled does the rest on demand;
+    // the range is set first, since blocks of the old text it reaches are highlighted right away and
+    // must not take the tokens of the new file for their own
+    d_hl->setVisibleRange( 0, viewport()->height() / qMax( 1, fontMetrics().height() ) );
+    d_hl->setSourcePath(path);
+    setPlainText( text );
     moveCursor(QTextCursor::Start);
+    findDeadLines();
     emit sigShowFile(path);
     return true;
 }
 
+SynTree* CodeBrowser::symbolAt(const QTextCursor& cur) const
+{
+    return d_mdl->findSymbolBySourcePos(d_sourcePath,cur.blockNumber() + 1,
+                                        Highlighter::toBytePos( cur.block().text(), cur.positionInBlock() ) + 1 );
+}
+
+QTextCursor CodeBrowser::selectToken(quint32 line, quint16 col, int len) const
+{
+    const QTextBlock block = document()->findBlockByNumber( line - 1 );
+    const QString text = block.text();
+    const int start = Highlighter::toCharPos( text, col - 1 );
+    QTextCursor c( block );
+    c.setPosition( block.position() + start );
+    c.setPosition( block.position() + Highlighter::toCharPos( text, col - 1 + len ), QTextCursor::KeepAnchor );
+    return c;
+}
+
+void CodeBrowser::resizeEvent(QResizeEvent* e)
+{
+    QPlainTextEdit::resizeEvent(e);
+    onScrolled();
+}
+
+void CodeBrowser::onScrolled()
+{
+    const QTextBlock first = firstVisibleBlock();
+    if( !first.isValid() )
+        return;
+    const int lines = viewport()->height() / qMax( 1, fontMetrics().height() );
+    d_hl->setVisibleRange( first.blockNumber(), first.blockNumber() + lines );
+    if( !d_dead.isEmpty() )
+        updateExtraSelections(); // the dead lines only come as far as they are visible
+}
+
 void CodeBrowser::mouseMoveEvent(QMouseEvent* e)
 {
     QPlainTextEdit::mouseMoveEvent(e);
     if( QApplication::keyboardModifiers() == Qt::ControlModifier )
     {
         QTextCursor cur = cursorForPosition(e->pos());
-        SynTree* id = d_mdl->findSymbolBySourcePos(d_sourcePath,cur.blockNumber() + 1,
-                                                                      cur.positionInBlock() + 1);
+        SynTree* id = symbolAt(cur);
         const bool alreadyArrow = !d_link.isEmpty();
         d_link.clear();
         if( id )
         {
-            const int off = cur.positionInBlock() + 1 - id->d_tok.d_colNr;
-            cur.setPosition(cur.position() - off);
-            cur.setPosition( cur.position() + id->d_tok.d_len, QTextCursor::KeepAnchor );
             d_goto = d_mdl->findDefinition(id);
             if( d_goto )
             {
                 QTextEdit::ExtraSelection sel;
-                sel.cursor = cur;
+                sel.cursor = selectToken( id->d_tok.d_lineNr, id->d_tok.d_colNr, id->d_tok.d_len );
                 sel.format.setFontUnderline(true);
                 d_link << sel;
                 if( !alreadyArrow )
@@ -112,7 +159,7 @@ void CodeBrowser::mouseMoveEvent(QMouseEvent* e)
 void CodeBrowser::mousePressEvent(QMouseEvent* e)
 {
     QTextCursor cur = cursorForPosition(e->pos());
-    d_cur = d_mdl->findSymbolBySourcePos(d_sourcePath,cur.blockNumber() + 1,cur.positionInBlock() + 1);
+    d_cur = symbolAt(cur);
     pushLocation( d_cur );
     if( !d_link.isEmpty() )
     {
@@ -139,6 +186,26 @@ void CodeBrowser::updateExtraSelections()
 {
     ESL sum;
 
+    const QTextBlock first = firstVisibleBlock();
+    if( !d_dead.isEmpty() && first.isValid() )
+    {
+        const int from = first.blockNumber();
+        const int to = from + viewport()->height() / qMax( 1, fontMetrics().height() );
+        QTextEdit::ExtraSelection dead;
+        dead.format.setForeground(Qt::gray);
+        dead.format.setBackground(QColor(247,247,247));
+        dead.format.setProperty(QTextFormat::FullWidthSelection, true);
+        foreach( const LineRange& r, d_dead )
+        {
+            for( int i = qMax( r.first, from ); i <= qMin( r.second, to ); i++ )
+            {
+                dead.cursor = QTextCursor( document()->findBlockByNumber(i) );
+                dead.cursor.movePosition( QTextCursor::EndOfBlock, QTextCursor::KeepAnchor );
+                sum << dead;
+            }
+        }
+    }
+
     QTextEdit::ExtraSelection line;
     line.format.setBackground(QColor(Qt::yellow).lighter(180));
     line.format.setProperty(QTextFormat::FullWidthSelection, true);
@@ -150,10 +217,7 @@ void CodeBrowser::updateExtraSelections()
     {
         QTextEdit::ExtraSelection line;
         line.format.setBackground(QColor(Qt::yellow).lighter(120));
-        line.cursor = textCursor();
-        line.cursor.setPosition(document()->findBlockByNumber(d_cur->d_tok.d_lineNr - 1).position() +
-                                d_cur->d_tok.d_colNr - 1 );
-        line.cursor.setPosition( line.cursor.position() + d_cur->d_tok.d_len, QTextCursor::KeepAnchor);
+        line.cursor = selectToken( d_cur->d_tok.d_lineNr, d_cur->d_tok.d_colNr, d_cur->d_tok.d_len );
         sum << line;
     }
 
@@ -205,7 +269,6 @@ void CodeBrowser::setCursorPosition(SynTree* id, bool center, bool pushLoc)
     if( id == 0 )
         return;
     const int line = id->d_tok.d_lineNr - 1;
-    const int col = id->d_tok.d_colNr;
     loadFile( id->d_tok.d_sourcePath );
     d_cur = id;
     // Qt-Koordinaten
@@ -213,7 +276,7 @@ void CodeBrowser::setCursorPosition(SynTree* id, bool center, bool pushLoc)
     {
         QTextBlock block = document()->findBlockByNumber(line);
         QTextCursor cur = textCursor();
-        cur.setPosition( block.position() + col );
+        cur.setPosition( block.position() + Highlighter::toCharPos( block.text(), id->d_tok.d_colNr - 1 ) + 1 );
         if( pushLoc )
             pushLocation( id );
         setTextCursor( cur );
@@ -235,7 +298,7 @@ void CodeBrowser::setCursorPosition(int line, int col, bool center, int sel)
         cur.setPosition( block.position() + col );
         if( sel > 0 )
             cur.setPosition( block.position() + col + sel, QTextCursor::KeepAnchor );
-        d_cur = d_mdl->findSymbolBySourcePos(d_sourcePath,line+1,col+1);
+        d_cur = d_mdl->findSymbolBySourcePos(d_sourcePath,line+1,Highlighter::toBytePos( block.text(), col ) + 1);
         pushLocation( d_cur );
         setTextCursor( cur );
         if( center )
@@ -255,7 +318,7 @@ void CodeBrowser::setCursorPosition(const QByteArray& file, int line, int col, b
         QTextBlock block = document()->findBlockByNumber(line);
         QTextCursor cur = textCursor();
         cur.setPosition( block.position() + col );
-        d_cur = d_mdl->findSymbolBySourcePos(d_sourcePath,line+1,col+1);
+        d_cur = d_mdl->findSymbolBySourcePos(d_sourcePath,line+1,Highlighter::toBytePos( block.text(), col ) + 1);
         pushLocation( d_cur );
         setTextCursor( cur );
         if( center )
@@ -273,19 +336,109 @@ void CodeBrowser::markNonTerms(const QList<const SynTree*>& s)
     format.setBackground( QColor(247,245,243).darker(110) );
     foreach( const SynTree* n, s )
     {
-        QTextCursor c( document()->findBlockByNumber( n->d_tok.d_lineNr - 1) );
-        c.setPosition( c.position() + n->d_tok.d_colNr - 1 );
-        c.setPosition( c.position() + n->d_tok.d_val.size(), QTextCursor::KeepAnchor );
-
         QTextEdit::ExtraSelection sel;
         sel.format = format;
-        sel.cursor = c;
+        sel.cursor = selectToken( n->d_tok.d_lineNr, n->d_tok.d_colNr, n->d_tok.d_val.size() );
 
         d_nonTerms << sel;
     }
     updateExtraSelections();
 }
 
+void CodeBrowser::setOutcomes(const Evaluator::OutcomesByFile& o)
+{
+    d_outcomes = o;
+    findDeadLines();
+    updateExtraSelections();
+}
+
+void CodeBrowser::setInstances(const CodeBrowser::Instances& i)
+{
+    d_instances = i;
+}
+
+bool CodeBrowser::viewportEvent(QEvent* e)
+{
+    if( e->type() == QEvent::ToolTip && !d_instances.isEmpty() )
+    {
+        QHelpEvent* h = static_cast<QHelpEvent*>(e);
+        Instances::const_iterator i = d_instances.constFind( symbolAt( cursorForPosition(h->pos()) ) );
+        if( i != d_instances.constEnd() )
+            QToolTip::showText( h->globalPos(), QString::fromUtf8( i.value().join('\n') ), viewport() );
+        else
+            QToolTip::hideText();
+        return true;
+    }
+    return QPlainTextEdit::viewportEvent(e);
+}
+
+void CodeBrowser::findDeadLines()
+{
+    d_dead.clear();
+    if( d_sourcePath.isEmpty() || d_outcomes.isEmpty() )
+        return;
+    const CodeModel::Scope* sc = d_mdl->getScope(d_sourcePath);
+    if( sc == 0 || sc->d_st == 0 )
+        return;
+    // the outcomes are keyed by the symbol of the path, which is the same in all tokens of the file
+    const Evaluator::OutcomesByFile::const_iterator i =
+            d_outcomes.find( sc->d_st->d_tok.d_sourcePath.constData() );
+    if( i == d_outcomes.end() )
+        return;
+    findDeadLines( sc->d_st, i.value() );
+}
+
+void CodeBrowser::findDeadLines(const SynTree* st, const Evaluator::Outcomes& o)
+{
+    if( st->d_tok.d_type == SynTree::R_Condition )
+    {
+        Evaluator::Outcomes::const_iterator i = o.find(st);
+        if( i != o.end() )
+        {
+            // conditions never reached (e.g. in a template which is not used) are left alone
+            const quint8 taken = i.value();
+            if( ( taken & Evaluator::ThenTaken ) == 0 )
+                addDeadBlock( st->d_children[4] );
+            else
+                findDeadLines( st->d_children[4], o );
+            if( st->d_children.size() > 6 )
+            {
+                if( ( taken & Evaluator::ElseTaken ) == 0 )
+                    addDeadBranch( st->d_children[6] );
+                else
+                    findDeadLines( st->d_children[6], o );
+            }
+            return;
+        }
+    }
+    foreach( const SynTree* sub, st->d_children )
+        findDeadLines( sub, o );
+}
+
+void CodeBrowser::addDeadBlock(const SynTree* block)
+{
+    if( block->d_tok.d_type != SynTree::R_Block || block->d_children.size() < 2 )
+        return;
+    // only the lines between the braces; the braces share their lines with live code
+    const int first = block->d_children.first()->d_tok.d_lineNr; // the line after '{', zero based
+    const int last = block->d_children.last()->d_tok.d_lineNr - 2; // the line before '}'
+    if( first <= last )
+        d_dead.append( LineRange( first, last ) );
+}
+
+void CodeBrowser::addDeadBranch(const SynTree* st)
+{
+    if( st->d_tok.d_type == SynTree::R_Block )
+        addDeadBlock( st );
+    else
+    {
+        // a whole else-if chain
+        addDeadBlock( st->d_children[4] );
+        if( st->d_children.size() > 6 )
+            addDeadBranch( st->d_children[6] );
+    }
+}
+
 void CodeBrowser::find(const QString& str, bool fromTop)
 {
     d_find = str;
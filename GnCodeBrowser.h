@@ -21,11 +21,13 @@
 */
 
 #include <QPlainTextEdit>
+#include <GnTools/GnEvaluator.h>
 
 namespace Gn
 {
     class SynTree;
     class CodeModel;
+    class Highlighter;
 
     class CodeBrowser : public QPlainTextEdit
     {
@@ -43,6 +45,9 @@ namespace Gn
         void setCursorPosition(int line, int col, bool center, int sel = -1 );
         void setCursorPosition(const QByteArray& file, int line, int col, bool center );
         void markNonTerms(const QList<const SynTree*>& s);
+        void setOutcomes( const Evaluator::OutcomesByFile& ); // greys out the branches never taken
+        typedef QHash<const SynTree*,QByteArrayList> Instances; // name of a template invocation -> labels
+        void setInstances( const Instances& ); // shown as tool tip of the invocation
         SynTree* getCur() const { return d_cur; }
         const QByteArray& getSourcePath() const { return d_sourcePath; }
         void find( const QString&, bool fromTop = true );
@@ -54,9 +59,20 @@ namespace Gn
     protected:
         void mouseMoveEvent(QMouseEvent* e);
         void mousePressEvent(QMouseEvent* e);
+        void resizeEvent(QResizeEvent* e);
+        bool viewportEvent(QEvent* e);
 
         bool loadFile( const QByteArray& path );
         void find( bool fromTop );
+        SynTree* symbolAt( const QTextCursor& ) const;
+        QTextCursor selectToken( quint32 line, quint16 col, int len ) const;
+        void findDeadLines();
+        void findDeadLines( const SynTree*, const Evaluator::Outcomes& );
+        void addDeadBlock( const SynTree* );
+        void addDeadBranch( const SynTree* condition );
+
+    protected slots:
+        void onScrolled();
 
     private:
         CodeModel* d_mdl;
@@ -65,11 +81,16 @@ namespace Gn
         ESL d_link;
         SynTree* d_goto;
         ESL d_nonTerms;
+        Evaluator::OutcomesByFile d_outcomes;
+        typedef QPair<int,int> LineRange; // first and last block number
+        QList<LineRange> d_dead; // in d_sourcePath
+        Instances d_instances;
         QString d_find;
         SynTree* d_cur;
         QList<SynTree*> d_backHisto; // d_backHisto.last() ist aktuell angezeigtes Objekt
         QList<SynTree*> d_forwardHisto;
         bool d_pushBackLock;
+        Highlighter* d_hl;
     };
 }
 
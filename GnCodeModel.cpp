@@ -205,10 +205,40 @@ static QStringList collectBuildFiles( const QDir& dir )
     return res;
 }
 
-CodeModel::CodeModel(QObject *parent) : QObject(parent)
+static SynTree* findAssigned( SynTree* stmts, const char* name )
+{
+    // the expression last assigned to name at the top level of a file
+    SynTree* res = 0;
+    if( stmts == 0 )
+        return res;
+    foreach( SynTree* s, stmts->d_children )
+    {
+        if( s->d_tok.d_type != SynTree::R_Statement || s->d_children.isEmpty() )
+            continue;
+        SynTree* a = s->d_children.first();
+        if( a->d_tok.d_type == SynTree::R_Assignment && a->d_children.size() == 3 &&
+                a->d_children.first()->d_children.size() == 1 &&
+                a->d_children.first()->d_children.first()->d_tok.d_val.constData() == name )
+            res = a->d_children.last();
+    }
+    return res;
+}
+
+static bool lessUse( const CodeModel::Edge& lhs, const CodeModel::Edge& rhs )
+{
+    return lhs.d_use < rhs.d_use;
+}
+
+static bool lessDef( const CodeModel::Edge& lhs, const CodeModel::Edge& rhs )
+{
+    return lhs.d_def < rhs.d_def;
+}
+
+CodeModel::CodeModel(QObject *parent) : QObject(parent),d_condDepth(0)
 {
     d_errs = new Errors(this);
     d_errs->setReportToConsole(true);
+    d_fcache = new FileCache(this);
 
 }
 
@@ -236,8 +266,33 @@ bool CodeModel::parseDir(const QDir& dir)
     // qDebug() << "####" << files.size() << "files to parse in" << d_sourceRoot.absolutePath();
     foreach( const QString& f, files )
     {
-        parseFile(f);
+        Scope* s = parseFile(f);
+        d_errs->flush(); // diagnostics of each file are reported as soon as it is parsed
+        if( f == dotfile && s != 0 )
+        {
+            // the build config scope encloses all other files, so it is parsed next
+            SynTree* bc = flatten( findAssigned( s->d_st, Lexer::getSymbol("buildconfig").constData() ) );
+            if( bc != 0 && bc->d_tok.d_type == Tok_string )
+            {
+                const QString path = calcPath(bc);
+                if( !path.isEmpty() )
+                {
+                    d_buildConfig = Lexer::getSymbol(path.toUtf8());
+                    parseFile(path);
+                    d_errs->flush();
+                }
+            }
+        }
     }
+    resolveInvokers();
+    d_byDef = d_byUse;
+    std::sort( d_byUse.begin(), d_byUse.end(), lessUse );
+    std::sort( d_byDef.begin(), d_byDef.end(), lessDef );
+    d_kills.clear();
+    d_forwarders.clear();
+    d_argScopes.clear();
+    d_viaInvoker.clear();
+    d_fuzzy.build(this);
     return d_errs->getErrCount() == 0;
 }
 
@@ -333,6 +388,26 @@ SynTree*CodeModel::findDefinition(const SynTree* st)
     return 0;
 }
 
+CodeModel::SynTreeList CodeModel::getDefs(const SynTree* use) const
+{
+    SynTreeList res;
+    const Edge key( const_cast<SynTree*>(use) );
+    Edges::const_iterator i = std::lower_bound( d_byUse.begin(), d_byUse.end(), key, lessUse );
+    for( ; i != d_byUse.end() && (*i).d_use == use; ++i )
+        res.append( (*i).d_def );
+    return res;
+}
+
+CodeModel::SynTreeList CodeModel::getUses(const SynTree* def) const
+{
+    SynTreeList res;
+    const Edge key( 0, const_cast<SynTree*>(def) );
+    Edges::const_iterator i = std::lower_bound( d_byDef.begin(), d_byDef.end(), key, lessDef );
+    for( ; i != d_byDef.end() && (*i).d_def == def; ++i )
+        res.append( (*i).d_use );
+    return res;
+}
+
 QByteArrayList CodeModel::getFileList() const
 {
     QByteArrayList res;
@@ -421,9 +496,13 @@ void CodeModel::clear()
     d_import = Lexer::getSymbol("import").constData();
     d_fileKind = Lexer::getSymbol("file");
     d_declare_args = Lexer::getSymbol("declare_args");
+    d_template = Lexer::getSymbol("template").constData();
+    d_invoker = Lexer::getSymbol("invoker").constData();
+    d_forward = Lexer::getSymbol("forward_variables_from").constData();
 
     d_allRhs.clear();
     d_allLhs.clear();
+    d_defs.clear();
     d_allObjDefs.clear();
     d_allFuncRefs.clear();
     d_allImports.clear();
@@ -431,6 +510,17 @@ void CodeModel::clear()
     d_allUnnamedObjs.clear();
     d_unresolvedRefs.clear();
     d_declaredArgs.clear();
+    d_buildConfig.clear();
+    d_byUse.clear();
+    d_byDef.clear();
+    d_mods.clear();
+    d_condDepth = 0;
+    d_kills.clear();
+    d_forwarders.clear();
+    d_argScopes.clear();
+    d_viaInvoker.clear();
+    d_search.clear();
+    d_fuzzy.clear();
 }
 
 CodeModel::Scope* CodeModel::parseFile(const QString& path, bool viaImport)
@@ -440,16 +530,23 @@ CodeModel::Scope* CodeModel::parseFile(const QString& path, bool viaImport)
     if( i != d_files.end() )
         return &i.value();
 
-    QFile in( path );
-    if( !in.open(QIODevice::ReadOnly) )
+    bool ok;
+    // unchanged files are served from the cache when the same tree is parsed again
+    const QByteArray content = d_fcache->readFile( path, &ok );
+    if( !ok )
     {
         d_errs->warning( Errors::Lexer, path, 0, 0, tr("cannot open file for reading") );
         return 0;
     }
 //    qDebug() << "*** parsing file" << ( d_files.size() + 1 ) << d_sourceRoot.relativeFilePath(path) <<
 //                ( viaImport ? "via import" : "" );
+    // the same bytes feed the lexer and the search index
+    d_search.addFile( pathSym, content );
+    QBuffer buf;
+    buf.setData( content );
+    buf.open(QIODevice::ReadOnly);
     Gn::Lexer lex;
-    lex.setStream( &in, path );
+    lex.setStream( &buf, path );
     lex.setErrors(d_errs);
     lex.setIgnoreComments(false);
     lex.setPackComments(true);
@@ -533,7 +630,7 @@ void CodeModel::loop_(SynTree* st, CodeModel::Scope* scope)
 {
     if( st->d_children[2]->d_tok.d_type == Tok_Rpar || st->d_children.last()->d_tok.d_type != SynTree::R_Block )
     {
-        d_errs->error(Errors::Syntax,st,tr("invalid foreach statement") );
+        d_errs->error(Errors::Syntax,st,Errors::Msg("invalid foreach statement") );
         return;
     }
     Q_ASSERT( st->d_children[2]->d_tok.d_type == SynTree::R_ExprList && st->d_children.size() == 5
@@ -541,21 +638,26 @@ void CodeModel::loop_(SynTree* st, CodeModel::Scope* scope)
 
     if( st->d_children[2]->d_children.size() != 2 )
     {
-        d_errs->error(Errors::Syntax,st,tr("invalid expression list in foreach statement") );
+        d_errs->error(Errors::Syntax,st,Errors::Msg("invalid expression list in foreach statement") );
         return;
     }
 
+    expr( st->d_children[2]->d_children.last(), scope );
+
     SynTree* var = flatten(st->d_children[2]->d_children.first() );
     if( var->d_tok.d_type != Tok_identifier )
     {
-        d_errs->error(Errors::Syntax,st,tr("invalid loop variable in foreach statement") );
+        d_errs->error(Errors::Syntax,st,Errors::Msg("invalid loop variable in foreach statement") );
     }else
+    {
         d_allLhs[var->d_tok.d_val.constData()].append(var);
+        d_defs.insert(var);
+        scope->d_lhs[var->d_tok.d_val.constData()].append(var); // so the uses in the body reach it
+    }
 
-    expr( st->d_children[2]->d_children.last(), scope );
-
-    // TODO: muss man var irgendwie in den scope bringen?
+    d_condDepth++; // the body might not run at all
     block( st->d_children.last(), scope );
+    d_condDepth--;
 }
 
 void CodeModel::import_(SynTree* st, CodeModel::Scope* sc)
@@ -569,7 +671,7 @@ void CodeModel::import_(SynTree* st, CodeModel::Scope* sc)
 
     if( st->d_children[2]->d_tok.d_type == Tok_Rpar )
     {
-        d_errs->error(Errors::Syntax,st,tr("invalid import statement") );
+        d_errs->error(Errors::Syntax,st,Errors::Msg("invalid import statement") );
         return;
     }
     Q_ASSERT( st->d_children[2]->d_tok.d_type == SynTree::R_ExprList && !st->d_children[2]->d_children.isEmpty() );
@@ -597,7 +699,7 @@ void CodeModel::import_(SynTree* st, CodeModel::Scope* sc)
                         sc->d_relovedImports.insert(res->d_name.constData(),res);
                     }
                 }else
-                    d_errs->warning(Errors::Semantics, ref, tr("import file doesn't exist: %1").arg(path));
+                    d_errs->warning(Errors::Semantics, ref, Errors::Msg("import file doesn't exist: %1", path.toUtf8()));
             }
         }
     }else
@@ -843,6 +945,7 @@ void CodeModel::condition_(SynTree* st, CodeModel::Scope* scope)
 {
     Q_ASSERT( st->d_tok.d_type == SynTree::R_Condition && st->d_children.size() >= 5 );
     expr( st->d_children[2], scope );
+    d_condDepth++;
     block( st->d_children[4], scope );
     if( st->d_children.size() > 5 )
     {
@@ -852,6 +955,7 @@ void CodeModel::condition_(SynTree* st, CodeModel::Scope* scope)
         else
             block( st->d_children[6], scope );
     }
+    d_condDepth--;
 }
 
 void CodeModel::assignment_(SynTree* st, CodeModel::Scope* sc)
@@ -859,11 +963,13 @@ void CodeModel::assignment_(SynTree* st, CodeModel::Scope* sc)
     Q_ASSERT( st != 0 && st->d_children.size() == 3 && st->d_children.first()->d_tok.d_type == SynTree::R_LValue &&
             st->d_children[1]->d_tok.d_type == SynTree::R_AssignOp &&
               st->d_children.last()->d_tok.d_type == SynTree::R_Expr );
-    lvalue( st->d_children.first(), sc );
+    // the right side is evaluated first, so only the defs before the assignment reach it
     expr( st->d_children.last(), sc );
+    SynTree* op = firstToken( st->d_children[1] );
+    lvalue( st->d_children.first(), sc, op != 0 ? int(op->d_tok.d_type) : int(Tok_Eq) );
 }
 
-void CodeModel::lvalue(SynTree* st, CodeModel::Scope* sc)
+void CodeModel::lvalue(SynTree* st, CodeModel::Scope* sc, int op)
 {
     Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_LValue && !st->d_children.isEmpty()
             && st->d_children.first()->d_tok.d_type == Tok_identifier );
@@ -875,7 +981,7 @@ void CodeModel::lvalue(SynTree* st, CodeModel::Scope* sc)
         if( st->d_children[1]->d_tok.d_type == Tok_Lbrack ) // ArrayAccess
         {
             Q_ASSERT( st->d_children.size() == 4 && st->d_children[3]->d_tok.d_type == Tok_Rbrack );
-            varLhs(id,sc);
+            varLhs(id,sc,true);
             expr( st->d_children[2], sc );
         }else if( st->d_children[1]->d_tok.d_type == Tok_Dot ) // ScopeAccess
         {
@@ -885,7 +991,11 @@ void CodeModel::lvalue(SynTree* st, CodeModel::Scope* sc)
         }else
             Q_ASSERT( false );
     }else // plain ident
-        varLhs(id,sc);
+    {
+        varLhs(id,sc,op != Tok_Eq);
+        if( op == Tok_Eq && d_condDepth == 0 )
+            d_kills.insert(id);
+    }
 }
 
 void CodeModel::primaryExpr(SynTree* st, CodeModel::Scope* sc)
@@ -906,7 +1016,9 @@ void CodeModel::primaryExpr(SynTree* st, CodeModel::Scope* sc)
         break;
     case SynTree::R_Scope_:
         Q_ASSERT( !st->d_children.first()->d_children.isEmpty() );
+        d_condDepth++; // the defs of the literal don't hide those of the enclosing scope
         block( st->d_children.first()->d_children.first(), sc ); // TODO: neuer scope?
+        d_condDepth--;
         break;
     case Tok_identifier:
         varRhs(st->d_children.first(), sc);
@@ -971,7 +1083,7 @@ void CodeModel::string(SynTree* st, CodeModel::Scope* sc)
                 const int pos2 = str.indexOf('}', pos+1 );
                 if( pos2 == -1 )
                 {
-                    d_errs->error(Errors::Syntax, st, tr("'${' without terminating '}'") );
+                    d_errs->error(Errors::Syntax, st, Errors::Msg("'${' without terminating '}'") );
                     return;
                 }else
                 {
@@ -1026,27 +1138,160 @@ void CodeModel::scopeAccess(SynTree* st, CodeModel::Scope* sc)
     Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_ScopeAccess && st->d_children.size() == 3
             && st->d_children[1]->d_tok.d_type == Tok_Dot );
     varRhs( st->d_children.first(), sc );
-    varRhs( st->d_children.last(), sc ); // meistens invoker.name
+    varRhs( st->d_children.last(), sc, st->d_children.first() ); // meistens invoker.name
 }
 
-void CodeModel::varRhs(SynTree* st, CodeModel::Scope* sc)
+void CodeModel::varRhs(SynTree* st, CodeModel::Scope* sc, SynTree* outer)
 {
     Q_ASSERT( st != 0 && st->d_tok.d_type == Tok_identifier );
 
     sc->d_rhs[st->d_tok.d_val.constData()].append(st);
     d_allRhs[st->d_tok.d_val.constData()].append(st);
+    if( outer == 0 )
+        resolve(st,sc);
+    else if( outer->d_tok.d_val.constData() == d_invoker )
+    {
+        Scope* t = sc;
+        while( t != 0 && t->d_kind.constData() != d_template )
+            t = t->d_outer;
+        if( t != 0 )
+            d_viaInvoker.append( qMakePair(st,t) );
+    } // else a member of a scope value, which stays unresolved
 }
 
-void CodeModel::varLhs(SynTree* st, CodeModel::Scope* sc)
+void CodeModel::varLhs(SynTree* st, CodeModel::Scope* sc, bool reads)
 {
     Q_ASSERT( st != 0 && st->d_tok.d_type == Tok_identifier );
 
+    if( reads )
+    {
+        // += and -= read the value they modify
+        d_mods.insert(st);
+        resolve(st,sc);
+    }
     sc->d_lhs[st->d_tok.d_val.constData()].append(st);
     d_allLhs[st->d_tok.d_val.constData()].append(st);
+    d_defs.insert(st);
     if( sc->d_kind == d_declare_args )
         d_declaredArgs.append(st);
 }
 
+void CodeModel::resolve(SynTree* use, CodeModel::Scope* sc)
+{
+    // The files are walked in the order they are evaluated, so the defs recorded so far are the ones
+    // reaching the use; the defs of a file imported or of the build config are complete or, while
+    // they are still walked, up to the point of the import.
+    const char* name = use->d_tok.d_val.constData();
+    if( !d_allLhs.contains(name) )
+        return; // a builtin or undefined var
+    QSet<const Scope*> visited;
+    const Scope* file = sc;
+    bool forwarded = false;
+    for( Scope* s = sc; s != 0; s = s->d_outer )
+    {
+        forwarded = forwarded || d_forwarders.contains(s);
+        if( forwarded && s->d_kind.constData() == d_template )
+        {
+            d_viaInvoker.append( qMakePair(use,s) );
+            forwarded = false;
+        }
+        if( reach( use, s, name, visited ) )
+            return;
+        file = s;
+    }
+    if( !d_buildConfig.isEmpty() && file->d_name.constData() != d_buildConfig.constData() )
+    {
+        Files::const_iterator i = d_files.find(d_buildConfig.constData());
+        if( i != d_files.end() )
+            reach( use, &i.value(), name, visited );
+    }
+}
+
+bool CodeModel::reach(SynTree* use, const CodeModel::Scope* s, const char* name, QSet<const Scope*>& visited)
+{
+    // adds the defs of s, its declare_args blocks and its imports; true if they hide the outer defs
+    if( visited.contains(s) )
+        return false;
+    visited.insert(s);
+    bool hidden = false;
+    VarRefs::const_iterator i = s->d_lhs.find(name);
+    if( i != s->d_lhs.end() )
+    {
+        const SynTreeList& defs = i.value();
+        int k = defs.size() - 1;
+        while( k > 0 && !d_kills.contains(defs[k]) )
+            k--;
+        hidden = d_kills.contains(defs[k]);
+        for( ; k < defs.size(); k++ )
+            d_byUse.append( Edge(use,defs[k]) );
+    }
+    foreach( const Scope* a, d_argScopes.value(s) )
+        hidden = reach( use, a, name, visited ) || hidden;
+    Scope::ScopeHash::const_iterator j;
+    for( j = s->d_relovedImports.begin(); j != s->d_relovedImports.end(); ++j )
+        hidden = reach( use, j.value(), name, visited ) || hidden;
+    return hidden;
+}
+
+void CodeModel::resolveInvokers()
+{
+    if( d_viaInvoker.isEmpty() )
+        return;
+    // a template can be invoked before it is defined, so this waits until all files are walked
+    QHash<const char*,ScopeList> calls;
+    ScopeList todo;
+    for( Files::iterator i = d_files.begin(); i != d_files.end(); ++i )
+        todo.append( &i.value() );
+    while( !todo.isEmpty() )
+    {
+        Scope* s = todo.takeLast();
+        todo += s->d_allScopes;
+        calls[s->d_kind.constData()].append(s);
+    }
+    typedef QPair<SynTree*,Scope*> Pending;
+    foreach( const Pending& p, d_viaInvoker )
+    {
+        const char* name = p.first->d_tok.d_val.constData();
+        ScopeList templates;
+        templates << p.second;
+        QSet<const Scope*> done;
+        while( !templates.isEmpty() )
+        {
+            Scope* t = templates.takeLast();
+            if( done.contains(t) )
+                continue;
+            done.insert(t);
+            foreach( Scope* c, calls.value( templateName(t) ) )
+            {
+                VarRefs::const_iterator i = c->d_lhs.find(name);
+                if( i != c->d_lhs.end() )
+                {
+                    foreach( SynTree* def, i.value() )
+                        d_byUse.append( Edge(p.first,def) );
+                }else if( d_forwarders.contains(c) )
+                {
+                    // the invocation forwards the var from the invoker of its own template
+                    Scope* outer = c->d_outer;
+                    while( outer != 0 && outer->d_kind.constData() != d_template )
+                        outer = outer->d_outer;
+                    if( outer != 0 )
+                        templates << outer;
+                }
+            }
+        }
+    }
+}
+
+const char*CodeModel::templateName(const CodeModel::Scope* t) const
+{
+    if( t->d_params == 0 || t->d_params->d_children.isEmpty() )
+        return 0;
+    SynTree* name = flatten( t->d_params->d_children.first() );
+    if( name->d_tok.d_type != Tok_string || !name->d_children.isEmpty() )
+        return 0;
+    return Lexer::getSymbol( name->d_tok.getEscapedVal() ).constData();
+}
+
 void CodeModel::list(SynTree* st, CodeModel::Scope* sc)
 {
     Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_List_ && st->d_children.size() >= 2
@@ -1062,6 +1307,7 @@ static void remap( SynTree* st, SynTree* ref, int pos )
 {
     st->d_tok.d_lineNr = ref->d_tok.d_lineNr;
     st->d_tok.d_colNr += ref->d_tok.d_colNr + pos - 1;
+    st->d_tok.d_offset += ref->d_tok.d_offset + pos;
     st->d_tok.d_sourcePath = ref->d_tok.d_sourcePath;
     foreach( SynTree* sub, st->d_children )
         remap( sub, ref, pos );
@@ -1098,8 +1344,8 @@ void CodeModel::stringVar_(SynTree* st, CodeModel::Scope* sc, int pos, int len)
             primary->d_children.clear(); // damit nicht mit parser gelöscht
             break;
         default:
-            d_errs->error(Errors::Syntax,st,tr("embedding of %1 in strings not allowed")
-                          .arg(SynTree::rToStr(primary->d_children.first()->d_tok.d_type)));
+            d_errs->error(Errors::Syntax,st,Errors::Msg("embedding of %1 in strings not allowed",
+                          SynTree::rToStr(primary->d_children.first()->d_tok.d_type)));
             break;
         }
     }
@@ -1109,7 +1355,7 @@ void CodeModel::namedObj_(SynTree* st, CodeModel::Scope* sc, const QByteArray& k
 {
     if( st->d_children[2]->d_tok.d_type == Tok_Rpar )
     {
-        d_errs->error(Errors::Syntax,st,tr("invalid named object statement") );
+        d_errs->error(Errors::Syntax,st,Errors::Msg("invalid named object statement") );
         return;
     }
     Q_ASSERT( st->d_children[2]->d_tok.d_type == SynTree::R_ExprList && !st->d_children[2]->d_children.isEmpty()
@@ -1148,8 +1394,12 @@ void CodeModel::namedObj_(SynTree* st, CodeModel::Scope* sc, const QByteArray& k
     if( st->d_children.size() > 4 )
     {
         if( st->d_children.size() == 5 )
+        {
+            const int depth = d_condDepth;
+            d_condDepth = 0; // relative to the new scope
             block( st->d_children.last(), newScope );
-        else
+            d_condDepth = depth;
+        }else
             Q_ASSERT( false );
     }
 }
@@ -1158,7 +1408,15 @@ void CodeModel::function_(SynTree* st, CodeModel::Scope* sc, const QByteArray& k
 {
     Q_ASSERT( st->d_children.size() >= 3 );
     if( st->d_children[2]->d_tok.d_type == SynTree::R_ExprList )
+    {
         exprList(st->d_children[2],sc);
+        if( kind.constData() == d_forward && !st->d_children[2]->d_children.isEmpty() )
+        {
+            SynTree* from = flatten( st->d_children[2]->d_children.first() );
+            if( from->d_tok.d_type == Tok_identifier && from->d_tok.d_val.constData() == d_invoker )
+                d_forwarders.insert(sc);
+        }
+    }
 
     if( st->d_children.last()->d_tok.d_type == SynTree::R_Block )
     {
@@ -1169,7 +1427,12 @@ void CodeModel::function_(SynTree* st, CodeModel::Scope* sc, const QByteArray& k
         newScope->d_kind = kind;
         if( st->d_children[2]->d_tok.d_type == SynTree::R_ExprList )
             newScope->d_params = st->d_children[2];
+        const int depth = d_condDepth;
+        d_condDepth = 0; // relative to the new scope
         block( st->d_children.last(), newScope );
+        d_condDepth = depth;
+        if( newScope->d_kind.constData() == d_declare_args )
+            d_argScopes[sc].append(newScope); // the args are visible in the enclosing scope
     }
 }
 
@@ -23,6 +23,10 @@
 #include <QObject>
 #include <QDir>
 #include <QSet>
+#include <QVector>
+#include <GnTools/GnSearchIndex.h>
+#include <GnTools/GnFuzzyIndex.h>
+#include <GnTools/GnFileCache.h>
 
 /*
  *  Responsibilities:
@@ -30,6 +34,7 @@
  *  - Find all *.gn and *.gni at and below toplevel
  *  - Parse all these files
  *  - Crossref all identifier uses including target names etc.
+ *  - Resolve variable uses to the defs reaching them
 */
 
 namespace Gn
@@ -72,6 +77,14 @@ namespace Gn
         typedef QList<Scope*> ScopeList;
         typedef QHash<const char*,ScopeList> ObjRefs;
 
+        struct Edge
+        {
+            SynTree* d_use; // RHS ident, or the LHS of += and -=
+            SynTree* d_def; // LHS ident reaching the use
+            Edge(SynTree* u = 0, SynTree* d = 0):d_use(u),d_def(d){}
+        };
+        typedef QVector<Edge> Edges;
+
         explicit CodeModel(QObject *parent = 0);
         ~CodeModel();
 
@@ -85,6 +98,10 @@ namespace Gn
         SynTree* findDefinition( const SynTree* );
 
         const QDir& getSourceRoot() const { return d_sourceRoot; }
+        Errors* getErrs() const { return d_errs; }
+        SearchIndex* getSearchIndex() { return &d_search; }
+        FileCache* getFileCache() const { return d_fcache; }
+        const FuzzyIndex* getFuzzyIndex() const { return &d_fuzzy; }
         QByteArrayList getFileList() const;
         Scope* getScope( const QByteArray& sourceFile ) const;
         bool isKnownVar( const char* ) const;
@@ -101,6 +118,14 @@ namespace Gn
         const SynTreeList& getUnresolvedRefs() const { return d_unresolvedRefs; }
         const SynTreeList& getDeclaredArgs() const { return d_declaredArgs; }
 
+        // Uses are resolved along the outer scopes, the imports and the build config, and for invoker.x
+        // and forwarded vars along the invocations of the template; all branches are assumed taken
+        SynTreeList getDefs( const SynTree* use ) const;
+        SynTreeList getUses( const SynTree* def ) const;
+        bool isModification( const SynTree* lhs ) const { return d_mods.contains(lhs); }
+        bool isDef( const SynTree* id ) const { return d_defs.contains(id); } // one of getAllLhs()
+        int getEdgeCount() const { return d_byUse.size(); }
+
         static SynTree* flatten(SynTree* st, int stopAt = 0);
         static SynTree* firstToken(SynTree* st);
 
@@ -129,15 +154,19 @@ namespace Gn
         void block(SynTree* st, Scope* sc);
         void condition_(SynTree* st, Scope* scope);
         void assignment_(SynTree* st, Scope*);
-        void lvalue(SynTree* st, Scope* sc);
+        void lvalue(SynTree* st, Scope* sc, int op);
         void primaryExpr(SynTree* st, Scope* sc);
         void unaryExpr(SynTree* st, Scope* sc);
         void exprNlr(SynTree* st, Scope* sc);
         void string(SynTree* st, Scope* sc);
         void arrayAccess(SynTree* st, Scope* sc);
         void scopeAccess(SynTree* st, Scope* sc);
-        void varRhs(SynTree* st, Scope* sc);
-        void varLhs(SynTree* st, Scope* sc);
+        void varRhs(SynTree* st, Scope* sc, SynTree* outer = 0);
+        void varLhs(SynTree* st, Scope* sc, bool reads = false);
+        void resolve(SynTree* use, Scope* sc);
+        bool reach(SynTree* use, const Scope* s, const char* name, QSet<const Scope*>& visited);
+        void resolveInvokers();
+        const char* templateName(const Scope*) const;
         void list(SynTree* st, Scope* sc);
         void stringVar_(SynTree* st, Scope* sc, int pos, int len);
         void namedObj_(SynTree* st, Scope* sc, const QByteArray& kind);
@@ -152,12 +181,28 @@ namespace Gn
         const char* d_foreach;
         const char* d_import;
         const char* d_declare_args;
+        const char* d_template;
+        const char* d_invoker;
+        const char* d_forward;
         QByteArray d_fileKind;
         VarRefs d_allRhs,d_allLhs,d_allFuncRefs,d_allImports;
         ObjRefs d_allObjDefs;
         SynTreeList d_allUnresolvedImports;
         ScopeList d_allUnnamedObjs; // not owned
         SynTreeList d_unresolvedRefs, d_declaredArgs;
+        QByteArray d_buildConfig; // path symbol; its file scope is the outermost of all other files
+        Edges d_byUse, d_byDef; // the same edges sorted by use and by def
+        QSet<const SynTree*> d_mods; // += and -=
+        QSet<const SynTree*> d_defs; // the same as in d_allLhs
+        // only used while parsing
+        int d_condDepth; // conditions and loops entered in the current scope
+        QSet<const SynTree*> d_kills; // unconditional plain assignments, which hide earlier and outer defs
+        QSet<const Scope*> d_forwarders; // scopes calling forward_variables_from(invoker, ...)
+        QHash<const Scope*,ScopeList> d_argScopes; // declare_args blocks by enclosing scope
+        QList<QPair<SynTree*,Scope*> > d_viaInvoker; // uses to resolve along the invocations of the template
+        SearchIndex d_search; // contents of all parsed files
+        FuzzyIndex d_fuzzy; // names of files, objects and args; rebuilt by parseDir
+        FileCache* d_fcache; // survives clear()
     };
 }
 
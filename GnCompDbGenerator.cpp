@@ -0,0 +1,164 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnCompDbGenerator.h"
+#include <QDir>
+using namespace Gn;
+
+CompDbGenerator::CompDbGenerator(Evaluator* e):NinjaGenerator(e),d_next(0),d_first(true)
+{
+}
+
+QByteArray CompDbGenerator::jsonString(const QByteArray& str)
+{
+    QByteArray res;
+    res.reserve( str.size() + 2 );
+    res += '"';
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        switch( c )
+        {
+        case '"':
+            res += "\\\"";
+            break;
+        case '\\':
+            res += "\\\\";
+            break;
+        case '\n':
+            res += "\\n";
+            break;
+        case '\t':
+            res += "\\t";
+            break;
+        default:
+            if( (unsigned char)c < 0x20 )
+                res += "\\u00" + QByteArray::number( (unsigned char)c, 16 ).rightJustified(2,'0');
+            else
+                res += c;
+        }
+    }
+    res += '"';
+    return res;
+}
+
+int CompDbGenerator::prepare()
+{
+    const int count = NinjaGenerator::prepare();
+    d_chunks.clear();
+    d_chunks.resize(count);
+    d_done.clear();
+    d_done.resize(count);
+    d_next = 0;
+    d_first = true;
+    if( d_toolchain == 0 )
+        return 0;
+    QDir().mkpath( d_outDir );
+    d_file.setFileName( QDir(d_outDir).absoluteFilePath("compile_commands.json.tmp") );
+    if( !d_file.open(QIODevice::WriteOnly | QIODevice::Truncate) )
+    {
+        fail( d_file.fileName(), "cannot open file for writing" );
+        return 0;
+    }
+    d_file.write("[\n");
+    return count;
+}
+
+void CompDbGenerator::generateUnit(int i)
+{
+    const Evaluator::Target* t = d_targets.at(i);
+    QByteArray out;
+    if( d_eval->isBinary(t) )
+    {
+        const Info& info = d_infos.at(i);
+        const Evaluator::Flags f = d_eval->getFlags(t);
+        QByteArrayList defines, includes;
+        foreach( const QByteArray& d, f.d_defines )
+            defines.append( shellQuote( "-D" + d ) );
+        foreach( const QByteArray& d, f.d_includeDirs )
+            includes.append( shellQuote( "-I" + rel(d) ) );
+        Subst ts = targetSubst(t);
+        ts.insert( "defines", defines.join(' ') );
+        ts.insert( "include_dirs", includes.join(' ') );
+        const struct { const char* d_name; const QByteArrayList* d_flags; } flags[] = {
+            { "cflags", &f.d_cflags }, { "cflags_c", &f.d_cflagsC }, { "cflags_cc", &f.d_cflagsCC },
+            { "cflags_objc", &f.d_cflagsC }, { "cflags_objcc", &f.d_cflagsCC }, { "asmflags", &f.d_asmflags },
+            { 0, 0 }
+        };
+        for( int k = 0; flags[k].d_name; k++ )
+        {
+            QByteArrayList l;
+            foreach( const QByteArray& o, *flags[k].d_flags )
+                l.append( shellQuote(o) );
+            ts.insert( flags[k].d_name, l.join(' ') );
+        }
+        const QByteArray dir = jsonString( QDir(d_outDir).absolutePath().toUtf8() ); // required to be absolute
+        for( int k = 0; k < info.d_objects.size(); k++ )
+        {
+            const QByteArray& src = info.d_sources[k];
+            const ValueScope* tl = tool( toolForSource(src) );
+            Subst s = sourceSubst(src);
+            for( Subst::const_iterator j = ts.constBegin(); j != ts.constEnd(); ++j )
+                s.insert( j.key(), j.value() );
+            s.insert( "output", info.d_objects[k] );
+            s.insert( "source", rel(src) );
+            if( !out.isEmpty() )
+                out += ",\n";
+            out += "  {\n    \"directory\": " + dir + ",\n    \"file\": " + jsonString( s.value("source") ) +
+                    ",\n    \"output\": " + jsonString( s.value("output") ) +
+                    ",\n    \"command\": " + jsonString( expand( toolString( tl, "command" ), s ) ) + "\n  }";
+        }
+    }
+    QMutexLocker lock(&d_lock);
+    d_chunks[i] = out;
+    d_done[i] = true;
+    flush();
+}
+
+void CompDbGenerator::flush()
+{
+    while( d_next < d_done.size() && d_done[d_next] )
+    {
+        QByteArray& chunk = d_chunks[d_next++];
+        if( chunk.isEmpty() )
+            continue;
+        if( !d_first )
+            d_file.write(",\n");
+        d_first = false;
+        d_file.write(chunk);
+        chunk.clear();
+    }
+}
+
+void CompDbGenerator::finish()
+{
+    if( !d_file.isOpen() )
+        return;
+    d_file.write("\n]\n");
+    const bool ok = d_file.error() == QFile::NoError;
+    d_file.close();
+    const QString path = QDir(d_outDir).absoluteFilePath("compile_commands.json");
+    if( ok )
+        replaceFile( path, d_file.fileName() );
+    else
+    {
+        fail( path, "cannot write file" );
+        QFile::remove( d_file.fileName() );
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GNCOMPDBGENERATOR_H
+#define GNCOMPDBGENERATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnNinjaGenerator.h>
+#include <QFile>
+#include <QMutex>
+
+/*
+ *  Writes compile_commands.json (the clang compilation database) to the output dir, which defaults to
+ *  the build dir of the Evaluator
+ *  - The commands are those ninja would run, i.e. the compiler tools of the default toolchain expanded
+ *    with the flags of the target and its configs
+ *  - The entries of each target are made in parallel; the JSON is streamed to the file in target order
+ *    as soon as the preceding targets are done, so only the targets still out of order are in memory
+ *  - The file is replaced only if its content changed, so clangd doesn't reload an identical database
+*/
+
+namespace Gn
+{
+    class CompDbGenerator : public NinjaGenerator
+    {
+    public:
+        explicit CompDbGenerator( Evaluator* );
+
+        static QByteArray jsonString( const QByteArray& );
+    protected:
+        int prepare();
+        void generateUnit( int );
+        void finish();
+        void flush(); // d_lock must be held
+    private:
+        QFile d_file;
+        QMutex d_lock;
+        QVector<QByteArray> d_chunks; // entries of the targets done, but not yet written
+        QVector<bool> d_done;
+        int d_next; // first target not yet written
+        bool d_first; // no entry written yet
+    };
+}
+
+#endif // GNCOMPDBGENERATOR_H
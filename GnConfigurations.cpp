@@ -0,0 +1,193 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnConfigurations.h"
+#include "GnErrors.h"
+#include <QElapsedTimer>
+#include <QMap>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+using namespace Gn;
+
+namespace Gn
+{
+    class ConfigTask : public QRunnable
+    {
+    public:
+        ConfigTask( Configurations* c, const QList<int>& todo, QAtomicInt& next ):d_cfg(c),d_todo(todo),d_next(next){}
+        void run()
+        {
+            int i;
+            while( ( i = d_next.fetchAndAddOrdered(1) ) < d_todo.size() )
+                d_cfg->evaluate( d_todo[i] );
+        }
+    private:
+        Configurations* d_cfg;
+        const QList<int>& d_todo;
+        QAtomicInt& d_next;
+    };
+}
+
+Configurations::Configurations(CodeModel* mdl, Errors* errs):d_mdl(mdl),d_errs(errs),d_threads(0)
+{
+    Q_ASSERT( mdl != 0 );
+}
+
+Configurations::~Configurations()
+{
+    clear();
+}
+
+int Configurations::add(const QByteArray& name, const QByteArray& args, const QByteArray& buildDir)
+{
+    Configuration c;
+    c.d_name = name;
+    c.d_args = args;
+    c.d_eval = new Evaluator( d_mdl, d_errs );
+    c.d_eval->setImportCache( &d_cache );
+    if( !buildDir.isEmpty() )
+        c.d_eval->setBuildDir( buildDir );
+    d_configs.append( c );
+    return d_configs.size() - 1;
+}
+
+void Configurations::clear()
+{
+    foreach( const Configuration& c, d_configs )
+        delete c.d_eval;
+    d_configs.clear();
+    d_cache.clear();
+}
+
+int Configurations::find(const QByteArray& name) const
+{
+    for( int i = 0; i < d_configs.size(); i++ )
+    {
+        if( d_configs[i].d_name == name )
+            return i;
+    }
+    return -1;
+}
+
+bool Configurations::evaluate(const QByteArrayList& roots)
+{
+    d_roots = roots;
+    QList<int> todo;
+    bool first = true;
+    for( int i = 0; i < d_configs.size(); i++ )
+    {
+        if( d_configs[i].d_evaluated )
+            first = false;
+        else
+            todo.append( i );
+    }
+    if( first && todo.size() > 1 )
+        evaluate( todo.takeFirst() ); // fills the cache for the others
+    int threads = d_threads <= 0 ? QThread::idealThreadCount() : d_threads;
+    threads = qMax( 1, qMin( threads, todo.size() ) );
+    QAtomicInt next(0);
+    if( threads == 1 )
+    {
+        ConfigTask t( this, todo, next );
+        t.run();
+    }else
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount( threads );
+        for( int i = 0; i < threads; i++ )
+            pool.start( new ConfigTask( this, todo, next ) );
+        pool.waitForDone();
+    }
+    bool ok = true;
+    foreach( const Configuration& c, d_configs )
+        ok = ok && c.d_ok;
+    return ok;
+}
+
+void Configurations::evaluate(int i)
+{
+    // each unit only touches its own Configuration, and the QList doesn't change meanwhile
+    Configuration& c = d_configs[i];
+    QElapsedTimer t;
+    t.start();
+    c.d_eval->setArgs( c.d_args );
+    c.d_ok = c.d_eval->evaluate( d_roots );
+    c.d_ms = t.elapsed();
+    c.d_evaluated = true;
+}
+
+static void diffItems( const Evaluator::Items& a, const Evaluator::Items& b, Configurations::Differences& res )
+{
+    typedef Configurations::Difference Difference;
+    QMap<QByteArray,QPair<const Evaluator::Item*,const Evaluator::Item*> > items; // sorted by label
+    foreach( const Evaluator::Item* i, a )
+        items[i->d_label].first = i;
+    foreach( const Evaluator::Item* i, b )
+        items[i->d_label].second = i;
+    QMap<QByteArray,QPair<const Evaluator::Item*,const Evaluator::Item*> >::const_iterator i;
+    for( i = items.begin(); i != items.end(); ++i )
+    {
+        const Evaluator::Item* ia = i.value().first;
+        const Evaluator::Item* ib = i.value().second;
+        if( ia == 0 || ib == 0 )
+        {
+            Difference d;
+            d.d_kind = ia ? Difference::OnlyInA : Difference::OnlyInB;
+            d.d_label = i.key();
+            res.append( d );
+            continue;
+        }
+        if( ia->d_values == ib->d_values )
+            continue;
+        // the same symbols in both, since the Evaluators use the same model
+        QMap<QByteArray,const char*> names;
+        ValueScope::Vars::const_iterator j;
+        for( j = ia->d_values->d_vars.begin(); j != ia->d_values->d_vars.end(); ++j )
+            names.insert( j.key(), j.key() );
+        for( j = ib->d_values->d_vars.begin(); j != ib->d_values->d_vars.end(); ++j )
+            names.insert( j.key(), j.key() );
+        foreach( const char* name, names )
+        {
+            const Value* va = ia->d_values->find( name, false );
+            const Value* vb = ib->d_values->find( name, false );
+            if( va && vb && *va == *vb )
+                continue;
+            Difference d;
+            d.d_kind = va == 0 ? Difference::OnlyInB : vb == 0 ? Difference::OnlyInA : Difference::Changed;
+            d.d_label = i.key();
+            d.d_name = name;
+            if( va )
+                d.d_a = *va;
+            if( vb )
+                d.d_b = *vb;
+            res.append( d );
+        }
+    }
+}
+
+Configurations::Differences Configurations::diff(int a, int b) const
+{
+    Differences res;
+    const Evaluator* ea = d_configs[a].d_eval;
+    const Evaluator* eb = d_configs[b].d_eval;
+    diffItems( ea->getTargets(), eb->getTargets(), res );
+    diffItems( ea->getConfigs(), eb->getConfigs(), res );
+    return res;
+}
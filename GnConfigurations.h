@@ -0,0 +1,90 @@
+#ifndef GNCONFIGURATIONS_H
+#define GNCONFIGURATIONS_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnEvaluator.h>
+
+/*
+ *  Several build configurations (e.g. is_debug true and false, or different target_cpu) of the same
+ *  parsed project
+ *  - All Evaluators use the SynTrees of the one CodeModel, which are only read
+ *  - The Evaluators share an ImportCache, so a .gni only runs again if it reads a base value or an
+ *    override which is different in the configuration; otherwise the variables of the earlier result
+ *    are shared until modified; likewise a template instantiation whose inputs are the same only has its
+ *    items copied
+ *  - evaluate() runs the configurations in parallel; if none was evaluated yet, the first one runs
+ *    alone, so the others find its imports in the cache
+ *  - diff() compares the variables of the targets and configs of two configurations
+*/
+
+namespace Gn
+{
+    class Configurations
+    {
+    public:
+        struct Configuration
+        {
+            QByteArray d_name;
+            QByteArray d_args; // as in args.gn
+            Evaluator* d_eval; // owned
+            bool d_evaluated, d_ok;
+            qint64 d_ms; // time used by evaluate
+            Configuration():d_eval(0),d_evaluated(false),d_ok(false),d_ms(0){}
+        };
+        struct Difference
+        {
+            enum Kind { OnlyInA, OnlyInB, Changed };
+            quint8 d_kind;
+            QByteArray d_label; // of the target or config
+            QByteArray d_name;  // of the variable; empty if the item only exists in one configuration
+            Value d_a, d_b;
+            Difference():d_kind(Changed){}
+        };
+        typedef QList<Difference> Differences;
+
+        explicit Configurations( CodeModel*, Errors* = 0 );
+        ~Configurations();
+
+        int add( const QByteArray& name, const QByteArray& args,
+                 const QByteArray& buildDir = QByteArray() ); // returns the index
+        void clear();
+        int getCount() const { return d_configs.size(); }
+        const Configuration& getConfig( int i ) const { return d_configs[i]; }
+        Evaluator* getEvaluator( int i ) const { return d_configs[i].d_eval; }
+        int find( const QByteArray& name ) const;
+        void setThreads( int n ) { d_threads = n; } // 0 means QThread::idealThreadCount
+        const ImportCache& getCache() const { return d_cache; }
+
+        bool evaluate( const QByteArrayList& roots = QByteArrayList() ); // the ones not yet evaluated
+        Differences diff( int a, int b ) const;
+    private:
+        friend class ConfigTask;
+        void evaluate( int i );
+        CodeModel* d_mdl;
+        Errors* d_errs;
+        QList<Configuration> d_configs;
+        ImportCache d_cache;
+        QByteArrayList d_roots;
+        int d_threads;
+    };
+}
+
+#endif // GNCONFIGURATIONS_H
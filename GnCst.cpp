@@ -0,0 +1,218 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnCst.h"
+#include "GnErrors.h"
+#include "GnParser.h"
+#include <QBuffer>
+#include <algorithm>
+using namespace Gn;
+
+Cst::Cst():d_root(0)
+{
+}
+
+Cst::~Cst()
+{
+    clear();
+}
+
+bool Cst::parse(const QByteArray& source, const QString& path, Errors* err)
+{
+    clear();
+    d_source = source;
+
+    // errors are collected locally, so the result doesn't depend on other threads reporting to err
+    Errors local(0,true);
+    local.setRecord(true);
+    QBuffer in;
+    in.setData( d_source );
+    in.open(QIODevice::ReadOnly);
+    Gn::Lexer lex;
+    lex.setStream( &in, path );
+    lex.setErrors(&local);
+    // comments are skipped by the lexer and recovered from the gaps between the terminals
+    Gn::Parser p(&lex,&local);
+    p.RunParser();
+    if( err && local.getErrCount() )
+    {
+        const Errors::EntriesByFile all = local.getErrors();
+        Errors::EntriesByFile::const_iterator i;
+        for( i = all.begin(); i != all.end(); ++i )
+            foreach( const Errors::Entry& e, i.value() )
+                err->error( Errors::Source(e.d_source), e.d_file, e.d_line, e.d_col, e.d_msg );
+    }
+
+    if( !p.d_root.d_children.isEmpty() )
+    {
+        Q_ASSERT( p.d_root.d_children.size() == 1 &&
+                  p.d_root.d_children.first()->d_tok.d_type == SynTree::R_StatementList );
+        d_root = p.d_root.d_children.first();
+        p.d_root.d_children.clear();
+        collect( d_root );
+    }
+
+    quint32 pos = 0;
+    d_firstTrivia.reserve( d_terminals.size() + 2 );
+    foreach( SynTree* t, d_terminals )
+    {
+        d_firstTrivia.append( d_trivia.size() );
+        scanGap( pos, t->d_tok.d_offset );
+        pos = t->d_tok.d_offset + t->d_tok.d_len;
+    }
+    d_firstTrivia.append( d_trivia.size() );
+    scanGap( pos, d_source.size() );
+    d_firstTrivia.append( d_trivia.size() );
+
+    return local.getErrCount() == 0;
+}
+
+void Cst::clear()
+{
+    delete d_root;
+    d_root = 0;
+    d_source.clear();
+    d_terminals.clear();
+    d_trivia.clear();
+    d_firstTrivia.clear();
+}
+
+static bool offsetLessThan( const SynTree* lhs, quint32 off )
+{
+    return lhs->d_tok.d_offset < off;
+}
+
+int Cst::indexOf(const SynTree* terminal) const
+{
+    if( terminal == 0 )
+        return -1;
+    QVector<SynTree*>::const_iterator i = std::lower_bound( d_terminals.begin(), d_terminals.end(),
+                                                            terminal->d_tok.d_offset, offsetLessThan );
+    if( i != d_terminals.end() && *i == terminal )
+        return i - d_terminals.begin();
+    else
+        return -1;
+}
+
+Cst::TriviaList Cst::getLeadingTrivia(int terminal) const
+{
+    if( terminal < 0 || terminal >= d_terminals.size() )
+        return TriviaList();
+    return d_trivia.mid( d_firstTrivia[terminal], d_firstTrivia[terminal+1] - d_firstTrivia[terminal] );
+}
+
+Cst::TriviaList Cst::getTrailingTrivia() const
+{
+    if( d_firstTrivia.size() < 2 )
+        return TriviaList();
+    const int first = d_firstTrivia[d_firstTrivia.size()-2];
+    return d_trivia.mid( first, d_firstTrivia.last() - first );
+}
+
+QByteArray Cst::getText(const Cst::Trivia& t) const
+{
+    return d_source.mid( t.d_pos, t.d_len );
+}
+
+QByteArray Cst::getText(const SynTree* t) const
+{
+    return d_source.mid( t->d_tok.d_offset, t->d_tok.d_len );
+}
+
+QByteArray Cst::toSource() const
+{
+    QByteArray res;
+    res.reserve( d_source.size() );
+    for( int i = 0; i < d_terminals.size(); i++ )
+    {
+        for( int j = d_firstTrivia[i]; j < d_firstTrivia[i+1]; j++ )
+            res += getText( d_trivia[j] );
+        res += getText( d_terminals[i] );
+    }
+    foreach( const Trivia& t, getTrailingTrivia() )
+        res += getText( t );
+    return res;
+}
+
+void Cst::collect(SynTree* st)
+{
+    if( st->d_tok.d_type < SynTree::R_First )
+    {
+        if( st->d_tok.d_type != Tok_Invalid && st->d_tok.d_len > 0 )
+            d_terminals.append(st);
+    }else
+    {
+        foreach( SynTree* sub, st->d_children )
+            collect(sub);
+    }
+}
+
+static inline bool isSpace( char c )
+{
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+void Cst::scanGap(quint32 from, quint32 to)
+{
+    const char* str = d_source.constData();
+    quint32 pos = from;
+    while( pos < to )
+    {
+        const quint32 start = pos;
+        quint8 kind;
+        const char c = str[pos];
+        if( isSpace(c) )
+        {
+            kind = Trivia::Space;
+            while( pos < to && isSpace(str[pos]) )
+                pos++;
+        }else if( c == '\r' || c == '\n' )
+        {
+            kind = Trivia::Newline;
+            if( c == '\r' && pos + 1 < to && str[pos+1] == '\n' )
+                pos++;
+            pos++;
+        }else if( c == '#' )
+        {
+            kind = Trivia::Comment;
+            while( pos < to && str[pos] != '\n' && str[pos] != '\r' )
+                pos++;
+        }else if( c == ',' )
+        {
+            kind = Trivia::Comma;
+            pos++;
+        }else
+        {
+            kind = Trivia::Other;
+            while( pos < to && !isSpace(str[pos]) && str[pos] != '\r' && str[pos] != '\n' &&
+                   str[pos] != '#' && str[pos] != ',' )
+                pos++;
+        }
+        // split runs which don't fit into d_len
+        quint32 len = pos - start;
+        quint32 off = start;
+        while( len > 0xffff )
+        {
+            d_trivia.append( Trivia( off, 0xffff, kind ) );
+            off += 0xffff;
+            len -= 0xffff;
+        }
+        d_trivia.append( Trivia( off, len, kind ) );
+    }
+}
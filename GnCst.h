@@ -0,0 +1,82 @@
+#ifndef GNCST_H
+#define GNCST_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+
+/*
+ *  Lossless concrete syntax tree
+ *  - Keeps the source buffer and the SynTree produced by the Parser
+ *  - Whitespace, comments and commas, which the Parser doesn't put into the SynTree,
+ *    are represented as trivia ranges (offsets into the source buffer, not copies)
+ *  - Each terminal owns the trivia between its predecessor and itself; what follows
+ *    the last terminal is the trailing trivia; so the file can be reproduced byte by byte
+*/
+
+namespace Gn
+{
+    class Errors;
+    class SynTree;
+
+    class Cst
+    {
+    public:
+        struct Trivia
+        {
+            enum Kind { Space, Newline, Comment, Comma, Other }; // Other is text skipped by the parser on errors
+            quint32 d_pos;
+            quint16 d_len;
+            quint8 d_kind;
+            Trivia(quint32 pos = 0, quint16 len = 0, quint8 kind = Space):d_pos(pos),d_len(len),d_kind(kind){}
+        };
+        typedef QVector<Trivia> TriviaList;
+
+        Cst();
+        ~Cst();
+
+        bool parse( const QByteArray& source, const QString& path, Errors* = 0 );
+        void clear();
+
+        SynTree* getRoot() const { return d_root; } // R_StatementList or null
+        const QByteArray& getSource() const { return d_source; }
+        int getTerminalCount() const { return d_terminals.size(); }
+        SynTree* getTerminal( int i ) const { return d_terminals[i]; }
+        int indexOf( const SynTree* terminal ) const;
+        TriviaList getLeadingTrivia( int terminal ) const;
+        TriviaList getTrailingTrivia() const;
+        QByteArray getText( const Trivia& ) const;
+        QByteArray getText( const SynTree* terminal ) const;
+        QByteArray toSource() const;
+    protected:
+        void collect( SynTree* );
+        void scanGap( quint32 from, quint32 to );
+    private:
+        QByteArray d_source;
+        SynTree* d_root;
+        QVector<SynTree*> d_terminals; // in source order
+        QVector<Trivia> d_trivia; // in source order
+        QVector<quint32> d_firstTrivia; // index into d_trivia per terminal, plus trailing and end
+    };
+}
+
+#endif // GNCST_H
@@ -0,0 +1,179 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnDiagnostics.h"
+#include <QFileDevice>
+using namespace Gn;
+
+DiagnosticsWriter::DiagnosticsWriter(QIODevice* out, Format f):
+    d_out(out),d_count(0),d_format(f),d_started(false),d_finished(false)
+{
+    Q_ASSERT( out != 0 );
+    d_buf.reserve( BufferSize + 1024 );
+}
+
+DiagnosticsWriter::~DiagnosticsWriter()
+{
+    finish();
+}
+
+void DiagnosticsWriter::setRoot(const QDir& d)
+{
+    QMutexLocker lock(&d_lock);
+    d_root = d;
+    d_relPaths.clear();
+}
+
+void DiagnosticsWriter::write(const QByteArray& file, quint32 line, quint16 col, bool isErr,
+                              const char* source, const QString& msg)
+{
+    QMutexLocker lock(&d_lock);
+    if( d_finished )
+        return;
+    const QByteArray& path = relativePath(file);
+    const char* level = isErr ? "error" : "warning";
+    if( d_format == Sarif )
+    {
+        if( !d_started )
+            d_buf += "{\"version\":\"2.1.0\","
+                    "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+                    "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"GnTools\"}},\"results\":[\n";
+        else
+            d_buf += ",\n";
+        d_buf += "{\"level\":\"";
+        d_buf += level;
+        d_buf += "\",\"ruleId\":\"";
+        d_buf += source;
+        d_buf += "\",\"message\":{\"text\":\"";
+        escape( d_buf, msg.toUtf8() );
+        d_buf += "\"},\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":\"";
+        escape( d_buf, path );
+        d_buf += "\"}";
+        if( line > 0 ) // SARIF lines and columns start at 1
+        {
+            d_buf += ",\"region\":{\"startLine\":";
+            d_buf += QByteArray::number(line);
+            if( col > 0 )
+            {
+                d_buf += ",\"startColumn\":";
+                d_buf += QByteArray::number(col);
+            }
+            d_buf += "}";
+        }
+        d_buf += "}}]}";
+    }else
+    {
+        d_buf += "{\"file\":\"";
+        escape( d_buf, path );
+        d_buf += "\",\"line\":";
+        d_buf += QByteArray::number(line);
+        d_buf += ",\"col\":";
+        d_buf += QByteArray::number(col);
+        d_buf += ",\"severity\":\"";
+        d_buf += level;
+        d_buf += "\",\"source\":\"";
+        d_buf += source;
+        d_buf += "\",\"message\":\"";
+        escape( d_buf, msg.toUtf8() );
+        d_buf += "\"}\n";
+    }
+    d_started = true;
+    d_count++;
+    if( d_buf.size() >= BufferSize )
+        writeBuffer();
+}
+
+void DiagnosticsWriter::writeBuffer()
+{
+    d_out->write( d_buf );
+    d_buf.clear();
+    // a QFile on stdout keeps its own buffer, which a consumer of the pipe would wait for
+    QFileDevice* file = qobject_cast<QFileDevice*>(d_out);
+    if( file )
+        file->flush();
+}
+
+void DiagnosticsWriter::flush()
+{
+    QMutexLocker lock(&d_lock);
+    if( !d_buf.isEmpty() )
+        writeBuffer();
+}
+
+void DiagnosticsWriter::finish()
+{
+    QMutexLocker lock(&d_lock);
+    if( d_finished )
+        return;
+    d_finished = true;
+    if( d_format == Sarif )
+    {
+        if( !d_started )
+            d_buf += "{\"version\":\"2.1.0\","
+                    "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+                    "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"GnTools\"}},\"results\":[";
+        d_buf += "\n]}]}\n";
+    }
+    if( !d_buf.isEmpty() )
+        writeBuffer();
+}
+
+void DiagnosticsWriter::escape(QByteArray& out, const QByteArray& str)
+{
+    static const char* hex = "0123456789abcdef";
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        switch( c )
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if( quint8(c) < 0x20 )
+            {
+                out += "\\u00";
+                out += hex[ quint8(c) >> 4 ];
+                out += hex[ quint8(c) & 0xf ];
+            }else
+                out += c; // UTF-8 multi byte sequences are valid JSON as is
+            break;
+        }
+    }
+}
+
+const QByteArray& DiagnosticsWriter::relativePath(const QByteArray& file)
+{
+    QHash<QByteArray,QByteArray>::iterator i = d_relPaths.find(file);
+    if( i == d_relPaths.end() )
+        i = d_relPaths.insert( file, d_root.relativeFilePath( QString::fromUtf8(file) ).toUtf8() );
+    return i.value();
+}
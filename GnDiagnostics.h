@@ -0,0 +1,73 @@
+#ifndef GNDIAGNOSTICS_H
+#define GNDIAGNOSTICS_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QDir>
+#include <QHash>
+#include <QMutex>
+
+class QIODevice;
+
+/*
+ *  Streams diagnostics in a machine readable format while parsing proceeds
+ *  - JSON Lines: one self-contained object per line, can be consumed before the run ends
+ *  - SARIF 2.1.0: a single log with one run; results are appended as they arrive, finish()
+ *    closes the document
+ *  - Output is buffered and written to the device in chunks, at the latest when Errors merged the
+ *    reports of a file and calls flush(); the Qt message handler is not used
+ *  - Paths are made relative to the root once per file
+*/
+
+namespace Gn
+{
+    class DiagnosticsWriter
+    {
+    public:
+        enum Format { JsonLines, Sarif };
+        enum { BufferSize = 64 * 1024 };
+
+        DiagnosticsWriter( QIODevice* out, Format = JsonLines );
+        ~DiagnosticsWriter();
+
+        void setRoot( const QDir& );
+        void write( const QByteArray& file, quint32 line, quint16 col, bool isErr,
+                    const char* source, const QString& msg );
+        void flush();
+        void finish();
+        quint32 getCount() const { return d_count; }
+
+        static void escape( QByteArray& out, const QByteArray& str );
+    protected:
+        const QByteArray& relativePath( const QByteArray& file );
+        void writeBuffer(); // d_lock must be held
+    private:
+        QMutex d_lock;
+        QIODevice* d_out;
+        QDir d_root;
+        QHash<QByteArray,QByteArray> d_relPaths;
+        QByteArray d_buf;
+        quint32 d_count;
+        quint8 d_format;
+        bool d_started, d_finished;
+    };
+}
+
+#endif // GNDIAGNOSTICS_H
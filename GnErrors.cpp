@@ -19,83 +19,288 @@
 
 #include "GnErrors.h"
 #include "GnSynTree.h"
+#include "GnDiagnostics.h"
 #include <QtDebug>
 #include <QFileInfo>
+#include <algorithm>
+#include <string.h>
 using namespace Gn;
 
 Errors::Errors(QObject *parent, bool threadExclusive) :
     QObject(parent),
     d_numOfErrs(0),d_numOfWrns(0),d_showWarnings(true),d_threadExclusive(threadExclusive),
-    d_reportToConsole(false),d_record(false),d_numOfSyntaxErrs(0)
+    d_reportToConsole(false),d_record(false),d_numOfSyntaxErrs(0),d_local(0),d_writer(0)
 {
+    if( !d_threadExclusive )
+        d_local = new QThreadStorage<BufferRef>();
+}
 
+Errors::~Errors()
+{
+    flush(); // so pending reports are still logged
+    delete d_local;
 }
 
 void Errors::error(Errors::Source s, const SynTree* st, const QString& msg)
 {
     Q_ASSERT( st != 0 );
-    error( s, st->d_tok.d_sourcePath, st->d_tok.d_lineNr, st->d_tok.d_colNr, msg );
+    Record r;
+    r.d_file = st->d_tok.d_sourcePath;
+    r.d_line = st->d_tok.d_lineNr;
+    r.d_col = st->d_tok.d_colNr;
+    r.d_source = s;
+    r.d_isErr = true;
+    r.d_text = msg;
+    append(r);
 }
 
 void Errors::error(Errors::Source s, const QString& file, int line, int col, const QString& msg)
 {
-    if( !d_threadExclusive ) d_lock.lockForWrite();
-    bool inserted = true;
-    Entry e;
-    e.d_col = col;
-    e.d_line = line;
-    e.d_msg = msg;
-    e.d_source = s;
-    e.d_file = file;
-    if( d_record )
-    {
-        EntryList& l = d_errs[file];
-        const int count = l.size();
-        l.insert(e);
-        inserted = count != l.size();
-    }
-    if( d_reportToConsole && inserted )
-        log(e,true);
-    if( inserted || !d_reportToConsole )
-    {
-
-        d_numOfErrs++;
-        if( s == Syntax )
-            d_numOfSyntaxErrs++;
-    }
-    if( !d_threadExclusive ) d_lock.unlock();
+    Record r;
+    r.d_file = file.toUtf8();
+    r.d_line = line;
+    r.d_col = col;
+    r.d_source = s;
+    r.d_isErr = true;
+    r.d_text = msg;
+    append(r);
 }
 
 void Errors::warning(Errors::Source s, const SynTree* st, const QString& msg)
 {
     Q_ASSERT( st != 0 );
-    warning( s, st->d_tok.d_sourcePath, st->d_tok.d_lineNr, st->d_tok.d_colNr, msg );
+    Record r;
+    r.d_file = st->d_tok.d_sourcePath;
+    r.d_line = st->d_tok.d_lineNr;
+    r.d_col = st->d_tok.d_colNr;
+    r.d_source = s;
+    r.d_text = msg;
+    append(r);
 }
 
 void Errors::warning(Errors::Source s, const QString& file, int line, int col, const QString& msg)
 {
+    Record r;
+    r.d_file = file.toUtf8();
+    r.d_line = line;
+    r.d_col = col;
+    r.d_source = s;
+    r.d_text = msg;
+    append(r);
+}
+
+void Errors::error(Errors::Source s, const SynTree* st, const Errors::Msg& msg)
+{
+    Q_ASSERT( st != 0 );
+    error( s, st->d_tok.d_sourcePath, st->d_tok.d_lineNr, st->d_tok.d_colNr, msg );
+}
+
+void Errors::error(Errors::Source s, const QByteArray& file, quint32 line, quint16 col, const Errors::Msg& msg)
+{
+    Record r;
+    r.d_file = file;
+    r.d_line = line;
+    r.d_col = col;
+    r.d_source = s;
+    r.d_isErr = true;
+    r.d_msg = msg;
+    append(r);
+}
+
+void Errors::warning(Errors::Source s, const SynTree* st, const Errors::Msg& msg)
+{
+    Q_ASSERT( st != 0 );
+    warning( s, st->d_tok.d_sourcePath, st->d_tok.d_lineNr, st->d_tok.d_colNr, msg );
+}
+
+void Errors::warning(Errors::Source s, const QByteArray& file, quint32 line, quint16 col, const Errors::Msg& msg)
+{
+    Record r;
+    r.d_file = file;
+    r.d_line = line;
+    r.d_col = col;
+    r.d_source = s;
+    r.d_msg = msg;
+    append(r);
+}
+
+void Errors::append(const Errors::Record& r)
+{
+    if( d_threadExclusive )
+    {
+        d_own.d_recs.append(r);
+        return;
+    }
+    if( !d_local->hasLocalData() )
+    {
+        BufferRef b( new Buffer() );
+        d_bufLock.lock();
+        d_buffers.append(b);
+        d_bufLock.unlock();
+        d_local->setLocalData(b);
+    }
+    Buffer* b = d_local->localData().data();
+    b->d_lock.lock();
+    b->d_recs.append(r);
+    b->d_lock.unlock();
+}
+
+void Errors::flush()
+{
+    Records pending;
+    if( d_threadExclusive )
+        qSwap( pending, d_own.d_recs );
+    else
+    {
+        QMutexLocker lock(&d_bufLock);
+        foreach( const BufferRef& b, d_buffers )
+        {
+            b->d_lock.lock();
+            if( pending.isEmpty() )
+                qSwap( pending, b->d_recs );
+            else
+            {
+                pending += b->d_recs;
+                b->d_recs.clear();
+            }
+            b->d_lock.unlock();
+        }
+    }
+    if( pending.isEmpty() )
+        return;
     if( !d_threadExclusive ) d_lock.lockForWrite();
-    bool inserted = true;
-    if( d_showWarnings )
+    merge( pending );
+    if( !d_threadExclusive ) d_lock.unlock();
+    if( d_writer )
+        d_writer->flush(); // so consumers see the results while the run proceeds
+}
+
+void Errors::merge(Errors::Records& pending)
+{
+    // the order in which threads reported doesn't matter
+    std::stable_sort( pending.begin(), pending.end() );
+    foreach( const Record& r, pending )
     {
-        Entry e;
-        e.d_col = col;
-        e.d_line = line;
-        e.d_msg = msg;
-        e.d_source = s;
-        e.d_file = file;
-        if( d_record )
+        if( r.d_isErr )
+        {
+            const bool inserted = d_record ? insert( d_errs[r.d_file], r ) : true;
+            if( inserted || !d_reportToConsole )
+            {
+                // duplicates only count if they aren't logged, as it always was
+                d_numOfErrs++;
+                if( r.d_source == Syntax )
+                    d_numOfSyntaxErrs++;
+            }
+            if( inserted )
+            {
+                if( d_reportToConsole )
+                    log( toEntry(r), true );
+                if( d_writer )
+                    d_writer->write( r.d_file, r.d_line, r.d_col, true, sourceName(r.d_source), r.message() );
+            }
+        }else if( !d_showWarnings )
+            d_numOfWrns++;
+        else
         {
-            EntryList& l = d_wrns[file];
-            const int count = l.size();
-            l.insert(e);
-            inserted = count != l.size();
+            const bool inserted = d_record ? insert( d_wrns[r.d_file], r ) : true;
+            if( inserted )
+            {
+                d_numOfWrns++;
+                if( d_reportToConsole )
+                    log( toEntry(r), false );
+                if( d_writer )
+                    d_writer->write( r.d_file, r.d_line, r.d_col, false, sourceName(r.d_source), r.message() );
+            }
         }
-        if( d_reportToConsole && inserted )
-            log(e,false);
     }
-    if( inserted )
-        d_numOfWrns++;
+}
+
+bool Errors::insert(Errors::Records& l, const Errors::Record& r)
+{
+    Records::iterator i = std::lower_bound( l.begin(), l.end(), r );
+    if( i != l.end() && *i == r )
+        return false;
+    l.insert( i, r );
+    return true;
+}
+
+Errors::Entry Errors::toEntry(const Errors::Record& r)
+{
+    Entry e;
+    e.d_line = r.d_line;
+    e.d_col = r.d_col;
+    e.d_source = r.d_source;
+    e.d_msg = r.message();
+    e.d_file = QString::fromUtf8(r.d_file);
+    return e;
+}
+
+Errors::EntriesByFile Errors::toEntries(const Errors::RecordsByFile& recs)
+{
+    EntriesByFile res;
+    RecordsByFile::const_iterator i;
+    for( i = recs.begin(); i != recs.end(); ++i )
+    {
+        EntryList& l = res[QString::fromUtf8(i.key())];
+        foreach( const Record& r, i.value() )
+            l.insert( toEntry(r) );
+    }
+    return res;
+}
+
+bool Errors::Record::operator<(const Errors::Record& rhs) const
+{
+    if( d_file != rhs.d_file )
+        return d_file < rhs.d_file;
+    if( d_line != rhs.d_line )
+        return d_line < rhs.d_line;
+    if( d_col != rhs.d_col )
+        return d_col < rhs.d_col;
+    if( d_isErr != rhs.d_isErr )
+        return d_isErr;
+    if( d_source != rhs.d_source )
+        return d_source < rhs.d_source;
+    // by the message as reported, so a Msg and a text which read the same are duplicates; a Msg is
+    // only formatted here if the position is equal too
+    if( d_msg.d_fmt == 0 && rhs.d_msg.d_fmt == 0 )
+        return d_text < rhs.d_text;
+    return message() < rhs.message();
+}
+
+bool Errors::Record::operator==(const Errors::Record& rhs) const
+{
+    return !( *this < rhs ) && !( rhs < *this );
+}
+
+QString Errors::Msg::toString() const
+{
+    if( d_fmt == 0 )
+        return QString();
+    QString res = QString::fromUtf8(d_fmt);
+    if( ::strstr( d_fmt, "%1" ) )
+        res = res.arg( QString::fromUtf8(d_arg1) );
+    if( ::strstr( d_fmt, "%2" ) )
+        res = res.arg( QString::fromUtf8(d_arg2) );
+    return res;
+}
+
+void Errors::setRoot(const QDir& d)
+{
+    flush();
+    if( !d_threadExclusive ) d_lock.lockForWrite();
+    d_root = d;
+    if( d_writer )
+        d_writer->setRoot(d);
+    if( !d_threadExclusive ) d_lock.unlock();
+}
+
+void Errors::setWriter(DiagnosticsWriter* w)
+{
+    flush();
+    if( !d_threadExclusive ) d_lock.lockForWrite();
+    d_writer = w;
+    if( d_writer )
+        d_writer->setRoot(d_root);
     if( !d_threadExclusive ) d_lock.unlock();
 }
 
@@ -109,6 +314,7 @@ bool Errors::showWarnings() const
 
 void Errors::setShowWarnings(bool on)
 {
+    flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     d_showWarnings = on;
     if( !d_threadExclusive ) d_lock.unlock();
@@ -124,6 +330,7 @@ bool Errors::reportToConsole() const
 
 void Errors::setReportToConsole(bool on)
 {
+    flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     d_reportToConsole = on;
     if( !d_threadExclusive ) d_lock.unlock();
@@ -139,6 +346,7 @@ bool Errors::record() const
 
 void Errors::setRecord(bool on)
 {
+    flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     d_record = on;
     if( !d_threadExclusive ) d_lock.unlock();
@@ -146,6 +354,7 @@ void Errors::setRecord(bool on)
 
 quint32 Errors::getErrCount() const
 {
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
     const quint32 res = d_numOfErrs;
     if( !d_threadExclusive ) d_lock.unlock();
@@ -154,17 +363,29 @@ quint32 Errors::getErrCount() const
 
 quint32 Errors::getWrnCount() const
 {
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
     const quint32 res = d_numOfWrns;
     if( !d_threadExclusive ) d_lock.unlock();
     return res;
 }
 
+quint32 Errors::getSyntaxErrCount() const
+{
+    const_cast<Errors*>(this)->flush();
+    if( !d_threadExclusive ) d_lock.lockForRead();
+    const quint32 res = d_numOfSyntaxErrs;
+    if( !d_threadExclusive ) d_lock.unlock();
+    return res;
+}
+
 Errors::EntryList Errors::getErrors(const QString& file) const
 {
     EntryList res;
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
-    res = d_errs.value(file);
+    foreach( const Record& r, d_errs.value(file.toUtf8()) )
+        res.insert( toEntry(r) );
     if( !d_threadExclusive ) d_lock.unlock();
     return res;
 }
@@ -172,8 +393,10 @@ Errors::EntryList Errors::getErrors(const QString& file) const
 Errors::EntryList Errors::getWarnings(const QString& file) const
 {
     EntryList res;
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
-    res = d_wrns.value(file);
+    foreach( const Record& r, d_wrns.value(file.toUtf8()) )
+        res.insert( toEntry(r) );
     if( !d_threadExclusive ) d_lock.unlock();
     return res;
 }
@@ -181,8 +404,9 @@ Errors::EntryList Errors::getWarnings(const QString& file) const
 Errors::EntriesByFile Errors::getWarnings() const
 {
     EntriesByFile res;
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
-    res = d_wrns;
+    res = toEntries(d_wrns);
     if( !d_threadExclusive ) d_lock.unlock();
     return res;
 }
@@ -190,14 +414,16 @@ Errors::EntriesByFile Errors::getWarnings() const
 Errors::EntriesByFile Errors::getErrors() const
 {
     EntriesByFile res;
+    const_cast<Errors*>(this)->flush();
     if( !d_threadExclusive ) d_lock.lockForRead();
-    res = d_errs;
+    res = toEntries(d_errs);
     if( !d_threadExclusive ) d_lock.unlock();
     return res;
 }
 
 void Errors::clear()
 {
+    flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     d_numOfErrs = 0;
     d_numOfWrns = 0;
@@ -209,30 +435,41 @@ void Errors::clear()
 
 void Errors::clearFile(const QString& file)
 {
-    if( !d_threadExclusive ) d_lock.lockForWrite();
-    d_numOfErrs -= d_errs[file].size();
-    d_numOfSyntaxErrs = 0;
-    d_errs.remove(file);
-    d_numOfWrns -= d_wrns[file].size();
-    d_wrns.remove(file);
-    if( !d_threadExclusive ) d_lock.unlock();
+    clearFiles( QStringList() << file );
 }
 
 void Errors::clearFiles(const QStringList& files)
 {
+    flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     foreach( const QString& file, files )
     {
-        d_numOfErrs -= d_errs[file].size();
-        d_errs.remove(file);
-        d_numOfWrns -= d_wrns[file].size();
-        d_wrns.remove(file);
+        const QByteArray f = file.toUtf8();
+        RecordsByFile::iterator i = d_errs.find(f);
+        if( i != d_errs.end() )
+        {
+            foreach( const Record& r, i.value() )
+            {
+                if( r.d_source == Syntax )
+                    d_numOfSyntaxErrs--;
+            }
+            d_numOfErrs -= i.value().size();
+            d_errs.erase(i);
+        }
+        i = d_wrns.find(f);
+        if( i != d_wrns.end() )
+        {
+            d_numOfWrns -= i.value().size();
+            d_wrns.erase(i);
+        }
     }
     if( !d_threadExclusive ) d_lock.unlock();
 }
 
 void Errors::update(const Errors& rhs, bool overwrite)
 {
+    flush();
+    const_cast<Errors&>(rhs).flush();
     if( !d_threadExclusive ) d_lock.lockForWrite();
     if( !rhs.d_threadExclusive ) rhs.d_lock.lockForRead();
 
@@ -246,20 +483,27 @@ void Errors::update(const Errors& rhs, bool overwrite)
         d_numOfWrns = rhs.d_numOfWrns;
     }else
     {
-        EntriesByFile::const_iterator i;
+        RecordsByFile::const_iterator i;
         for( i = rhs.d_errs.begin(); i != rhs.d_errs.end(); ++i )
         {
             d_errs[ i.key() ] = i.value();
-            if( doLog ) foreach( const Entry& e, i.value() ) log(e,true);
+            if( doLog ) foreach( const Record& r, i.value() ) log(toEntry(r),true);
         }
         d_numOfErrs = 0;
         d_numOfSyntaxErrs = 0;
         for( i = d_errs.begin(); i != d_errs.end(); ++i )
+        {
             d_numOfErrs += i.value().size();
+            foreach( const Record& r, i.value() )
+            {
+                if( r.d_source == Syntax )
+                    d_numOfSyntaxErrs++;
+            }
+        }
         for( i = rhs.d_wrns.begin(); i != rhs.d_wrns.end(); ++i )
         {
             d_wrns[ i.key() ] = i.value();
-            if( doLog ) foreach( const Entry& e, i.value() ) log(e,false);
+            if( doLog ) foreach( const Record& r, i.value() ) log(toEntry(r),false);
         }
         d_numOfWrns = 0;
         for( i = d_wrns.begin(); i != d_wrns.end(); ++i )
@@ -280,6 +524,8 @@ const char* Errors::sourceName(int s)
         return "Syntax";
     case Semantics:
         return "Semantics";
+    case Generator:
+        return "Generator";
     default:
         return "";
     }
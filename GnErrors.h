@@ -25,14 +25,20 @@
 #include <QHash>
 #include <QSet>
 #include <QDir>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadStorage>
+#include <QVector>
 
 namespace Gn
 {
     class SynTree;
+    class DiagnosticsWriter;
 
     class Errors : public QObject
     {
-        // class is thread-safe
+        // class is thread-safe; each thread appends to its own buffer, the buffers are merged in a
+        // deterministic order when the results are queried; a thread exclusive instance uses no locks
     public:
         enum Source { Lexer, Syntax, Semantics, Generator };
         struct Entry
@@ -48,12 +54,28 @@ namespace Gn
         typedef QSet<Entry> EntryList;
         typedef QHash<QString,EntryList> EntriesByFile;
 
+        struct Msg
+        {
+            // fmt must be a static string; %1 and %2 are replaced by the args when the message is formatted
+            const char* d_fmt;
+            QByteArray d_arg1, d_arg2;
+            explicit Msg( const char* fmt = 0, const QByteArray& a1 = QByteArray(), const QByteArray& a2 = QByteArray() ):
+                d_fmt(fmt),d_arg1(a1),d_arg2(a2){}
+            QString toString() const;
+        };
+
         explicit Errors(QObject *parent = 0, bool threadExclusive = false );
+        ~Errors();
 
         void error( Source, const SynTree*, const QString& msg );
         void error( Source, const QString& file, int line, int col, const QString& msg );
         void warning( Source, const SynTree*, const QString& msg );
         void warning( Source, const QString& file, int line, int col, const QString& msg );
+        // cheap variants, file is usually a Lexer symbol
+        void error( Source, const SynTree*, const Msg& );
+        void error( Source, const QByteArray& file, quint32 line, quint16 col, const Msg& );
+        void warning( Source, const SynTree*, const Msg& );
+        void warning( Source, const QByteArray& file, quint32 line, quint16 col, const Msg& );
 
         bool showWarnings() const;
         void setShowWarnings(bool on);
@@ -61,7 +83,8 @@ namespace Gn
         void setReportToConsole(bool on);
         bool record() const;
         void setRecord(bool on);
-        void setRoot( const QDir& d ) { d_root = d; }
+        void setRoot( const QDir& );
+        void setWriter( DiagnosticsWriter* ); // not owned; gets each entry once when buffers are merged
 
         quint32 getErrCount() const;
         quint32 getWrnCount() const;
@@ -69,24 +92,58 @@ namespace Gn
         EntriesByFile getErrors() const;
         EntryList getWarnings(const QString& file) const;
         EntriesByFile getWarnings() const;
-        quint32 getSyntaxErrCount() const { return d_numOfSyntaxErrs; }
+        quint32 getSyntaxErrCount() const;
 
         void clear();
         void clearFile( const QString& file );
         void clearFiles( const QStringList& files );
         void update( const Errors&, bool overwrite = false );
+        void flush(); // merges the thread buffers; done implicitly by all getters
 
         static const char* sourceName(int);
     protected:
+        struct Record
+        {
+            QByteArray d_file; // UTF-8
+            quint32 d_line;
+            quint16 d_col;
+            quint8 d_source;
+            bool d_isErr;
+            Msg d_msg;
+            QString d_text; // used instead of d_msg if d_msg.d_fmt is null
+            Record():d_line(0),d_col(0),d_source(0),d_isErr(false){}
+            QString message() const { return d_msg.d_fmt ? d_msg.toString() : d_text; }
+            bool operator<( const Record& ) const;
+            bool operator==( const Record& ) const;
+        };
+        typedef QVector<Record> Records;
+        typedef QHash<QByteArray,Records> RecordsByFile; // sorted and unique per file
+        struct Buffer
+        {
+            QMutex d_lock; // only contended while merging
+            Records d_recs;
+        };
+        typedef QSharedPointer<Buffer> BufferRef;
+
+        void append( const Record& );
+        void merge( Records& pending );
+        static bool insert( Records&, const Record& );
+        static Entry toEntry( const Record& );
+        static EntriesByFile toEntries( const RecordsByFile& );
         void log( const Entry&, bool isErr );
     private:
         mutable QReadWriteLock d_lock;
         quint32 d_numOfErrs;
         quint32 d_numOfSyntaxErrs;
         quint32 d_numOfWrns;
-        EntriesByFile d_errs;
-        EntriesByFile d_wrns;
+        RecordsByFile d_errs;
+        RecordsByFile d_wrns;
         QDir d_root;
+        DiagnosticsWriter* d_writer;
+        Buffer d_own; // used if d_threadExclusive
+        QMutex d_bufLock;
+        QList<BufferRef> d_buffers; // all thread buffers ever created
+        QThreadStorage<BufferRef>* d_local; // the buffer of the current thread
         bool d_showWarnings;
         bool d_threadExclusive;
         bool d_reportToConsole;
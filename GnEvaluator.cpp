@@ -0,0 +1,3017 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnEvaluator.h"
+#include "GnCodeModel.h"
+#include "GnErrors.h"
+#include "GnFileCache.h"
+#include "GnLexer.h"
+#include "GnParser.h"
+#include "GnSynTree.h"
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSysInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QtDebug>
+#include <algorithm>
+using namespace Gn;
+
+enum Builtin { F_assert = 1, F_config, F_declare_args, F_defined, F_exec_script, F_filter_exclude,
+               F_filter_include, F_foreach, F_forward_variables_from, F_get_label_info, F_get_path_info,
+               F_get_target_outputs, F_getenv, F_import, F_not_needed, F_pool, F_print,
+               F_process_file_template, F_read_file, F_rebase_path, F_set_default_toolchain,
+               F_set_defaults, F_set_sources_assignment_filter, F_split_list, F_string_join,
+               F_string_replace, F_string_split, F_target, F_template, F_tool, F_toolchain, F_write_file };
+
+static const struct { const char* d_name; int d_id; } s_builtins[] =
+{
+    { "assert", F_assert },
+    { "config", F_config },
+    { "declare_args", F_declare_args },
+    { "defined", F_defined },
+    { "exec_script", F_exec_script },
+    { "filter_exclude", F_filter_exclude },
+    { "filter_include", F_filter_include },
+    { "foreach", F_foreach },
+    { "forward_variables_from", F_forward_variables_from },
+    { "get_label_info", F_get_label_info },
+    { "get_path_info", F_get_path_info },
+    { "get_target_outputs", F_get_target_outputs },
+    { "getenv", F_getenv },
+    { "import", F_import },
+    { "not_needed", F_not_needed },
+    { "pool", F_pool },
+    { "print", F_print },
+    { "process_file_template", F_process_file_template },
+    { "read_file", F_read_file },
+    { "rebase_path", F_rebase_path },
+    { "set_default_toolchain", F_set_default_toolchain },
+    { "set_defaults", F_set_defaults },
+    { "set_sources_assignment_filter", F_set_sources_assignment_filter },
+    { "split_list", F_split_list },
+    { "string_join", F_string_join },
+    { "string_replace", F_string_replace },
+    { "string_split", F_string_split },
+    { "target", F_target },
+    { "template", F_template },
+    { "tool", F_tool },
+    { "toolchain", F_toolchain },
+    { "write_file", F_write_file },
+    { 0, 0 }
+};
+
+static const char* s_targetTypes[] =
+{
+    "action", "action_foreach", "bundle_data", "copy", "create_bundle", "executable", "generated_file",
+    "group", "loadable_module", "rust_library", "rust_proc_macro", "shared_library", "source_set",
+    "static_library",
+    0
+};
+
+static const char* s_binaryTypes[] =
+{
+    "executable", "loadable_module", "shared_library", "source_set", "static_library",
+    0
+};
+
+// variables holding paths relative to the dir of the defining file
+static const char* s_pathVars[] =
+{
+    "sources", "public", "inputs", "include_dirs", "lib_dirs", "data", "script", "outputs",
+    0
+};
+
+// variables holding labels
+static const char* s_labelVars[] =
+{
+    "deps", "public_deps", "data_deps", "configs", "public_configs", "all_dependent_configs",
+    0
+};
+
+static const char* s_names[] =
+{
+    "target_name", "invoker", "defines", "cflags", "cflags_c", "cflags_cc", "asmflags", "ldflags",
+    "libs", "output_name", "output_dir", "output_extension", "args", "testonly",
+    "buildconfig", "default_args", "current_toolchain", "default_toolchain",
+    "target_gen_dir", "target_out_dir", "toolchain_args",
+    0
+};
+
+enum { MaxDepth = 64 };
+
+// origin of the lookups which end in the builtins and the build config; imports and BUILD.gn use their file
+static const char* s_baseOrigin = "//:base";
+
+struct Evaluator::InstanceFrame // of a template invocation being run
+{
+    ImportCache::Instance d_inst;
+    const ValueScope* d_body;
+    QList<Item*> d_items; // registered while it runs, copied to d_inst at the end
+};
+
+bool Value::operator==(const Value& rhs) const
+{
+    if( d_type != rhs.d_type )
+        return false;
+    switch( d_type )
+    {
+    case None:
+        return true;
+    case Bool:
+    case Int:
+        return d_int == rhs.d_int;
+    case String:
+        return d_str == rhs.d_str;
+    case List:
+        return d_list == rhs.d_list;
+    case Scope:
+        if( d_scope == rhs.d_scope )
+            return true;
+        if( !d_scope || !rhs.d_scope )
+            return false;
+        return d_scope->d_vars == rhs.d_scope->d_vars;
+    }
+    return false;
+}
+
+static QByteArray quote( const QByteArray& str )
+{
+    QByteArray res;
+    res.reserve( str.size() + 2 );
+    res += '"';
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        if( c == '"' || c == '$' || c == '\\' )
+            res += '\\';
+        res += c;
+    }
+    res += '"';
+    return res;
+}
+
+QByteArray Value::toString(bool quoted) const
+{
+    switch( d_type )
+    {
+    case Bool:
+        return d_int ? "true" : "false";
+    case Int:
+        return QByteArray::number(d_int);
+    case String:
+        return quoted ? quote(d_str) : d_str;
+    case List:
+        {
+            QByteArray res = "[";
+            for( int i = 0; i < d_list.size(); i++ )
+            {
+                if( i != 0 )
+                    res += ", ";
+                res += d_list[i].toString(true);
+            }
+            res += "]";
+            return res;
+        }
+    case Scope:
+        {
+            if( !d_scope )
+                return "{ }";
+            QByteArrayList names;
+            ValueScope::Vars::const_iterator i;
+            for( i = d_scope->d_vars.begin(); i != d_scope->d_vars.end(); ++i )
+                names.append( i.key() );
+            std::sort( names.begin(), names.end() );
+            QByteArray res = "{ ";
+            foreach( const QByteArray& n, names )
+            {
+                res += n + " = " + d_scope->d_vars.value( Lexer::getSymbol(n).constData() ).toString(true) + " ";
+            }
+            res += "}";
+            return res;
+        }
+    default:
+        return "<undefined>";
+    }
+}
+
+QByteArrayList Value::toStringList() const
+{
+    QByteArrayList res;
+    if( d_type == String )
+        res.append( d_str );
+    else if( d_type == List )
+    {
+        foreach( const Value& v, d_list )
+            res.append( v.d_type == String ? v.d_str : v.toString() );
+    }
+    return res;
+}
+
+const char*Value::typeName(int t)
+{
+    switch( t )
+    {
+    case Bool:
+        return "boolean";
+    case Int:
+        return "integer";
+    case String:
+        return "string";
+    case List:
+        return "list";
+    case Scope:
+        return "scope";
+    default:
+        return "none";
+    }
+}
+
+const Value*ValueScope::find(const char* name, bool recursive) const
+{
+    const ValueScope* s = this;
+    while( s )
+    {
+        Vars::const_iterator i = s->d_vars.constFind(name);
+        if( i != s->d_vars.constEnd() )
+            return &i.value();
+        if( !recursive )
+            break;
+        s = s->d_outer;
+    }
+    return 0;
+}
+
+const ValueScope::Template*ValueScope::findTemplate(const char* name) const
+{
+    const ValueScope* s = this;
+    while( s )
+    {
+        Templates::const_iterator i = s->d_templates.constFind(name);
+        if( i != s->d_templates.constEnd() )
+            return &i.value();
+        s = s->d_outer;
+    }
+    return 0;
+}
+
+ScopeRef ValueScope::findDefaults(const char* type) const
+{
+    const ValueScope* s = this;
+    while( s )
+    {
+        Defaults::const_iterator i = s->d_defaults.constFind(type);
+        if( i != s->d_defaults.constEnd() )
+            return i.value();
+        s = s->d_outer;
+    }
+    return ScopeRef();
+}
+
+void ValueScope::merge(const ValueScope& rhs)
+{
+    Vars::const_iterator i;
+    for( i = rhs.d_vars.begin(); i != rhs.d_vars.end(); ++i )
+    {
+        if( i.key()[0] != '_' )
+            d_vars.insert( i.key(), i.value() );
+    }
+    Templates::const_iterator j;
+    for( j = rhs.d_templates.begin(); j != rhs.d_templates.end(); ++j )
+    {
+        if( j.key()[0] != '_' )
+            d_templates.insert( j.key(), j.value() );
+    }
+    Defaults::const_iterator k;
+    for( k = rhs.d_defaults.begin(); k != rhs.d_defaults.end(); ++k )
+        d_defaults.insert( k.key(), k.value() );
+}
+
+QByteArrayList EvalItem::getList(const char* name) const
+{
+    const Value* v = d_values ? d_values->find(name,false) : 0;
+    if( v )
+        return v->toStringList();
+    return QByteArrayList();
+}
+
+QByteArray EvalItem::getString(const char* name) const
+{
+    const Value* v = d_values ? d_values->find(name,false) : 0;
+    if( v && v->d_type == Value::String )
+        return v->d_str;
+    return QByteArray();
+}
+
+bool EvalItem::getBool(const char* name, bool defaultValue) const
+{
+    const Value* v = d_values ? d_values->find(name,false) : 0;
+    if( v && v->d_type == Value::Bool )
+        return v->d_int;
+    return defaultValue;
+}
+
+Evaluator::Evaluator(CodeModel* mdl, Errors* errs):d_mdl(mdl),d_errs(errs),d_buildDir("//out/Default"),
+    d_outRoot("//out/Default"),
+    d_argsTree(0),d_curTools(0),d_depth(0),d_cache(0),d_errCount(0),d_ownCache(0),d_prepared(false),
+    d_cancelFlag(0),d_canceled(&d_cancelFlag)
+{
+    Q_ASSERT( mdl != 0 );
+    if( d_errs == 0 )
+        d_errs = mdl->getErrs();
+    for( int i = 0; s_builtins[i].d_name; i++ )
+        d_functions.insert( Lexer::getSymbol(s_builtins[i].d_name).constData(), s_builtins[i].d_id );
+    const char** s = s_targetTypes;
+    while( *s )
+        d_targetTypes.insert( Lexer::getSymbol(*s++).constData() );
+    s = s_binaryTypes;
+    while( *s )
+        d_binaryTypes.insert( Lexer::getSymbol(*s++).constData() );
+    const char** lists[] = { s_targetTypes, s_pathVars, s_labelVars, s_names, 0 };
+    for( int l = 0; lists[l]; l++ )
+    {
+        for( s = lists[l]; *s; s++ )
+            d_syms.insert( *s, Lexer::getSymbol(*s).constData() );
+    }
+    for( int i = 0; s_builtins[i].d_name; i++ )
+        d_syms.insert( s_builtins[i].d_name, Lexer::getSymbol(s_builtins[i].d_name).constData() );
+    d_args = new ValueScope();
+}
+
+Evaluator::~Evaluator()
+{
+    clearResults();
+    if( d_argsTree )
+        delete d_argsTree;
+}
+
+QByteArray Evaluator::getToolchain() const
+{
+    return d_toolchain.isEmpty() ? d_defaultToolchain : d_toolchain;
+}
+
+Evaluator* Evaluator::getPass(const QByteArray& toolchain) const
+{
+    if( toolchain.isEmpty() || toolchain == getToolchain() )
+        return const_cast<Evaluator*>(this);
+    foreach( Evaluator* p, d_passes )
+    {
+        if( p->d_toolchain == toolchain )
+            return p;
+    }
+    return 0;
+}
+
+void Evaluator::setArgs(const QByteArray& args)
+{
+    if( d_argsTree )
+        delete d_argsTree;
+    d_argsTree = 0;
+    d_args = new ValueScope();
+
+    QBuffer buf;
+    buf.setData( args );
+    buf.open(QIODevice::ReadOnly);
+    Lexer lex;
+    lex.setStream( &buf, "args.gn" );
+    lex.setErrors(d_errs);
+    lex.setIgnoreComments(true);
+    Parser p(&lex,d_errs);
+    p.RunParser();
+    if( p.d_root.d_children.isEmpty() )
+        return;
+    d_argsTree = p.d_root.d_children.first();
+    p.d_root.d_children.clear();
+    const QByteArray dir = d_curDir;
+    d_curDir = "//";
+    statementList( d_argsTree, d_args.data() );
+    d_curDir = dir;
+}
+
+bool Evaluator::setArgsFile(const QString& path)
+{
+    bool ok;
+    const QByteArray content = d_mdl->getFileCache()->readFile( path, &ok );
+    if( !ok )
+    {
+        d_errs->error( Errors::Semantics, path, 0, 0, "cannot open args file for reading" );
+        return false;
+    }
+    setArgs( content );
+    return true;
+}
+
+void Evaluator::clearResults()
+{
+    qDeleteAll(d_targets);
+    d_targets.clear();
+    qDeleteAll(d_configs);
+    d_configs.clear();
+    qDeleteAll(d_toolchains);
+    d_toolchains.clear();
+    d_targetsByLabel.clear();
+    d_configsByLabel.clear();
+    d_inherited.clear();
+    d_toolchainsByLabel.clear();
+    d_imports.clear();
+    d_fileScopes.clear();
+    d_loadedDirs.clear();
+    d_pendingDirs.clear();
+    d_sourcesFilter.clear();
+    d_overrides.clear();
+    d_defaultToolchain.clear();
+    d_base.reset();
+    d_curTools = 0;
+    d_depth = 0;
+    d_outcomes.clear();
+    d_recording.clear();
+    d_importReads.clear();
+    d_rebound.clear();
+    d_origins.clear();
+    d_originScopes.clear();
+    d_instRecording.clear();
+    d_invocations.clear();
+    d_instances.clear();
+    d_toolchainRefs.clear();
+    qDeleteAll(d_passes);
+    d_passes.clear();
+    if( d_ownCache )
+    {
+        if( d_cache == d_ownCache )
+            d_cache = 0;
+        delete d_ownCache;
+        d_ownCache = 0;
+    }
+    d_prepared = false;
+}
+
+static QByteArray hostCpu()
+{
+    const QString arch = QSysInfo::currentCpuArchitecture();
+    if( arch == "x86_64" )
+        return "x64";
+    if( arch == "i386" )
+        return "x86";
+    return arch.toUtf8();
+}
+
+static QByteArray hostOs()
+{
+#if defined(Q_OS_WIN)
+    return "win";
+#elif defined(Q_OS_MAC)
+    return "mac";
+#elif defined(Q_OS_LINUX)
+    return "linux";
+#else
+    return QSysInfo::kernelType().toUtf8();
+#endif
+}
+
+bool Evaluator::evaluate(const QByteArrayList& roots)
+{
+    clearResults();
+    const quint32 errCount = d_errs->getErrCount();
+    d_prepared = true;
+    if( !prepare() )
+        return false;
+
+    if( roots.isEmpty() )
+        queueDir( "//" );
+    foreach( const QByteArray& r, roots )
+    {
+        const QByteArray label = resolveLabel( r, "//" );
+        queueDir( label.left( label.indexOf(':') ) );
+    }
+    runPending();
+
+    return d_errs->getErrCount() == errCount && !isCanceled();
+}
+
+bool Evaluator::prepare()
+{
+    // a pass of another toolchain writes to a subdir of the build dir, like gn does
+    d_outRoot = d_buildDir;
+    if( !d_toolchain.isEmpty() )
+        d_outRoot += "/" + d_toolchain.mid( d_toolchain.indexOf(':') + 1 );
+
+    // the dotfile only sets a few variables
+    ScopeRef dot( new ValueScope() );
+    if( !runFile( "//.gn", dot.data() ) )
+        return false;
+    const Value* buildConfig = dot->find(getSymbol("buildconfig"));
+    if( buildConfig == 0 || buildConfig->d_type != Value::String )
+    {
+        d_errs->error( Errors::Semantics, toFilePath("//.gn"), 0, 0, "buildconfig is not set" );
+        return false;
+    }
+    const Value* defaultArgs = dot->find(getSymbol("default_args"));
+    if( defaultArgs && defaultArgs->d_type == Value::Scope )
+        d_overrides = defaultArgs->d_scope->d_vars;
+    ValueScope::Vars::const_iterator i;
+    for( i = d_args->d_vars.begin(); i != d_args->d_vars.end(); ++i )
+        d_overrides.insert( i.key(), i.value() );
+    if( d_toolchainArgs )
+    {
+        for( i = d_toolchainArgs->d_vars.begin(); i != d_toolchainArgs->d_vars.end(); ++i )
+            d_overrides.insert( i.key(), i.value() );
+    }
+
+    d_base = new ValueScope();
+    addOrigin( s_baseOrigin, d_base );
+    struct { const char* d_name; Value d_val; } builtins[] = {
+        { "host_os", Value(hostOs()) },
+        { "host_cpu", Value(hostCpu()) },
+        { "target_os", Value(QByteArray("")) },
+        { "target_cpu", Value(QByteArray("")) },
+        { "current_os", Value(QByteArray("")) },
+        { "current_cpu", Value(QByteArray("")) },
+        { "current_toolchain", Value(d_toolchain) },
+        { "default_toolchain", Value(d_defaultToolchain) },
+        { "root_build_dir", Value(d_buildDir) },
+        { "root_gen_dir", Value(d_outRoot + "/gen") },
+        { "root_out_dir", Value(d_outRoot) },
+        { "python_path", Value(QByteArray("python")) },
+        { "gn_version", Value(qint64(1800)) },
+        { 0, Value() }
+    };
+    for( int b = 0; builtins[b].d_name; b++ )
+    {
+        const char* name = Lexer::getSymbol(builtins[b].d_name).constData();
+        ValueScope::Vars::const_iterator o = d_overrides.constFind(name);
+        d_base->set( name, o != d_overrides.constEnd() ? o.value() : builtins[b].d_val );
+    }
+
+    runFile( resolvePath( buildConfig->d_str, "//" ), d_base.data() );
+    if( !d_defaultToolchain.isEmpty() )
+    {
+        d_base->set( getSymbol("default_toolchain"), Value(d_defaultToolchain) );
+        const Value* cur = d_base->find(getSymbol("current_toolchain"));
+        if( cur == 0 || cur->d_str.isEmpty() )
+            d_base->set( getSymbol("current_toolchain"), Value(d_defaultToolchain) );
+    }
+    return true;
+}
+
+void Evaluator::runPending()
+{
+    while( !d_pendingDirs.isEmpty() && !isCanceled() )
+        loadDir( d_pendingDirs.takeFirst() );
+}
+
+void Evaluator::runPass()
+{
+    if( !d_prepared )
+    {
+        d_prepared = true;
+        prepare();
+    }
+    if( !d_base )
+        d_pendingDirs.clear(); // the dotfile or build config is missing, which was already reported
+    runPending();
+}
+
+namespace Gn
+{
+    class PassTask : public QRunnable
+    {
+    public:
+        PassTask( const QList<Evaluator*>& todo, QAtomicInt& next ):d_todo(todo),d_next(next){}
+        void run()
+        {
+            int i;
+            while( ( i = d_next.fetchAndAddOrdered(1) ) < d_todo.size() )
+                d_todo[i]->runPass();
+        }
+    private:
+        const QList<Evaluator*>& d_todo;
+        QAtomicInt& d_next;
+    };
+}
+
+bool Evaluator::evaluateToolchains(int threads)
+{
+    Q_ASSERT( d_toolchain.isEmpty() );
+    if( !d_base )
+        return false;
+    const quint32 errCount = d_errs->getErrCount();
+    if( d_cache == 0 )
+        d_cache = d_ownCache = new ImportCache();
+    if( threads <= 0 )
+        threads = QThread::idealThreadCount();
+    QSet<QByteArray> undefined;
+    while( !isCanceled() )
+    {
+        // the passes may reference further toolchains or further dirs of a toolchain already run
+        QMap<QByteArray,QSet<QByteArray> > refs;
+        QList<Evaluator*> all;
+        all << this << d_passes;
+        foreach( Evaluator* e, all )
+        {
+            QMap<QByteArray,QSet<QByteArray> >::const_iterator i;
+            for( i = e->d_toolchainRefs.begin(); i != e->d_toolchainRefs.end(); ++i )
+                refs[i.key()] += i.value();
+        }
+        QMap<QByteArray,QSet<QByteArray> >::const_iterator i;
+        for( i = refs.begin(); i != refs.end(); ++i )
+        {
+            if( undefined.contains(i.key()) )
+                continue;
+            Evaluator* pass = getPass(i.key());
+            if( pass == 0 )
+            {
+                const Toolchain* tc = findToolchain(i.key());
+                for( int j = 0; tc == 0 && j < d_passes.size(); j++ )
+                    tc = d_passes[j]->findToolchain(i.key());
+                if( tc == 0 )
+                {
+                    // the dir of the toolchain is loaded by the default pass first
+                    const QByteArray dir = i.key().left( i.key().indexOf(':') );
+                    if( d_loadedDirs.contains(dir) && !d_pendingDirs.contains(dir) )
+                    {
+                        undefined.insert(i.key());
+                        d_errs->error( Errors::Semantics, toFilePath( dir == "//" ? QByteArray("//BUILD.gn") :
+                                                                      dir + "/BUILD.gn" ), 0, 0,
+                                       QString("toolchain not defined: %1").arg(i.key().constData()) );
+                    }else
+                        queueDir( dir );
+                    continue;
+                }
+                pass = new Evaluator( d_mdl, d_errs );
+                pass->d_toolchain = i.key();
+                pass->d_defaultToolchain = d_defaultToolchain;
+                pass->d_buildDir = d_buildDir;
+                pass->d_args = d_args;
+                pass->d_cache = d_cache;
+                pass->d_canceled = d_canceled;
+                const Value* args = tc->d_values->find( getSymbol("toolchain_args"), false );
+                if( args && args->d_type == Value::Scope )
+                    pass->d_toolchainArgs = args->d_scope;
+                d_passes.append( pass );
+            }
+            foreach( const QByteArray& dir, i.value() )
+                pass->queueDir( dir );
+        }
+        QList<Evaluator*> todo;
+        if( !d_pendingDirs.isEmpty() )
+            todo << this;
+        foreach( Evaluator* p, d_passes )
+        {
+            if( !p->d_prepared || !p->d_pendingDirs.isEmpty() )
+                todo << p;
+        }
+        if( todo.isEmpty() )
+            break;
+        // each pass only changes itself; the model, the Errors and the ImportCache are thread-safe
+        const int n = qMax( 1, qMin( threads, todo.size() ) );
+        QAtomicInt next(0);
+        if( n == 1 )
+        {
+            PassTask t( todo, next );
+            t.run();
+        }else
+        {
+            QThreadPool pool;
+            pool.setMaxThreadCount( n );
+            for( int k = 0; k < n; k++ )
+                pool.start( new PassTask( todo, next ) );
+            pool.waitForDone();
+        }
+    }
+    return d_errs->getErrCount() == errCount && !isCanceled();
+}
+
+void Evaluator::collectToolchainRefs(const ValueScope& sc)
+{
+    const QByteArray own = getToolchain();
+    for( int k = 0; s_labelVars[k]; k++ )
+    {
+        const Value* v = sc.find( getSymbol(s_labelVars[k]), false );
+        if( v == 0 || v->d_type != Value::List )
+            continue;
+        foreach( const Value& l, v->d_list )
+        {
+            if( l.d_type != Value::String || !l.d_str.endsWith(')') )
+                continue;
+            QByteArray tc;
+            const QByteArray label = resolveLabel( l.d_str, d_curDir, &tc );
+            if( tc.isEmpty() || tc == own )
+                continue;
+            d_toolchainRefs[tc].insert( label.left( label.indexOf(':') ) );
+            queueDir( tc.left( tc.indexOf(':') ) ); // so the definition of the toolchain is known
+            foreach( InstanceFrame* f, d_instRecording )
+                f->d_inst.d_cacheable = false; // the copied items would not reference the toolchain
+
+        }
+    }
+}
+
+namespace
+{
+    // counts shared data once, so data shared with another pass is counted in both
+    struct MemoryCounter
+    {
+        Evaluator::Memory d_mem;
+        QSet<const void*> d_seen;
+
+        void add( const QByteArray& str )
+        {
+            if( !str.isEmpty() && !d_seen.contains(str.constData()) )
+            {
+                d_seen.insert(str.constData());
+                d_mem.d_bytes += str.size() + 1;
+            }
+        }
+        void add( const Value& v )
+        {
+            d_mem.d_values++;
+            switch( v.d_type )
+            {
+            case Value::String:
+                add( v.d_str );
+                break;
+            case Value::List:
+                if( !v.d_list.isEmpty() && !d_seen.contains(&v.d_list.first()) )
+                {
+                    d_seen.insert(&v.d_list.first());
+                    d_mem.d_bytes += v.d_list.size() * ( sizeof(Value) + sizeof(void*) );
+                    foreach( const Value& e, v.d_list )
+                        add( e );
+                }
+                break;
+            case Value::Scope:
+                add( v.d_scope.data() );
+                break;
+            default:
+                break;
+            }
+        }
+        void add( const ValueScope* s )
+        {
+            if( s == 0 || d_seen.contains(s) )
+                return;
+            d_seen.insert(s);
+            d_mem.d_scopes++;
+            d_mem.d_bytes += sizeof(ValueScope) +
+                    ( s->d_vars.size() + s->d_templates.size() + s->d_defaults.size() ) *
+                    ( sizeof(Value) + 3 * sizeof(void*) ); // hash nodes
+            ValueScope::Vars::const_iterator i;
+            for( i = s->d_vars.begin(); i != s->d_vars.end(); ++i )
+                add( i.value() );
+            ValueScope::Defaults::const_iterator j;
+            for( j = s->d_defaults.begin(); j != s->d_defaults.end(); ++j )
+                add( j.value().data() );
+        }
+    };
+}
+
+Evaluator::Memory Evaluator::getMemory() const
+{
+    MemoryCounter c;
+    c.add( d_base.data() );
+    foreach( const ScopeRef& s, d_imports )
+        c.add( s.data() );
+    foreach( const ScopeRef& s, d_fileScopes )
+        c.add( s.data() );
+    foreach( const ScopeRef& s, d_rebound )
+        c.add( s.data() );
+    const Items* lists[] = { &d_targets, &d_configs, &d_toolchains, 0 };
+    for( int k = 0; lists[k]; k++ )
+    {
+        foreach( const Item* i, *lists[k] )
+        {
+            c.d_mem.d_items++;
+            c.d_mem.d_bytes += sizeof(Item) + i->d_label.size() + i->d_dir.size() + i->d_name.size();
+            c.add( i->d_values.data() );
+            foreach( const ScopeRef& t, i->d_tools )
+                c.add( t.data() );
+        }
+    }
+    return c.d_mem;
+}
+
+void Evaluator::queueDir(const QByteArray& dir)
+{
+    if( d_loadedDirs.contains(dir) )
+        return;
+    d_loadedDirs.insert(dir);
+    d_pendingDirs.append(dir);
+}
+
+void Evaluator::loadDir(const QByteArray& dir)
+{
+    const QByteArray path = dir == "//" ? QByteArray("//BUILD.gn") : dir + "/BUILD.gn";
+    ScopeRef s( new ValueScope(d_base.data()) );
+    d_fileScopes.append(s); // templates defined in the file refer to it
+    addOrigin( Lexer::getSymbol(path).constData(), s );
+    runFile( path, s.data() );
+}
+
+SynTree*Evaluator::getFileTree(const QByteArray& sourceAbsolute)
+{
+    const QString path = toFilePath(sourceAbsolute);
+    CodeModel::Scope* s = d_mdl->getScope(path.toUtf8());
+    if( s == 0 )
+    {
+        const QString canonical = QFileInfo(path).canonicalFilePath();
+        if( !canonical.isEmpty() && canonical != path )
+            s = d_mdl->getScope(canonical.toUtf8());
+    }
+    return s ? s->d_st : 0;
+}
+
+bool Evaluator::runFile(const QByteArray& sourceAbsolute, ValueScope* scope)
+{
+    SynTree* st = getFileTree(sourceAbsolute);
+    if( st == 0 )
+    {
+        d_errs->error( Errors::Semantics, toFilePath(sourceAbsolute), 0, 0,
+                       QString("file not found or not parsed: %1").arg(sourceAbsolute.constData()) );
+        return false;
+    }
+    const QByteArray dir = d_curDir;
+    d_curDir = dirOf(sourceAbsolute);
+    statementList( st, scope );
+    d_curDir = dir;
+    return true;
+}
+
+void Evaluator::statementList(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_StatementList );
+    foreach( SynTree* s, st->d_children )
+        statement(s,sc);
+}
+
+void Evaluator::statement(SynTree* st, ValueScope* sc)
+{
+    if( st->d_children.isEmpty() )
+        return;
+    SynTree* sub = st->d_children.first();
+    switch( sub->d_tok.d_type )
+    {
+    case SynTree::R_Assignment:
+        assignment( sub, sc );
+        break;
+    case SynTree::R_Call:
+        call( sub, sc );
+        break;
+    case SynTree::R_Condition:
+        condition( sub, sc );
+        break;
+    default:
+        break;
+    }
+}
+
+static inline int opOf( SynTree* op )
+{
+    // R_BinaryOp, R_AssignOp or R_UnaryOp with the operator token as child
+    return op->d_children.isEmpty() ? op->d_tok.d_type : op->d_children.first()->d_tok.d_type;
+}
+
+Value* Evaluator::mutableVar(ValueScope* sc, const char* name)
+{
+    ValueScope::Vars::iterator i = sc->d_vars.find(name);
+    if( i != sc->d_vars.end() )
+        return &i.value();
+    const Value* outer = sc->d_outer ? sc->d_outer->find(name) : 0;
+    if( recording() )
+        recordVar( sc, name, outer );
+    if( outer == 0 )
+        return 0;
+    // += and -= on a variable of an enclosing scope modify a copy in the current scope
+    return &( sc->d_vars[name] = *outer );
+}
+
+void Evaluator::assign(SynTree* at, ValueScope* sc, const char* name, int op, const Value& rhs)
+{
+    Value v = rhs;
+    if( name == getSymbol("sources") && !d_sourcesFilter.isEmpty() && v.d_type == Value::List )
+    {
+        Value::ValueList l;
+        foreach( const Value& e, v.d_list )
+        {
+            bool drop = false;
+            foreach( const QByteArray& p, d_sourcesFilter )
+            {
+                if( e.d_type == Value::String && matchPattern( p, e.d_str ) )
+                {
+                    drop = true;
+                    break;
+                }
+            }
+            if( !drop )
+                l.append(e);
+        }
+        v.d_list = l;
+    }
+    if( op == Tok_Eq )
+    {
+        sc->set( name, v );
+        return;
+    }
+    Value* cur = mutableVar( sc, name );
+    if( cur == 0 )
+    {
+        error( at, "undefined identifier: %1", name );
+        return;
+    }
+    *cur = binaryOp( at, op == Tok_PlusEq ? Tok_Plus : Tok_Minus, *cur, v );
+}
+
+void Evaluator::assignment(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_children.size() == 3 );
+    SynTree* lv = st->d_children.first();
+    const int op = opOf( st->d_children[1] );
+    const Value rhs = expr( st->d_children.last(), sc );
+    SynTree* id = lv->d_children.first();
+    const char* name = id->d_tok.d_val.constData();
+
+    if( lv->d_children.size() == 1 )
+    {
+        assign( id, sc, name, op, rhs );
+    }else if( lv->d_children[1]->d_tok.d_type == Tok_Lbrack )
+    {
+        const Value index = checkType( lv->d_children[2], expr( lv->d_children[2], sc ), Value::Int );
+        Value* l = mutableVar( sc, name );
+        if( l == 0 || l->d_type != Value::List )
+        {
+            error( id, "expecting a list: %1", name );
+            return;
+        }
+        if( index.d_type != Value::Int || index.d_int < 0 || index.d_int >= l->d_list.size() )
+        {
+            error( id, "index out of range: %1", index.toString() );
+            return;
+        }
+        Value& e = l->d_list[index.d_int];
+        e = op == Tok_Eq ? rhs : binaryOp( id, op == Tok_PlusEq ? Tok_Plus : Tok_Minus, e, rhs );
+    }else
+    {
+        Value* s = mutableVar( sc, name );
+        if( s == 0 || s->d_type != Value::Scope )
+        {
+            error( id, "expecting a scope: %1", name );
+            return;
+        }
+        s->d_scope.detach(); // the scope value might be shared with other variables
+        SynTree* member = lv->d_children.last();
+        assign( member, s->d_scope.data(), member->d_tok.d_val.constData(), op, rhs );
+    }
+}
+
+void Evaluator::condition(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_tok.d_type == SynTree::R_Condition && st->d_children.size() >= 5 );
+    const Value c = checkType( st->d_children[2], expr( st->d_children[2], sc ), Value::Bool );
+    const bool taken = c.d_type == Value::Bool && c.d_int;
+    // a condition in a template or foreach can go both ways, so the flags accumulate
+    if( c.d_type == Value::Bool )
+    {
+        d_outcomes[st->d_tok.d_sourcePath.constData()][st] |= taken ? ThenTaken : ElseTaken;
+        foreach( InstanceFrame* f, d_instRecording )
+            f->d_inst.d_outcomes.append( QPair<const SynTree*,quint8>( st, taken ? ThenTaken : ElseTaken ) );
+    }
+    if( taken )
+        block( st->d_children[4], sc );
+    else if( st->d_children.size() > 6 )
+    {
+        if( st->d_children[6]->d_tok.d_type == SynTree::R_Condition )
+            condition( st->d_children[6], sc );
+        else
+            block( st->d_children[6], sc );
+    }
+}
+
+void Evaluator::block(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_tok.d_type == SynTree::R_Block && st->d_children.size() == 3 );
+    statementList( st->d_children[1], sc );
+}
+
+static void flattenNlr( SynTree* nlr, QList<SynTree*>& operands, QList<int>& ops );
+
+static void flattenExpr( SynTree* e, QList<SynTree*>& operands, QList<int>& ops )
+{
+    operands.append( e->d_children.first() );
+    if( e->d_children.size() > 1 )
+        flattenNlr( e->d_children[1], operands, ops );
+}
+
+static void flattenNlr( SynTree* nlr, QList<SynTree*>& operands, QList<int>& ops )
+{
+    ops.append( opOf( nlr->d_children.first() ) );
+    flattenExpr( nlr->d_children[1], operands, ops );
+    if( nlr->d_children.size() > 2 )
+        flattenNlr( nlr->d_children[2], operands, ops );
+}
+
+static inline int precedence( int op )
+{
+    switch( op )
+    {
+    case Tok_Plus:
+    case Tok_Minus:
+        return 5;
+    case Tok_Lt:
+    case Tok_Leq:
+    case Tok_Gt:
+    case Tok_Geq:
+        return 4;
+    case Tok_2Eq:
+    case Tok_BangEq:
+        return 3;
+    case Tok_2Amp:
+        return 2;
+    case Tok_2Bar:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+Value Evaluator::expr(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_Expr && !st->d_children.isEmpty() );
+    if( st->d_children.size() == 1 )
+        return unaryExpr( st->d_children.first(), sc );
+    // the parser builds a right leaning chain; it is flattened and evaluated by precedence climbing
+    SynTreeList operands;
+    QList<int> ops;
+    flattenExpr( st, operands, ops );
+    int pos = 0;
+    return binary( operands, ops, pos, 1, sc, false );
+}
+
+Value Evaluator::binary(const SynTreeList& operands, const QList<int>& ops, int& pos, int minPrec,
+                        ValueScope* sc, bool skip)
+{
+    Value lhs = skip ? Value() : unaryExpr( operands[pos], sc );
+    while( pos < ops.size() && precedence( ops[pos] ) >= minPrec )
+    {
+        const int op = ops[pos];
+        const int prec = precedence(op);
+        pos++;
+        SynTree* at = operands[pos];
+        if( op == Tok_2Amp || op == Tok_2Bar )
+        {
+            bool l = false;
+            if( !skip )
+                l = checkType( operands[pos-1], lhs, Value::Bool ).d_int;
+            // the right side is only evaluated if it decides the result
+            const bool shortCut = skip || ( op == Tok_2Amp ? !l : l );
+            const Value rhs = binary( operands, ops, pos, prec + 1, sc, shortCut );
+            if( !skip )
+                lhs = shortCut ? Value(l) : Value( bool(checkType( at, rhs, Value::Bool ).d_int) );
+        }else
+        {
+            const Value rhs = binary( operands, ops, pos, prec + 1, sc, skip );
+            if( !skip )
+                lhs = binaryOp( at, op, lhs, rhs );
+        }
+    }
+    return lhs;
+}
+
+Value Evaluator::binaryOp(SynTree* at, int op, const Value& lhs, const Value& rhs)
+{
+    switch( op )
+    {
+    case Tok_Plus:
+        if( lhs.d_type == Value::Int && rhs.d_type == Value::Int )
+            return Value( lhs.d_int + rhs.d_int );
+        if( lhs.d_type == Value::String && rhs.d_type != Value::List && rhs.d_type != Value::None )
+            return Value( lhs.d_str + rhs.toString() );
+        if( lhs.d_type == Value::List )
+        {
+            Value res = lhs;
+            if( rhs.d_type == Value::List )
+                res.d_list += rhs.d_list;
+            else if( rhs.d_type != Value::None )
+                res.d_list.append(rhs);
+            return res;
+        }
+        break;
+    case Tok_Minus:
+        if( lhs.d_type == Value::Int && rhs.d_type == Value::Int )
+            return Value( lhs.d_int - rhs.d_int );
+        if( lhs.d_type == Value::List )
+        {
+            Value res = lhs;
+            if( rhs.d_type == Value::List )
+            {
+                foreach( const Value& v, rhs.d_list )
+                    res.d_list.removeAll(v);
+            }else
+                res.d_list.removeAll(rhs);
+            return res;
+        }
+        break;
+    case Tok_Lt:
+    case Tok_Leq:
+    case Tok_Gt:
+    case Tok_Geq:
+        if( lhs.d_type == Value::Int && rhs.d_type == Value::Int )
+        {
+            switch( op )
+            {
+            case Tok_Lt:
+                return Value( lhs.d_int < rhs.d_int );
+            case Tok_Leq:
+                return Value( lhs.d_int <= rhs.d_int );
+            case Tok_Gt:
+                return Value( lhs.d_int > rhs.d_int );
+            default:
+                return Value( lhs.d_int >= rhs.d_int );
+            }
+        }
+        break;
+    case Tok_2Eq:
+        return Value( lhs == rhs );
+    case Tok_BangEq:
+        return Value( lhs != rhs );
+    }
+    error( at, "invalid operand types: %1 and %2", Value::typeName(lhs.d_type), Value::typeName(rhs.d_type) );
+    return Value();
+}
+
+Value Evaluator::unaryExpr(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st != 0 && st->d_tok.d_type == SynTree::R_UnaryExpr );
+    if( st->d_children.size() == 1 )
+        return primaryExpr( st->d_children.first(), sc );
+    const Value v = checkType( st, unaryExpr( st->d_children.last(), sc ), Value::Bool );
+    return Value( !v.d_int );
+}
+
+Value Evaluator::primaryExpr(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st != 0 && !st->d_children.isEmpty() );
+    SynTree* sub = st->d_children.first();
+    switch( sub->d_tok.d_type )
+    {
+    case SynTree::R_Call:
+        return call( sub, sc );
+    case Tok_string:
+        return string( sub, sc );
+    case Tok_Lpar:
+        Q_ASSERT( st->d_children.size() == 3 );
+        return expr( st->d_children[1], sc );
+    case SynTree::R_Scope_:
+        return scopeValue( sub->d_children.first(), sc );
+    case Tok_identifier:
+        return identifier( sub, sc );
+    case SynTree::R_ArrayAccess:
+        return arrayAccess( sub, sc );
+    case SynTree::R_ScopeAccess:
+        return scopeAccess( sub, sc );
+    case SynTree::R_List_:
+        return list( sub, sc );
+    case Tok_true:
+        return Value(true);
+    case Tok_false:
+        return Value(false);
+    case Tok_integer:
+        return Value( sub->d_tok.d_val.toLongLong() );
+    case SynTree::R_signed_:
+        {
+            const qint64 i = sub->d_children.last()->d_tok.d_val.toLongLong();
+            return Value( sub->d_children.size() > 1 ? -i : i );
+        }
+    }
+    return Value();
+}
+
+Value Evaluator::list(SynTree* st, ValueScope* sc)
+{
+    Value::ValueList res;
+    for( int i = 1; i < st->d_children.size() - 1; i++ )
+        res.append( expr( st->d_children[i], sc ) );
+    return Value(res);
+}
+
+Value Evaluator::scopeValue(SynTree* block, ValueScope* sc)
+{
+    ScopeRef s( new ValueScope(sc) );
+    this->block( block, s.data() );
+    s->d_outer = 0; // a scope value only holds its own variables
+    return Value(s);
+}
+
+Value Evaluator::variable(SynTree* at, const char* name, ValueScope* sc, bool report)
+{
+    // the dirs of the file being run are computed, since templates run in the dir of the invoker
+    if( name == getSymbol("target_gen_dir") )
+        return Value( genDir(d_curDir) );
+    if( name == getSymbol("target_out_dir") )
+        return Value( outDir(d_curDir) );
+    const Value* v = sc->find(name);
+    if( recording() )
+        recordVar( sc, name, v );
+    if( v )
+        return *v;
+    if( report )
+        error( at, "undefined identifier: %1", name );
+    return Value();
+}
+
+Value Evaluator::identifier(SynTree* st, ValueScope* sc)
+{
+    return variable( st, st->d_tok.d_val.constData(), sc );
+}
+
+Value Evaluator::arrayAccess(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_children.size() == 4 );
+    SynTree* id = st->d_children.first();
+    const Value l = variable( id, id->d_tok.d_val.constData(), sc );
+    const Value index = checkType( st->d_children[2], expr( st->d_children[2], sc ), Value::Int );
+    if( l.d_type != Value::List )
+    {
+        if( l.d_type != Value::None )
+            error( id, "expecting a list: %1", id->d_tok.d_val );
+        return Value();
+    }
+    if( index.d_type != Value::Int || index.d_int < 0 || index.d_int >= l.d_list.size() )
+    {
+        error( id, "index out of range: %1", index.toString() );
+        return Value();
+    }
+    return l.d_list[index.d_int];
+}
+
+Value Evaluator::scopeAccess(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_children.size() == 3 );
+    SynTree* id = st->d_children.first();
+    SynTree* member = st->d_children.last();
+    const Value s = variable( id, id->d_tok.d_val.constData(), sc );
+    if( s.d_type != Value::Scope )
+    {
+        if( s.d_type != Value::None )
+            error( id, "expecting a scope: %1", id->d_tok.d_val );
+        return Value();
+    }
+    const Value* v = s.d_scope->find( member->d_tok.d_val.constData(), false );
+    if( v == 0 )
+    {
+        error( member, "undefined member: %1", member->d_tok.d_val );
+        return Value();
+    }
+    return *v;
+}
+
+static inline bool isIdentChar( char c, bool first )
+{
+    return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '_' || ( !first && c >= '0' && c <= '9' );
+}
+
+static inline int hexDigit( char c )
+{
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    if( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    if( c >= 'A' && c <= 'F' )
+        return c - 'A' + 10;
+    return -1;
+}
+
+Value Evaluator::string(SynTree* st, ValueScope* sc)
+{
+    const QByteArray& raw = st->d_tok.d_val;
+    const int len = raw.size() - 1; // the quotes are included
+    if( raw.indexOf('\\') == -1 && raw.indexOf('$') == -1 )
+        return Value( raw.mid( 1, len - 1 ) );
+
+    QByteArray res;
+    res.reserve(len);
+    int i = 1;
+    while( i < len )
+    {
+        const char c = raw[i];
+        if( c == '\\' && i + 1 < len && ( raw[i+1] == '\\' || raw[i+1] == '$' || raw[i+1] == '"' ) )
+        {
+            res += raw[i+1];
+            i += 2;
+        }else if( c == '$' && i + 1 < len && raw[i+1] == '{' )
+        {
+            const int end = raw.indexOf( '}', i + 2 );
+            if( end == -1 || end >= len )
+            {
+                error( st, "'${' without terminating '}'" );
+                return Value(res);
+            }
+            // ${name}, ${name.member} or ${name[index]}
+            const QByteArray inner = raw.mid( i + 2, end - i - 2 ).trimmed();
+            QByteArray name = inner, member, index;
+            const int dot = inner.indexOf('.');
+            const int br = inner.indexOf('[');
+            if( dot != -1 )
+            {
+                name = inner.left(dot).trimmed();
+                member = inner.mid(dot+1).trimmed();
+            }else if( br != -1 && inner.endsWith(']') )
+            {
+                name = inner.left(br).trimmed();
+                index = inner.mid( br + 1, inner.size() - br - 2 ).trimmed();
+            }
+            res += interpolate( name, member, index, st, sc ).toString();
+            i = end + 1;
+        }else if( c == '$' && i + 4 < len && raw[i+1] == '0' && raw[i+2] == 'x' &&
+                  hexDigit(raw[i+3]) >= 0 && hexDigit(raw[i+4]) >= 0 )
+        {
+            res += char( hexDigit(raw[i+3]) * 16 + hexDigit(raw[i+4]) );
+            i += 5;
+        }else if( c == '$' && i + 1 < len && isIdentChar( raw[i+1], true ) )
+        {
+            int j = i + 1;
+            while( j < len && isIdentChar( raw[j], false ) )
+                j++;
+            res += interpolate( raw.mid( i + 1, j - i - 1 ), QByteArray(), QByteArray(), st, sc ).toString();
+            i = j;
+        }else
+        {
+            res += c;
+            i++;
+        }
+    }
+    return Value(res);
+}
+
+Value Evaluator::interpolate(const QByteArray& name, const QByteArray& member, const QByteArray& index,
+                             SynTree* st, ValueScope* sc)
+{
+    const Value v = variable( st, Lexer::getSymbol(name).constData(), sc );
+    if( !member.isEmpty() )
+    {
+        if( v.d_type != Value::Scope )
+        {
+            error( st, "expecting a scope: %1", name );
+            return Value();
+        }
+        const Value* m = v.d_scope->find( Lexer::getSymbol(member).constData(), false );
+        if( m == 0 )
+        {
+            error( st, "undefined member: %1", member );
+            return Value();
+        }
+        return *m;
+    }
+    if( !index.isEmpty() )
+    {
+        bool ok;
+        qint64 i = index.toLongLong(&ok);
+        if( !ok )
+            i = variable( st, Lexer::getSymbol(index).constData(), sc ).d_int;
+        if( v.d_type != Value::List || i < 0 || i >= v.d_list.size() )
+        {
+            error( st, "invalid list access: %1", name );
+            return Value();
+        }
+        return v.d_list[i];
+    }
+    return v;
+}
+
+Value Evaluator::checkType(SynTree* st, const Value& v, int type)
+{
+    if( v.d_type != type && v.d_type != Value::None ) // None was already reported
+        error( st, "expecting a %1 instead of a %2", Value::typeName(type), Value::typeName(v.d_type) );
+    return v;
+}
+
+void Evaluator::error(SynTree* st, const char* fmt, const QByteArray& a1, const QByteArray& a2)
+{
+    d_errCount++;
+    d_errs->error( Errors::Semantics, st, Errors::Msg( fmt, a1, a2 ) );
+}
+
+Value::ValueList Evaluator::args(SynTree* st, ValueScope* sc)
+{
+    Value::ValueList res;
+    if( st->d_children.size() > 2 && st->d_children[2]->d_tok.d_type == SynTree::R_ExprList )
+    {
+        foreach( SynTree* e, st->d_children[2]->d_children )
+            res.append( expr( e, sc ) );
+    }
+    return res;
+}
+
+static inline SynTree* blockOf( SynTree* call )
+{
+    SynTree* last = call->d_children.last();
+    return last->d_tok.d_type == SynTree::R_Block ? last : 0;
+}
+
+Value Evaluator::call(SynTree* st, ValueScope* sc)
+{
+    Q_ASSERT( st->d_children.size() >= 3 && st->d_children[0]->d_tok.d_type == Tok_identifier );
+    SynTree* id = st->d_children.first();
+    const char* fn = id->d_tok.d_val.constData();
+    const int f = d_functions.value(fn);
+
+    // these don't evaluate their arguments
+    switch( f )
+    {
+    case F_defined:
+        return defined( st, sc );
+    case F_foreach:
+        foreach_( st, sc );
+        return Value();
+    case F_declare_args:
+        if( blockOf(st) )
+            declareArgs( blockOf(st), sc );
+        return Value();
+    }
+
+    const Value::ValueList a = args( st, sc );
+    switch( f )
+    {
+    case 0:
+        break;
+    case F_assert:
+        if( a.isEmpty() || a.first().d_type != Value::Bool )
+            error( st, "assert expects a boolean" );
+        else if( !a.first().d_int )
+            error( st, "assertion failed: %1", a.size() > 1 ? a[1].toString() : QByteArray() );
+        return Value();
+    case F_config:
+        item( st, fn, a, sc );
+        return Value();
+    case F_exec_script:
+        d_errs->warning( Errors::Semantics, st, Errors::Msg("exec_script is not run") );
+        return Value();
+    case F_filter_exclude:
+    case F_filter_include:
+        return filterList( st, a, f == F_filter_include );
+    case F_forward_variables_from:
+        forwardVariablesFrom( st, a, sc );
+        return Value();
+    case F_get_label_info:
+        return getLabelInfo( st, a );
+    case F_get_path_info:
+        if( a.size() != 2 )
+            break;
+        return getPathInfo( st, a[0], a[1].d_str );
+    case F_get_target_outputs:
+        if( a.size() == 1 )
+        {
+            const Target* t = findTarget( resolveLabel( a.first().d_str, d_curDir ) );
+            Value res = Value( Value::ValueList() );
+            if( t )
+            {
+                foreach( const QByteArray& o, t->getList(getSymbol("outputs")) )
+                    res.d_list.append( Value(o) );
+            }
+            return res;
+        }
+        break;
+    case F_getenv:
+        if( a.size() == 1 )
+            return Value( qgetenv( a.first().d_str.constData() ) );
+        break;
+    case F_import:
+        import_( st, a, sc );
+        return Value();
+    case F_not_needed:
+    case F_print:
+    case F_write_file:
+        return Value();
+    case F_pool:
+        if( blockOf(st) )
+        {
+            ScopeRef s( new ValueScope(sc) );
+            block( blockOf(st), s.data() );
+        }
+        return Value();
+    case F_process_file_template:
+        return processFileTemplate( st, a );
+    case F_read_file:
+        return readFile( st, a );
+    case F_rebase_path:
+        return rebasePath( st, a );
+    case F_set_default_toolchain:
+        if( a.size() == 1 && a.first().d_type == Value::String )
+        {
+            if( d_toolchain.isEmpty() ) // ignored in the passes of the other toolchains, like in gn
+                d_defaultToolchain = resolveLabel( a.first().d_str, d_curDir );
+            return Value();
+        }
+        break;
+    case F_set_defaults:
+        setDefaults( st, a, sc );
+        return Value();
+    case F_set_sources_assignment_filter:
+        d_sourcesFilter = a.isEmpty() ? QByteArrayList() : a.first().toStringList();
+        return Value();
+    case F_split_list:
+        if( a.size() == 2 && a[0].d_type == Value::List && a[1].d_type == Value::Int && a[1].d_int > 0 )
+        {
+            // the first lists get one element more if the elements can't be distributed evenly
+            const int n = a[1].d_int;
+            const int size = a[0].d_list.size();
+            Value::ValueList res;
+            int pos = 0;
+            for( int i = 0; i < n; i++ )
+            {
+                const int count = size / n + ( i < size % n ? 1 : 0 );
+                res.append( Value( a[0].d_list.mid( pos, count ) ) );
+                pos += count;
+            }
+            return Value(res);
+        }
+        break;
+    case F_string_join:
+        if( a.size() == 2 && a[0].d_type == Value::String && a[1].d_type == Value::List )
+            return Value( a[1].toStringList().join( a[0].d_str ) );
+        break;
+    case F_string_replace:
+        if( a.size() >= 3 && !a[1].d_str.isEmpty() )
+        {
+            QByteArray str = a[0].d_str;
+            const qint64 max = a.size() > 3 ? a[3].d_int : -1;
+            int pos = 0;
+            for( qint64 n = 0; max < 0 || n < max; n++ )
+            {
+                pos = str.indexOf( a[1].d_str, pos );
+                if( pos == -1 )
+                    break;
+                str.replace( pos, a[1].d_str.size(), a[2].d_str );
+                pos += a[2].d_str.size();
+            }
+            return Value(str);
+        }
+        break;
+    case F_string_split:
+        if( !a.isEmpty() && a[0].d_type == Value::String )
+        {
+            Value::ValueList res;
+            if( a.size() > 1 )
+            {
+                foreach( const QByteArray& s, a[0].d_str.split( a[1].d_str.isEmpty() ? ' ' : a[1].d_str[0] ) )
+                    res.append( Value(s) );
+            }else
+            {
+                foreach( const QByteArray& s, a[0].d_str.simplified().split(' ') )
+                {
+                    if( !s.isEmpty() )
+                        res.append( Value(s) );
+                }
+            }
+            return Value(res);
+        }
+        break;
+    case F_target:
+        if( a.size() == 2 && a[0].d_type == Value::String )
+        {
+            const char* type = Lexer::getSymbol( a[0].d_str ).constData();
+            if( !d_targetTypes.contains(type) )
+            {
+                error( st, "unknown target type: %1", a[0].d_str );
+                return Value();
+            }
+            item( st, type, a.mid(1), sc );
+            return Value();
+        }
+        break;
+    case F_template:
+        template_( st, a, sc );
+        return Value();
+    case F_tool:
+        if( d_curTools == 0 )
+        {
+            error( st, "tool() is only allowed in a toolchain" );
+            return Value();
+        }
+        if( a.size() == 1 && a.first().d_type == Value::String )
+        {
+            ScopeRef s( new ValueScope(sc) );
+            if( blockOf(st) )
+                block( blockOf(st), s.data() );
+            s->d_outer = 0;
+            d_curTools->insert( a.first().d_str, s );
+            return Value();
+        }
+        break;
+    case F_toolchain:
+        item( st, fn, a, sc );
+        return Value();
+    default:
+        break;
+    }
+    if( f != 0 )
+    {
+        error( st, "invalid arguments for %1", fn );
+        return Value();
+    }
+
+    if( d_targetTypes.contains(fn) )
+    {
+        item( st, fn, a, sc );
+        return Value();
+    }
+    const ValueScope::Template* t = sc->findTemplate(fn);
+    if( recording() )
+        recordTemplate( sc, fn, t );
+    if( t )
+    {
+        invoke( st, t, a, sc );
+        return Value();
+    }
+    error( id, "unknown function: %1", fn );
+    return Value();
+}
+
+Value Evaluator::defined(SynTree* st, ValueScope* sc)
+{
+    if( st->d_children.size() < 3 || st->d_children[2]->d_tok.d_type != SynTree::R_ExprList ||
+            st->d_children[2]->d_children.size() != 1 )
+    {
+        error( st, "defined expects one identifier" );
+        return Value(false);
+    }
+    SynTree* e = CodeModel::flatten( st->d_children[2]->d_children.first() );
+    if( e->d_tok.d_type == Tok_identifier )
+    {
+        const char* name = e->d_tok.d_val.constData();
+        const Value* v = sc->find(name);
+        if( recording() )
+            recordVar( sc, name, v );
+        return Value( v != 0 || name == getSymbol("target_gen_dir") || name == getSymbol("target_out_dir") );
+    }
+    if( e->d_tok.d_type == SynTree::R_ScopeAccess )
+    {
+        const char* name = e->d_children.first()->d_tok.d_val.constData();
+        const Value* s = sc->find( name );
+        if( recording() )
+            recordVar( sc, name, s );
+        if( s == 0 || s->d_type != Value::Scope )
+            return Value(false);
+        return Value( s->d_scope->find( e->d_children.last()->d_tok.d_val.constData(), false ) != 0 );
+    }
+    error( st, "defined expects one identifier" );
+    return Value(false);
+}
+
+void Evaluator::foreach_(SynTree* st, ValueScope* sc)
+{
+    SynTree* body = blockOf(st);
+    if( body == 0 || st->d_children[2]->d_tok.d_type != SynTree::R_ExprList ||
+            st->d_children[2]->d_children.size() != 2 )
+    {
+        error( st, "invalid foreach statement" );
+        return;
+    }
+    SynTree* var = CodeModel::flatten( st->d_children[2]->d_children.first() );
+    if( var->d_tok.d_type != Tok_identifier )
+    {
+        error( st, "invalid loop variable in foreach statement" );
+        return;
+    }
+    const Value l = checkType( st, expr( st->d_children[2]->d_children.last(), sc ), Value::List );
+    if( l.d_type != Value::List )
+        return;
+    // the loop variable is set in the current scope and restored afterwards
+    const char* name = var->d_tok.d_val.constData();
+    ValueScope::Vars::const_iterator i = sc->d_vars.constFind(name);
+    const bool existed = i != sc->d_vars.constEnd();
+    const Value old = existed ? i.value() : Value();
+    foreach( const Value& v, l.d_list )
+    {
+        sc->set( name, v );
+        block( body, sc );
+    }
+    if( existed )
+        sc->set( name, old );
+    else
+        sc->d_vars.remove(name);
+}
+
+void Evaluator::declareArgs(SynTree* body, ValueScope* sc)
+{
+    ScopeRef s( new ValueScope(sc) );
+    block( body, s.data() );
+    ValueScope::Vars::const_iterator i;
+    for( i = s->d_vars.begin(); i != s->d_vars.end(); ++i )
+    {
+        ValueScope::Vars::const_iterator o = d_overrides.constFind( i.key() );
+        if( recording() )
+            recordOverride( i.key(), o != d_overrides.constEnd() ? &o.value() : 0 );
+        sc->set( i.key(), o != d_overrides.constEnd() ? o.value() : i.value() );
+    }
+}
+
+void Evaluator::import_(SynTree* st, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() != 1 || a.first().d_type != Value::String )
+    {
+        error( st, "import expects a file name" );
+        return;
+    }
+    const QByteArray path = resolvePath( a.first().d_str, d_curDir );
+    const char* sym = Lexer::getSymbol(path).constData();
+    // the names merged into a template body are no longer looked up in the origin scopes
+    foreach( InstanceFrame* f, d_instRecording )
+        f->d_inst.d_cacheable = false;
+    ScopeRef s = d_imports.value(sym);
+    if( s )
+    {
+        if( !d_recording.isEmpty() )
+        {
+            QHash<const char*,ImportCache::Entry>::const_iterator i = d_importReads.constFind(sym);
+            if( i != d_importReads.constEnd() )
+                recordImport( i.value() );
+            else
+                foreach( ImportCache::Entry* e, d_recording )
+                    e->d_cacheable = false; // the import is still running, i.e. a cycle
+        }
+        sc->merge( *s );
+        return;
+    }
+    const bool cached = d_cache != 0 && d_base; // not for the imports of the dotfile
+    if( cached )
+    {
+        foreach( const ImportCache::Entry& e, d_cache->find(sym) )
+        {
+            if( matches(e) )
+            {
+                // another Evaluator ran the file in the same conditions; its result only needs own outers
+                s = rebind( e.d_result.data() );
+                d_imports.insert( sym, s );
+                addOrigin( sym, s );
+                foreach( const ImportCache::Closure& c, e.d_closures )
+                    addOrigin( c.first, rebind( c.second.data() ) );
+                d_importReads.insert( sym, e );
+                recordImport( e );
+                d_cache->hit();
+                sc->merge( *s );
+                return;
+            }
+        }
+        d_cache->miss();
+    }
+    // each file is run once in its own scope; the result is merged into each importing scope
+    s = new ValueScope( d_base.data() );
+    d_imports.insert( sym, s );
+    addOrigin( sym, s );
+    ImportCache::Entry e;
+    const int items = d_targets.size() + d_configs.size() + d_toolchains.size();
+    if( cached )
+    {
+        e.d_outRoot = d_outRoot;
+        e.d_sourcesFilter = d_sourcesFilter;
+        e.d_cacheable = d_curTools == 0;
+        d_recording.append( &e );
+    }
+    if( d_depth++ > MaxDepth )
+        error( st, "imports nested too deeply: %1", path );
+    else
+        runFile( path, s.data() );
+    d_depth--;
+    if( cached )
+    {
+        d_recording.removeLast();
+        // side effects on the Evaluator would be lost when the result is used elsewhere
+        if( items != d_targets.size() + d_configs.size() + d_toolchains.size() ||
+                d_sourcesFilter != e.d_sourcesFilter )
+            e.d_cacheable = false;
+        if( !e.d_cacheable )
+            foreach( ImportCache::Entry* outer, d_recording )
+                outer->d_cacheable = false;
+        e.d_result = s;
+        if( e.d_cacheable && collectClosures( s.data(), e.d_closures ) )
+            d_cache->insert( sym, e );
+        d_importReads.insert( sym, e );
+    }
+    sc->merge( *s );
+}
+
+enum FreeKind { FreeVar, FreeTemplate, FreeDefaults };
+
+static inline bool declares( const ValueScope* s, const char* name, int kind )
+{
+    switch( kind )
+    {
+    case FreeTemplate:
+        return s->d_templates.contains(name);
+    case FreeDefaults:
+        return s->d_defaults.contains(name);
+    default:
+        return s->d_vars.contains(name);
+    }
+}
+
+template<class T>
+static void addOverride( T& e, const char* name, const Value* found )
+{
+    if( e.d_overrides.contains(name) || e.d_noOverrides.contains(name) )
+        return;
+    if( found )
+        e.d_overrides.insert( name, *found );
+    else
+        e.d_noOverrides.insert( name );
+}
+
+template<class T>
+static bool sameOverrides( const T& e, const ValueScope::Vars& overrides )
+{
+    ValueScope::Vars::const_iterator i;
+    for( i = e.d_overrides.begin(); i != e.d_overrides.end(); ++i )
+    {
+        ValueScope::Vars::const_iterator o = overrides.constFind(i.key());
+        if( o == overrides.constEnd() || o.value() != i.value() )
+            return false;
+    }
+    foreach( const char* name, e.d_noOverrides )
+    {
+        if( overrides.contains(name) )
+            return false;
+    }
+    return true;
+}
+
+void Evaluator::recordVar(const ValueScope* sc, const char* name, const Value* found)
+{
+    if( !d_instRecording.isEmpty() )
+        recordFree( sc, name, FreeVar );
+    // only what comes from the base scope or is missing there is relevant for other Evaluators
+    if( found != 0 && found != d_base->find( name, false ) )
+        return;
+    foreach( ImportCache::Entry* e, d_recording )
+    {
+        if( e->d_vars.contains(name) || e->d_absent.contains(name) )
+            continue;
+        if( found )
+            e->d_vars.insert( name, *found );
+        else
+            e->d_absent.insert( name );
+    }
+}
+
+void Evaluator::recordTemplate(const ValueScope* sc, const char* name, const ValueScope::Template* found)
+{
+    if( !d_instRecording.isEmpty() )
+        recordFree( sc, name, FreeTemplate );
+    if( found != 0 )
+    {
+        ValueScope::Templates::const_iterator i = d_base->d_templates.constFind(name);
+        if( i == d_base->d_templates.constEnd() || &i.value() != found )
+            return;
+    }
+    foreach( ImportCache::Entry* e, d_recording )
+    {
+        if( !e->d_templates.contains(name) )
+            e->d_templates.insert( name, found ? found->d_def : 0 );
+    }
+}
+
+void Evaluator::recordDefaults(const ValueScope* sc, const char* type)
+{
+    // an import which defines items is not cached anyway
+    if( !d_instRecording.isEmpty() )
+        recordFree( sc, type, FreeDefaults );
+}
+
+void Evaluator::recordOverride(const char* name, const Value* found)
+{
+    foreach( ImportCache::Entry* e, d_recording )
+        addOverride( *e, name, found );
+    foreach( InstanceFrame* f, d_instRecording )
+        addOverride( f->d_inst, name, found );
+}
+
+void Evaluator::recordFree(const ValueScope* sc, const char* name, int kind)
+{
+    // A lookup from a template body either ends in a scope created while the instantiation runs, which
+    // only depends on its inputs, or it continues in an origin scope, which another Evaluator finds by
+    // the file; a scope in between, e.g. of the template body where the template was defined, can't be
+    // compared with the one of another Evaluator
+    QList<const ValueScope*> chain;
+    int found = -1, origin = -1;
+    for( const ValueScope* s = sc; s != 0; s = s->d_outer )
+    {
+        if( found < 0 && declares( s, name, kind ) )
+            found = chain.size();
+        if( origin < 0 && d_origins.contains(s) )
+            origin = chain.size();
+        chain.append(s);
+    }
+    int local = -1; // the scopes up to here were created while the frame runs
+    for( int k = d_instRecording.size() - 1; k >= 0; k-- )
+    {
+        ImportCache::Instance& inst = d_instRecording[k]->d_inst;
+        local = qMax( local, chain.indexOf( d_instRecording[k]->d_body ) );
+        if( found >= 0 && found <= local )
+            continue; // and so for the enclosing frames
+        if( origin != local + 1 )
+        {
+            inst.d_cacheable = false;
+            continue;
+        }
+        if( !inst.d_cacheable )
+            continue;
+        const ValueScope* o = chain[origin];
+        const ImportCache::Instance::Key key( d_origins.value(o), name );
+        switch( kind )
+        {
+        case FreeTemplate:
+            if( !inst.d_templates.contains(key) )
+            {
+                const ValueScope::Template* t = o->findTemplate(name);
+                inst.d_templates.insert( key, t ? t->d_def : 0 );
+            }
+            break;
+        case FreeDefaults:
+            if( !inst.d_defaults.contains(key) )
+            {
+                const ScopeRef d = o->findDefaults(name);
+                inst.d_defaults.insert( key, d ? Value(d) : Value() );
+            }
+            break;
+        default:
+            if( !inst.d_vars.contains(key) && !inst.d_absent.contains(key) )
+            {
+                const Value* v = o->find(name);
+                if( v )
+                    inst.d_vars.insert( key, *v );
+                else
+                    inst.d_absent.insert( key );
+            }
+            break;
+        }
+    }
+}
+
+void Evaluator::recordImport(const ImportCache::Entry& imp)
+{
+    foreach( ImportCache::Entry* e, d_recording )
+    {
+        ValueScope::Vars::const_iterator i;
+        for( i = imp.d_vars.begin(); i != imp.d_vars.end(); ++i )
+        {
+            if( !e->d_vars.contains(i.key()) && !e->d_absent.contains(i.key()) )
+                e->d_vars.insert( i.key(), i.value() );
+        }
+        foreach( const char* name, imp.d_absent )
+        {
+            if( !e->d_vars.contains(name) )
+                e->d_absent.insert( name );
+        }
+        QHash<const char*,const SynTree*>::const_iterator j;
+        for( j = imp.d_templates.begin(); j != imp.d_templates.end(); ++j )
+        {
+            if( !e->d_templates.contains(j.key()) )
+                e->d_templates.insert( j.key(), j.value() );
+        }
+        for( i = imp.d_overrides.begin(); i != imp.d_overrides.end(); ++i )
+            addOverride( *e, i.key(), &i.value() );
+        foreach( const char* name, imp.d_noOverrides )
+            addOverride( *e, name, 0 );
+        if( !imp.d_cacheable )
+            e->d_cacheable = false;
+    }
+}
+
+void Evaluator::recordInstance(const ImportCache::Instance& inst)
+{
+    // the reads of a nested instantiation are keyed by origin, so they hold for the enclosing ones too
+    typedef ImportCache::Instance::Key Key;
+    foreach( InstanceFrame* f, d_instRecording )
+    {
+        ImportCache::Instance& e = f->d_inst;
+        QHash<Key,Value>::const_iterator i;
+        for( i = inst.d_vars.begin(); i != inst.d_vars.end(); ++i )
+        {
+            if( !e.d_vars.contains(i.key()) && !e.d_absent.contains(i.key()) )
+                e.d_vars.insert( i.key(), i.value() );
+        }
+        foreach( const Key& k, inst.d_absent )
+        {
+            if( !e.d_vars.contains(k) )
+                e.d_absent.insert( k );
+        }
+        QHash<Key,const SynTree*>::const_iterator j;
+        for( j = inst.d_templates.begin(); j != inst.d_templates.end(); ++j )
+        {
+            if( !e.d_templates.contains(j.key()) )
+                e.d_templates.insert( j.key(), j.value() );
+        }
+        for( i = inst.d_defaults.begin(); i != inst.d_defaults.end(); ++i )
+        {
+            if( !e.d_defaults.contains(i.key()) )
+                e.d_defaults.insert( i.key(), i.value() );
+        }
+        ValueScope::Vars::const_iterator o;
+        for( o = inst.d_overrides.begin(); o != inst.d_overrides.end(); ++o )
+            addOverride( e, o.key(), &o.value() );
+        foreach( const char* name, inst.d_noOverrides )
+            addOverride( e, name, 0 );
+        e.d_outcomes += inst.d_outcomes;
+    }
+}
+
+bool Evaluator::matches(const ImportCache::Entry& e) const
+{
+    if( e.d_outRoot != d_outRoot || e.d_sourcesFilter != d_sourcesFilter || d_curTools != 0 )
+        return false;
+    ValueScope::Vars::const_iterator i;
+    for( i = e.d_vars.begin(); i != e.d_vars.end(); ++i )
+    {
+        const Value* v = d_base->find( i.key(), false );
+        if( v == 0 || *v != i.value() )
+            return false;
+    }
+    foreach( const char* name, e.d_absent )
+    {
+        if( d_base->find( name, false ) != 0 )
+            return false;
+    }
+    QHash<const char*,const SynTree*>::const_iterator j;
+    for( j = e.d_templates.begin(); j != e.d_templates.end(); ++j )
+    {
+        ValueScope::Templates::const_iterator t = d_base->d_templates.constFind(j.key());
+        if( ( t == d_base->d_templates.constEnd() ? 0 : t.value().d_def ) != j.value() )
+            return false;
+    }
+    return sameOverrides( e, d_overrides );
+}
+
+bool Evaluator::matches(const ImportCache::Instance& e, const ValueScope& invoker) const
+{
+    if( e.d_outRoot != d_outRoot || e.d_sourcesFilter != d_sourcesFilter || e.d_invoker != invoker.d_vars )
+        return false;
+    typedef ImportCache::Instance::Key Key;
+    QHash<Key,Value>::const_iterator i;
+    for( i = e.d_vars.begin(); i != e.d_vars.end(); ++i )
+    {
+        const ValueScope* o = originScope( i.key().first );
+        const Value* v = o ? o->find( i.key().second ) : 0;
+        if( v == 0 || *v != i.value() )
+            return false;
+    }
+    foreach( const Key& k, e.d_absent )
+    {
+        const ValueScope* o = originScope( k.first );
+        if( o == 0 || o->find( k.second ) != 0 )
+            return false;
+    }
+    QHash<Key,const SynTree*>::const_iterator j;
+    for( j = e.d_templates.begin(); j != e.d_templates.end(); ++j )
+    {
+        const ValueScope* o = originScope( j.key().first );
+        if( o == 0 )
+            return false;
+        const ValueScope::Template* t = o->findTemplate( j.key().second );
+        if( ( t ? t->d_def : 0 ) != j.value() )
+            return false;
+    }
+    for( i = e.d_defaults.begin(); i != e.d_defaults.end(); ++i )
+    {
+        const ValueScope* o = originScope( i.key().first );
+        if( o == 0 )
+            return false;
+        const ScopeRef d = o->findDefaults( i.key().second );
+        if( ( d ? Value(d) : Value() ) != i.value() )
+            return false;
+    }
+    return sameOverrides( e, d_overrides );
+}
+
+void Evaluator::replay(const ImportCache::Instance& inst)
+{
+    recordInstance( inst );
+    for( int k = 0; k < inst.d_items.size(); k++ )
+        add( new Item( inst.d_items[k] ), inst.d_nested[k] );
+    for( int k = 0; k < inst.d_outcomes.size(); k++ )
+    {
+        const SynTree* c = inst.d_outcomes[k].first;
+        d_outcomes[c->d_tok.d_sourcePath.constData()][c] |= inst.d_outcomes[k].second;
+    }
+}
+
+bool Evaluator::collectClosures(const ValueScope* s, QList<ImportCache::Closure>& res) const
+{
+    // the templates of an import refer to the scope of the file which defined them; these have to be
+    // import scopes as well, so another Evaluator can replace them by own copies
+    QList<const ValueScope*> todo;
+    QSet<const ValueScope*> done;
+    todo << s;
+    done << s;
+    while( !todo.isEmpty() )
+    {
+        const ValueScope* cur = todo.takeLast();
+        ValueScope::Templates::const_iterator i;
+        for( i = cur->d_templates.begin(); i != cur->d_templates.end(); ++i )
+        {
+            const ValueScope* c = i.value().d_closure;
+            if( done.contains(c) )
+                continue;
+            done << c;
+            const char* file = d_origins.value(c);
+            if( file == 0 || file == s_baseOrigin )
+                return false;
+            res << ImportCache::Closure( file, ScopeRef( const_cast<ValueScope*>(c) ) );
+            todo << c;
+        }
+    }
+    return true;
+}
+
+ScopeRef Evaluator::rebind(const ValueScope* s)
+{
+    ScopeRef r = d_rebound.value(s);
+    if( r )
+        return r;
+    // the variables stay shared until they are modified; only the outers are own
+    r = new ValueScope( *s );
+    r->d_outer = d_base.data();
+    d_rebound.insert( s, r );
+    ValueScope::Templates::iterator i;
+    for( i = r->d_templates.begin(); i != r->d_templates.end(); ++i )
+        i.value().d_closure = rebind( i.value().d_closure ).data();
+    return r;
+}
+
+void Evaluator::addOrigin(const char* file, const ScopeRef& s)
+{
+    d_origins.insert( s.data(), file );
+    // a file with two scopes, e.g. a rebound closure and a later import of the file, is ambiguous
+    QHash<const char*,ScopeRef>::iterator i = d_originScopes.find(file);
+    if( i == d_originScopes.end() )
+        d_originScopes.insert( file, s );
+    else if( i.value() != s )
+        i.value().reset();
+}
+
+const char* Evaluator::originOf(const ValueScope* s) const
+{
+    return d_origins.value(s);
+}
+
+const ValueScope* Evaluator::originScope(const char* file) const
+{
+    return d_originScopes.value(file).data();
+}
+
+ImportCache::Entries ImportCache::find(const char* file) const
+{
+    QMutexLocker lock(&d_lock);
+    return d_entries.value(file);
+}
+
+void ImportCache::insert(const char* file, const ImportCache::Entry& e)
+{
+    QMutexLocker lock(&d_lock);
+    Entries& l = d_entries[file];
+    if( l.size() >= MaxPerFile )
+        return;
+    l.append( e );
+    d_count++;
+}
+
+ImportCache::Instances ImportCache::findInstances(const SynTree* def, const QByteArray& label) const
+{
+    QMutexLocker lock(&d_lock);
+    return d_instances.value( InstanceKey( def, label ) );
+}
+
+void ImportCache::insertInstance(const ImportCache::Instance& i)
+{
+    QMutexLocker lock(&d_lock);
+    Instances& l = d_instances[ InstanceKey( i.d_def, i.d_label ) ];
+    if( l.size() >= MaxPerFile )
+        return;
+    l.append( i );
+    d_instCount++;
+}
+
+ImportCache::Stats ImportCache::getStats() const
+{
+    Stats s;
+    QMutexLocker lock(&d_lock);
+    s.d_entries = d_count;
+    s.d_hits = d_hits.load();
+    s.d_misses = d_misses.load();
+    s.d_instances = d_instCount;
+    s.d_instanceHits = d_instHits.load();
+    s.d_instanceMisses = d_instMisses.load();
+    return s;
+}
+
+void ImportCache::clear()
+{
+    QMutexLocker lock(&d_lock);
+    d_entries.clear();
+    d_instances.clear();
+    d_count = 0;
+    d_instCount = 0;
+    d_hits.store(0);
+    d_misses.store(0);
+    d_instHits.store(0);
+    d_instMisses.store(0);
+}
+
+void Evaluator::forwardVariablesFrom(SynTree* st, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() < 2 || a[0].d_type != Value::Scope )
+    {
+        if( a.isEmpty() || a[0].d_type != Value::None )
+            error( st, "forward_variables_from expects a scope and a list" );
+        return;
+    }
+    const ValueScope* from = a[0].d_scope.data();
+    QSet<const char*> exclude;
+    if( a.size() > 2 )
+    {
+        foreach( const QByteArray& n, a[2].toStringList() )
+            exclude.insert( Lexer::getSymbol(n).constData() );
+    }
+    if( a[1].d_type == Value::String && a[1].d_str == "*" )
+    {
+        ValueScope::Vars::const_iterator i;
+        for( i = from->d_vars.begin(); i != from->d_vars.end(); ++i )
+        {
+            if( !exclude.contains(i.key()) )
+                sc->set( i.key(), i.value() );
+        }
+    }else
+    {
+        foreach( const QByteArray& n, a[1].toStringList() )
+        {
+            const char* name = Lexer::getSymbol(n).constData();
+            const Value* v = from->find( name, false );
+            if( v && !exclude.contains(name) )
+                sc->set( name, *v );
+        }
+    }
+}
+
+void Evaluator::template_(SynTree* st, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() != 1 || a.first().d_type != Value::String || blockOf(st) == 0 )
+    {
+        error( st, "template expects a name and a block" );
+        return;
+    }
+    ValueScope::Template t;
+    t.d_def = st;
+    t.d_closure = sc;
+    sc->d_templates.insert( Lexer::getSymbol(a.first().d_str).constData(), t );
+}
+
+void Evaluator::invoke(SynTree* st, const ValueScope::Template* t, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() != 1 || a.first().d_type != Value::String )
+    {
+        error( st, "template invocation expects a target name" );
+        return;
+    }
+    if( d_depth > MaxDepth )
+    {
+        error( st, "templates nested too deeply: %1", st->d_children.first()->d_tok.d_val );
+        return;
+    }
+    // the block of the invocation becomes 'invoker' of the template body; the body runs in the scope
+    // where the template was defined, but with the dir of the invoking file
+    ScopeRef invoker( new ValueScope(sc) );
+    if( blockOf(st) )
+        block( blockOf(st), invoker.data() );
+    d_invocations.append( st );
+
+    // an instantiation which another Evaluator ran with the same inputs generated the same items, which
+    // are copied; the enclosing instantiations are recorded meanwhile, so they can be cached in turn
+    const bool recorded = d_cache != 0 && d_base;
+    const bool cacheable = recorded && d_recording.isEmpty() && d_curTools == 0 &&
+            originOf( t->d_closure ) != 0;
+    const QByteArray label = d_curDir + ":" + a.first().d_str;
+    if( cacheable )
+    {
+        foreach( const ImportCache::Instance& i, d_cache->findInstances( t->d_def, label ) )
+        {
+            if( matches( i, *invoker ) )
+            {
+                d_cache->instanceHit();
+                replay( i );
+                d_invocations.removeLast();
+                return;
+            }
+        }
+        d_cache->instanceMiss();
+    }
+
+    ScopeRef body( new ValueScope(t->d_closure) );
+    body->set( getSymbol("target_name"), a.first() );
+    body->set( getSymbol("invoker"), Value(invoker) );
+    InstanceFrame f;
+    if( recorded )
+    {
+        f.d_body = body.data();
+        f.d_inst.d_def = t->d_def;
+        f.d_inst.d_label = label;
+        f.d_inst.d_outRoot = d_outRoot;
+        f.d_inst.d_sourcesFilter = d_sourcesFilter;
+        f.d_inst.d_invoker = invoker->d_vars;
+        f.d_inst.d_cacheable = cacheable;
+        d_instRecording.append( &f );
+    }
+    const quint32 errCount = d_errCount;
+    const QByteArray defaultToolchain = d_defaultToolchain;
+    d_depth++;
+    block( blockOf(t->d_def), body.data() );
+    d_depth--;
+    d_invocations.removeLast();
+    if( recorded )
+    {
+        d_instRecording.removeLast();
+        // side effects on the Evaluator other than the items would be lost when the result is copied
+        if( errCount != d_errCount || defaultToolchain != d_defaultToolchain ||
+                d_sourcesFilter != f.d_inst.d_sourcesFilter )
+            f.d_inst.d_cacheable = false;
+        if( f.d_inst.d_cacheable )
+        {
+            foreach( const Item* i, f.d_items )
+                f.d_inst.d_items.append( *i );
+            d_cache->insertInstance( f.d_inst );
+        }
+    }
+}
+
+void Evaluator::setDefaults(SynTree* st, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() != 1 || a.first().d_type != Value::String || blockOf(st) == 0 )
+    {
+        error( st, "set_defaults expects a target type and a block" );
+        return;
+    }
+    ScopeRef s( new ValueScope(sc) );
+    block( blockOf(st), s.data() );
+    s->d_outer = 0;
+    sc->d_defaults.insert( Lexer::getSymbol(a.first().d_str).constData(), s );
+}
+
+void Evaluator::item(SynTree* st, const char* type, const Value::ValueList& a, ValueScope* sc)
+{
+    if( a.size() != 1 || a.first().d_type != Value::String )
+    {
+        error( st, "%1 expects a name", type );
+        return;
+    }
+    const QByteArray& name = a.first().d_str;
+    ScopeRef s( new ValueScope(sc) );
+    ScopeRef defs = sc->findDefaults(type);
+    if( recording() )
+        recordDefaults( sc, type );
+    if( defs )
+        s->d_vars = defs->d_vars;
+    const char* targetName = getSymbol("target_name");
+    s->set( targetName, a.first() );
+    Item::Tools tools;
+    Item::Tools* outerTools = d_curTools;
+    if( type == getSymbol("toolchain") )
+        d_curTools = &tools;
+    if( blockOf(st) )
+        block( blockOf(st), s.data() );
+    d_curTools = outerTools;
+    s->d_vars.remove(targetName);
+    Item* i = record( st, type, name, *s );
+    if( i )
+        i->d_tools = tools;
+}
+
+Evaluator::Item* Evaluator::record(SynTree* st, const char* type, const QByteArray& name, const ValueScope& sc)
+{
+    Item* i = new Item();
+    i->d_dir = d_curDir;
+    i->d_name = name;
+    i->d_label = d_curDir + ":" + name;
+    i->d_type = type;
+    i->d_st = st;
+    i->d_values = new ValueScope();
+    i->d_values->d_vars = sc.d_vars;
+    collectToolchainRefs( *i->d_values ); // before normalize drops the toolchains of the labels
+    normalize( *i->d_values, d_curDir );
+    return add( i ) ? i : 0;
+}
+
+bool Evaluator::add(Item* i, const SynTreeList& nested)
+{
+    const char* type = i->d_type;
+    Items* list = &d_targets;
+    QHash<QByteArray,Item*>* byLabel = &d_targetsByLabel;
+    if( type == getSymbol("config") )
+    {
+        list = &d_configs;
+        byLabel = &d_configsByLabel;
+    }else if( type == getSymbol("toolchain") )
+    {
+        list = &d_toolchains;
+        byLabel = &d_toolchainsByLabel;
+    }
+    if( byLabel->contains(i->d_label) )
+    {
+        error( i->d_st, "duplicate definition: %1", i->d_label );
+        delete i;
+        return false;
+    }
+    list->append(i);
+    byLabel->insert(i->d_label,i);
+    d_inherited.clear(); // a label might resolve now
+    queueLabels(i);
+    // an item also belongs to the invocations the current one is nested in
+    foreach( SynTree* c, d_invocations )
+        d_instances[c].append(i);
+    foreach( SynTree* c, nested )
+        d_instances[c].append(i);
+    for( int f = 0; f < d_instRecording.size(); f++ )
+    {
+        d_instRecording[f]->d_items.append(i);
+        d_instRecording[f]->d_inst.d_nested.append( d_invocations.mid( f + 1 ) + nested );
+    }
+    return true;
+}
+
+static inline bool isPattern( const QByteArray& path )
+{
+    // like "{{source_gen_dir}}/{{source_name_part}}.h" in the outputs of action_foreach and copy;
+    // the substitution names a dir in the build dir, so it is resolved after expansion, like gn does
+    return path.startsWith("{{");
+}
+
+void Evaluator::normalize(ValueScope& sc, const QByteArray& dir) const
+{
+    for( int k = 0; s_pathVars[k]; k++ )
+    {
+        ValueScope::Vars::iterator i = sc.d_vars.find( getSymbol(s_pathVars[k]) );
+        if( i == sc.d_vars.end() )
+            continue;
+        Value& v = i.value();
+        if( v.d_type == Value::String && !isPattern(v.d_str) )
+            v.d_str = resolvePath( v.d_str, dir );
+        else if( v.d_type == Value::List )
+        {
+            for( int j = 0; j < v.d_list.size(); j++ )
+            {
+                if( v.d_list[j].d_type == Value::String && !isPattern(v.d_list[j].d_str) )
+                    v.d_list[j].d_str = resolvePath( v.d_list[j].d_str, dir );
+            }
+        }
+    }
+    for( int k = 0; s_labelVars[k]; k++ )
+    {
+        ValueScope::Vars::iterator i = sc.d_vars.find( getSymbol(s_labelVars[k]) );
+        if( i == sc.d_vars.end() || i.value().d_type != Value::List )
+            continue;
+        Value& v = i.value();
+        for( int j = 0; j < v.d_list.size(); j++ )
+        {
+            if( v.d_list[j].d_type == Value::String )
+                v.d_list[j].d_str = resolveLabel( v.d_list[j].d_str, dir );
+        }
+    }
+    // libs are either names or paths
+    ValueScope::Vars::iterator i = sc.d_vars.find( getSymbol("libs") );
+    if( i != sc.d_vars.end() && i.value().d_type == Value::List )
+    {
+        Value& v = i.value();
+        for( int j = 0; j < v.d_list.size(); j++ )
+        {
+            if( v.d_list[j].d_str.contains('/') )
+                v.d_list[j].d_str = resolvePath( v.d_list[j].d_str, dir );
+        }
+    }
+}
+
+void Evaluator::queueLabels(const Item* i)
+{
+    for( int k = 0; s_labelVars[k]; k++ )
+    {
+        foreach( const QByteArray& l, i->getList( getSymbol(s_labelVars[k]) ) )
+            queueDir( l.left( l.indexOf(':') ) );
+    }
+}
+
+Value Evaluator::getPathInfo(SynTree* st, const Value& in, const QByteArray& what)
+{
+    if( in.d_type == Value::List )
+    {
+        Value::ValueList res;
+        foreach( const Value& v, in.d_list )
+            res.append( getPathInfo( st, v, what ) );
+        return Value(res);
+    }
+    if( in.d_type != Value::String )
+    {
+        error( st, "get_path_info expects a string or a list" );
+        return Value();
+    }
+    const QByteArray& path = in.d_str;
+    const int slash = path.lastIndexOf('/');
+    const QByteArray file = path.mid( slash + 1 );
+    if( what == "file" )
+        return Value(file);
+    if( what == "name" || what == "extension" )
+    {
+        const int dot = file.lastIndexOf('.');
+        if( what == "name" )
+            return Value( dot == -1 ? file : file.left(dot) );
+        return Value( dot == -1 ? QByteArray() : file.mid(dot+1) );
+    }
+    if( what == "dir" )
+    {
+        if( slash == -1 )
+            return Value( QByteArray(".") );
+        if( slash == 1 && path.startsWith("//") )
+            return Value( QByteArray("//") );
+        if( slash == 0 )
+            return Value( QByteArray("/") );
+        return Value( path.left(slash) );
+    }
+    const QByteArray abs = resolvePath( path, d_curDir );
+    if( what == "abspath" )
+        return Value(abs);
+    const QByteArray dir = path.endsWith('/') ? abs.left( abs.size() - 1 ) : dirOf(abs);
+    if( what == "gen_dir" )
+        return Value( genDir(dir) );
+    if( what == "out_dir" )
+        return Value( outDir(dir) );
+    error( st, "invalid argument for get_path_info: %1", what );
+    return Value();
+}
+
+Value Evaluator::getLabelInfo(SynTree* st, const Value::ValueList& a)
+{
+    if( a.size() != 2 || a[0].d_type != Value::String || a[1].d_type != Value::String )
+    {
+        error( st, "get_label_info expects a label and a string" );
+        return Value();
+    }
+    QByteArray tc;
+    const QByteArray label = resolveLabel( a[0].d_str, d_curDir, &tc );
+    if( tc.isEmpty() )
+    {
+        const Value* cur = d_base->find( getSymbol("current_toolchain") );
+        if( recording() )
+            recordVar( d_base.data(), getSymbol("current_toolchain"), cur );
+        tc = cur->d_str;
+    }
+    const int colon = label.indexOf(':');
+    const QByteArray dir = label.left(colon);
+    const QByteArray& what = a[1].d_str;
+    if( what == "name" )
+        return Value( label.mid(colon+1) );
+    if( what == "dir" )
+        return Value( dir );
+    if( what == "label_no_toolchain" )
+        return Value( label );
+    if( what == "label_with_toolchain" )
+        return Value( label + "(" + tc + ")" );
+    if( what == "toolchain" )
+        return Value( tc );
+    if( what == "target_gen_dir" )
+        return Value( genDir(dir) );
+    if( what == "target_out_dir" )
+        return Value( outDir(dir) );
+    if( what == "root_gen_dir" )
+        return Value( d_outRoot + "/gen" );
+    if( what == "root_out_dir" )
+        return Value( d_outRoot );
+    error( st, "invalid argument for get_label_info: %1", what );
+    return Value();
+}
+
+Value Evaluator::rebasePath(SynTree* st, const Value::ValueList& a)
+{
+    if( a.isEmpty() || a.size() > 3 )
+    {
+        error( st, "rebase_path expects one to three arguments" );
+        return Value();
+    }
+    if( a[0].d_type == Value::List )
+    {
+        Value::ValueList res;
+        foreach( const Value& v, a[0].d_list )
+        {
+            Value::ValueList sub = a;
+            sub[0] = v;
+            res.append( rebasePath( st, sub ) );
+        }
+        return Value(res);
+    }
+    if( a[0].d_type != Value::String )
+    {
+        error( st, "rebase_path expects a string or a list" );
+        return Value();
+    }
+    const QByteArray newBase = a.size() > 1 ? a[1].d_str : QByteArray();
+    const QByteArray curBase = a.size() > 2 && a[2].d_str != "." ? resolvePath( a[2].d_str, d_curDir ) : d_curDir;
+    const QByteArray abs = resolvePath( a[0].d_str, curBase );
+    const bool trailingSlash = a[0].d_str.endsWith('/');
+    if( newBase.isEmpty() )
+        return Value( toFilePath(abs).toUtf8() ); // system absolute
+    const QByteArray base = resolvePath( newBase, d_curDir );
+    QByteArray res = QDir( toFilePath(base) ).relativeFilePath( toFilePath(abs) ).toUtf8();
+    if( res.isEmpty() )
+        res = ".";
+    if( trailingSlash && !res.endsWith('/') )
+        res += '/';
+    return Value(res);
+}
+
+Value Evaluator::processFileTemplate(SynTree* st, const Value::ValueList& a)
+{
+    if( a.size() != 2 )
+    {
+        error( st, "process_file_template expects a list of sources and a template" );
+        return Value();
+    }
+    const QByteArrayList templates = a[1].toStringList();
+    Value::ValueList res;
+    foreach( const QByteArray& src, a[0].toStringList() )
+    {
+        const QByteArray abs = resolvePath( src, d_curDir );
+        const QByteArray dir = dirOf(abs);
+        const QByteArray file = abs.mid( abs.lastIndexOf('/') + 1 );
+        const int dot = file.lastIndexOf('.');
+        foreach( QByteArray t, templates )
+        {
+            t.replace( "{{source}}", abs );
+            t.replace( "{{source_file_part}}", file );
+            t.replace( "{{source_name_part}}", dot == -1 ? file : file.left(dot) );
+            t.replace( "{{source_extension}}", dot == -1 ? QByteArray() : file.mid(dot+1) );
+            t.replace( "{{source_dir}}", dir );
+            t.replace( "{{source_root_relative_dir}}", dir.mid(2) );
+            t.replace( "{{source_gen_dir}}", genDir(dir) );
+            t.replace( "{{source_out_dir}}", outDir(dir) );
+            res.append( Value(t) );
+        }
+    }
+    return Value(res);
+}
+
+Value Evaluator::readFile(SynTree* st, const Value::ValueList& a)
+{
+    if( a.size() != 2 || a[0].d_type != Value::String || a[1].d_type != Value::String )
+    {
+        error( st, "read_file expects a file name and an input conversion" );
+        return Value();
+    }
+    bool ok;
+    QByteArray content = d_mdl->getFileCache()->readFile( toFilePath( resolvePath( a[0].d_str, d_curDir ) ), &ok );
+    if( !ok )
+    {
+        error( st, "cannot read file: %1", a[0].d_str );
+        return Value();
+    }
+    QByteArray conv = a[1].d_str;
+    const bool trim = conv.startsWith("trim ");
+    if( trim )
+    {
+        conv = conv.mid(5);
+        content = content.trimmed();
+    }
+    if( conv == "string" )
+        return Value(content);
+    if( conv == "list lines" )
+    {
+        Value::ValueList res;
+        foreach( const QByteArray& l, content.split('\n') )
+            res.append( Value( trim ? l.trimmed() : l ) );
+        if( !res.isEmpty() && res.last().d_str.isEmpty() )
+            res.removeLast();
+        return Value(res);
+    }
+    d_errs->warning( Errors::Semantics, st, Errors::Msg("input conversion not supported: %1", conv) );
+    return Value();
+}
+
+Value Evaluator::filterList(SynTree* st, const Value::ValueList& a, bool include)
+{
+    if( a.size() != 2 || a[0].d_type != Value::List )
+    {
+        error( st, "filter expects a list and a list of patterns" );
+        return Value();
+    }
+    const QByteArrayList patterns = a[1].toStringList();
+    Value::ValueList res;
+    foreach( const Value& v, a[0].d_list )
+    {
+        bool match = false;
+        foreach( const QByteArray& p, patterns )
+        {
+            if( matchPattern( p, v.d_str ) )
+            {
+                match = true;
+                break;
+            }
+        }
+        if( match == include )
+            res.append(v);
+    }
+    return Value(res);
+}
+
+QList<Evaluator::Target*> Evaluator::getDeps(const Target* t, bool includeData) const
+{
+    QList<Target*> res;
+    QByteArrayList labels = t->getList(getSymbol("deps")) + t->getList(getSymbol("public_deps"));
+    if( includeData )
+        labels += t->getList(getSymbol("data_deps"));
+    foreach( const QByteArray& l, labels )
+    {
+        Target* d = findTarget(l);
+        if( d && !res.contains(d) )
+            res.append(d);
+    }
+    return res;
+}
+
+void Evaluator::collectConfigs(const QByteArrayList& labels, QList<const Config*>& res,
+                               QSet<const Config*>& seen) const
+{
+    foreach( const QByteArray& l, labels )
+    {
+        const Config* c = findConfig(l);
+        if( c == 0 || seen.contains(c) )
+            continue;
+        seen.insert(c);
+        res.append(c);
+        collectConfigs( c->getList(getSymbol("configs")), res, seen );
+    }
+}
+
+static void appendNew( QList<const Evaluator::Config*>& to, QSet<const Evaluator::Config*>& seen,
+                       const QList<const Evaluator::Config*>& what )
+{
+    foreach( const Evaluator::Config* c, what )
+    {
+        if( !seen.contains(c) )
+        {
+            seen.insert(c);
+            to.append(c);
+        }
+    }
+}
+
+Evaluator::InheritedConfigs Evaluator::inheritedConfigs(const Target* t) const
+{
+    // computed once per target from those of its deps; a dependency cycle is cut
+    QHash<const Target*,InheritedConfigs>::const_iterator i = d_inherited.constFind(t);
+    if( i != d_inherited.constEnd() )
+        return i.value();
+    d_inherited.insert( t, InheritedConfigs() );
+    InheritedConfigs res;
+    QSet<const Config*> seen;
+    collectConfigs( t->getList(getSymbol("public_configs")), res.d_public, seen );
+    // public configs are forwarded along public_deps; all deps of a group count as public
+    QByteArrayList labels = t->getList(getSymbol("public_deps"));
+    if( t->d_type == getSymbol("group") )
+        labels += t->getList(getSymbol("deps"));
+    foreach( const QByteArray& l, labels )
+    {
+        const Target* d = findTarget(l);
+        if( d )
+            appendNew( res.d_public, seen, inheritedConfigs(d).d_public );
+    }
+    // all_dependent_configs come from all transitive deps
+    seen.clear();
+    collectConfigs( t->getList(getSymbol("all_dependent_configs")), res.d_allDependent, seen );
+    foreach( const Target* d, getDeps(t) )
+        appendNew( res.d_allDependent, seen, inheritedConfigs(d).d_allDependent );
+    d_inherited.insert( t, res );
+    return res;
+}
+
+QList<const Evaluator::Config*> Evaluator::getAllConfigs(const Target* t) const
+{
+    QList<const Config*> res;
+    QSet<const Config*> seen;
+    collectConfigs( t->getList(getSymbol("configs")), res, seen );
+    collectConfigs( t->getList(getSymbol("public_configs")), res, seen );
+    collectConfigs( t->getList(getSymbol("all_dependent_configs")), res, seen );
+
+    QMutexLocker lock(&d_configLock);
+    const QList<Target*> deps = getDeps(t);
+    foreach( const Target* d, deps )
+        appendNew( res, seen, inheritedConfigs(d).d_public );
+    foreach( const Target* d, deps )
+        appendNew( res, seen, inheritedConfigs(d).d_allDependent );
+    return res;
+}
+
+struct FlagSets
+{
+    QSet<QByteArray> d_defines, d_includeDirs, d_libs, d_libDirs;
+};
+
+static inline void appendUnique( QByteArrayList& to, QSet<QByteArray>& seen, const QByteArrayList& what )
+{
+    foreach( const QByteArray& s, what )
+    {
+        if( !seen.contains(s) )
+        {
+            seen.insert(s);
+            to.append(s);
+        }
+    }
+}
+
+static void addFlags( Evaluator::Flags& f, FlagSets& seen, const Evaluator::Item* i, const Evaluator* e )
+{
+    appendUnique( f.d_defines, seen.d_defines, i->getList(e->getSymbol("defines")) );
+    appendUnique( f.d_includeDirs, seen.d_includeDirs, i->getList(e->getSymbol("include_dirs")) );
+    f.d_cflags += i->getList(e->getSymbol("cflags"));
+    f.d_cflagsC += i->getList(e->getSymbol("cflags_c"));
+    f.d_cflagsCC += i->getList(e->getSymbol("cflags_cc"));
+    f.d_asmflags += i->getList(e->getSymbol("asmflags"));
+    f.d_ldflags += i->getList(e->getSymbol("ldflags"));
+    appendUnique( f.d_libs, seen.d_libs, i->getList(e->getSymbol("libs")) );
+    appendUnique( f.d_libDirs, seen.d_libDirs, i->getList(e->getSymbol("lib_dirs")) );
+}
+
+Evaluator::Flags Evaluator::getFlags(const Target* t) const
+{
+    // the values of the target come first, then those of the configs in the order they apply
+    Flags f;
+    FlagSets seen;
+    addFlags( f, seen, t, this );
+    foreach( const Config* c, getAllConfigs(t) )
+        addFlags( f, seen, c, this );
+    return f;
+}
+
+QByteArrayList Evaluator::getSources(const Target* t) const
+{
+    return t->getList(getSymbol("sources"));
+}
+
+bool Evaluator::isBinary(const Target* t) const
+{
+    return d_binaryTypes.contains(t->d_type);
+}
+
+const char*Evaluator::getSymbol(const char* name) const
+{
+    const char* res = d_syms.value(name);
+    if( res == 0 )
+        res = Lexer::getSymbol(name).constData();
+    return res;
+}
+
+QString Evaluator::toFilePath(const QByteArray& sourceAbsolute) const
+{
+    if( sourceAbsolute.startsWith("//") )
+    {
+        QString res = d_mdl->getSourceRoot().absoluteFilePath( QString::fromUtf8( sourceAbsolute.mid(2) ) );
+        if( sourceAbsolute.endsWith('/') && !res.endsWith('/') )
+            res += '/';
+        return res;
+    }
+    return QString::fromUtf8(sourceAbsolute);
+}
+
+QByteArray Evaluator::genDir(const QByteArray& dir) const
+{
+    return dir == "//" ? d_outRoot + "/gen" : d_outRoot + "/gen/" + dir.mid(2);
+}
+
+QByteArray Evaluator::outDir(const QByteArray& dir) const
+{
+    return dir == "//" ? d_outRoot + "/obj" : d_outRoot + "/obj/" + dir.mid(2);
+}
+
+static QByteArray cleanPath( const QByteArray& prefix, const QByteArray& path, bool trailingSlash )
+{
+    QByteArrayList parts;
+    foreach( const QByteArray& p, path.split('/') )
+    {
+        if( p.isEmpty() || p == "." )
+            continue;
+        if( p == ".." )
+        {
+            if( !parts.isEmpty() && parts.last() != ".." )
+                parts.removeLast();
+            else if( prefix.isEmpty() )
+                parts.append(p); // relative paths keep leading ..
+        }else
+            parts.append(p);
+    }
+    QByteArray res = prefix + parts.join('/');
+    if( trailingSlash && !parts.isEmpty() )
+        res += '/';
+    return res;
+}
+
+QByteArray Evaluator::resolvePath(const QByteArray& path, const QByteArray& dir)
+{
+    if( path.isEmpty() )
+        return path;
+    const bool trailingSlash = path.endsWith('/');
+    if( path.startsWith("//") )
+        return cleanPath( "//", path.mid(2), trailingSlash );
+    if( path.startsWith('/') )
+        return cleanPath( "/", path.mid(1), trailingSlash );
+    if( dir.startsWith("//") )
+        return cleanPath( "//", dir.mid(2) + "/" + path, trailingSlash );
+    return cleanPath( dir.startsWith('/') ? "/" : "", dir + "/" + path, trailingSlash );
+}
+
+QByteArray Evaluator::resolveLabel(const QByteArray& label, const QByteArray& dir, QByteArray* toolchain)
+{
+    QByteArray l = label;
+    const int lpar = l.indexOf('(');
+    if( lpar != -1 && l.endsWith(')') )
+    {
+        if( toolchain )
+            *toolchain = resolveLabel( l.mid( lpar + 1, l.size() - lpar - 2 ), dir );
+        l = l.left(lpar);
+    }
+    QByteArray path, name;
+    const int colon = l.indexOf(':');
+    if( colon == -1 )
+    {
+        path = l;
+        QByteArray p = l;
+        while( p.endsWith('/') )
+            p.chop(1);
+        name = p.mid( p.lastIndexOf('/') + 1 );
+    }else
+    {
+        path = l.left(colon);
+        name = l.mid(colon+1);
+    }
+    QByteArray d = path.isEmpty() ? dir : resolvePath( path, dir );
+    if( d.endsWith('/') && d != "//" )
+        d.chop(1);
+    return d + ":" + name;
+}
+
+QByteArray Evaluator::dirOf(const QByteArray& sourceAbsolute)
+{
+    const int slash = sourceAbsolute.lastIndexOf('/');
+    if( slash <= 1 && sourceAbsolute.startsWith("//") )
+        return "//";
+    if( slash == 0 )
+        return "/";
+    return sourceAbsolute.left(slash);
+}
+
+static bool match( const char* p, const char* pe, const char* s, const char* sb, const char* se )
+{
+    while( p < pe )
+    {
+        if( *p == '*' )
+        {
+            p++;
+            if( p == pe )
+                return true;
+            for( const char* t = s; t <= se; t++ )
+            {
+                if( match( p, pe, t, sb, se ) )
+                    return true;
+            }
+            return false;
+        }
+        if( *p == '\\' && p + 1 < pe && p[1] == 'b' )
+        {
+            // path boundary: begin or end of the string or a slash
+            p += 2;
+            if( s < se && *s == '/' && match( p, pe, s + 1, sb, se ) )
+                return true;
+            if( s == sb || s == se || s[-1] == '/' )
+                continue;
+            return false;
+        }
+        if( s == se || *s != *p )
+            return false;
+        p++;
+        s++;
+    }
+    return s == se;
+}
+
+bool Evaluator::matchPattern(const QByteArray& pattern, const QByteArray& str)
+{
+    const char* s = str.constData();
+    return match( pattern.constData(), pattern.constData() + pattern.size(), s, s, s + str.size() );
+}
@@ -0,0 +1,417 @@
+#ifndef GNEVALUATOR_H
+#define GNEVALUATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QByteArrayList>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QSet>
+#include <QSharedData>
+
+/*
+ *  Runs the statements of a parsed GN project for a given set of args (like 'gn gen' does, but
+ *  without writing anything)
+ *  - Uses the SynTrees of the CodeModel, so the model has to be parsed first; an Evaluator is bound
+ *    to one parse of the model since variable names are Lexer symbols
+ *  - Runs .gn, then the build config file, then the BUILD.gn of the root dir and of each dir referenced
+ *    by a label in deps, public_deps, data_deps or configs of a target, until no new labels show up
+ *  - Paths are kept source absolute ("//dir/file"); labels are normalized to "//dir:name"
+ *  - exec_script is not run (it returns none), write_file writes nothing
+ *  - Errors are reported as Semantics errors; the evaluation continues with the next statement
+ *  - evaluate() is the pass of the default toolchain; evaluateToolchains() then runs a pass for each other
+ *    toolchain referenced by a label, each in its own Evaluator on a worker thread, with the
+ *    toolchain_args as overrides and root_out_dir in a subdir of the build dir, like gn does
+ *  - getInstances() lists the items generated by each template invocation; with an ImportCache shared by
+ *    Evaluators, an instantiation with the same invoker and the same values read outside of it is not
+ *    run again, its items are copied
+*/
+
+namespace Gn
+{
+    class CodeModel;
+    class SynTree;
+    class Errors;
+    class ValueScope;
+
+    typedef QExplicitlySharedDataPointer<ValueScope> ScopeRef;
+
+    class Value
+    {
+    public:
+        enum Type { None, Bool, Int, String, List, Scope };
+        typedef QList<Value> ValueList;
+
+        Value():d_type(None),d_int(0){}
+        explicit Value( bool b ):d_type(Bool),d_int(b){}
+        explicit Value( qint64 i ):d_type(Int),d_int(i){}
+        explicit Value( const QByteArray& s ):d_type(String),d_int(0),d_str(s){}
+        explicit Value( const ValueList& l ):d_type(List),d_int(0),d_list(l){}
+        explicit Value( const ScopeRef& s ):d_type(Scope),d_int(0),d_scope(s){}
+
+        bool isNone() const { return d_type == None; }
+        bool isList() const { return d_type == List; }
+        bool isString() const { return d_type == String; }
+        bool operator==( const Value& ) const;
+        bool operator!=( const Value& rhs ) const { return !( *this == rhs ); }
+        QByteArray toString( bool quoted = false ) const; // as in string interpolation or print
+        QByteArrayList toStringList() const; // the string elements of a list, or the string itself
+        static const char* typeName( int );
+
+        quint8 d_type;
+        qint64 d_int; // also bool
+        QByteArray d_str;
+        ValueList d_list;
+        ScopeRef d_scope;
+    };
+
+    class ValueScope : public QSharedData
+    {
+    public:
+        typedef QHash<const char*,Value> Vars; // key is a Lexer symbol
+        struct Template
+        {
+            SynTree* d_def; // the template call
+            const ValueScope* d_closure;
+        };
+        typedef QHash<const char*,Template> Templates;
+        typedef QHash<const char*,ScopeRef> Defaults; // target type -> set_defaults
+
+        explicit ValueScope( const ValueScope* outer = 0 ):d_outer(outer){}
+
+        const Value* find( const char* name, bool recursive = true ) const;
+        const Template* findTemplate( const char* name ) const;
+        ScopeRef findDefaults( const char* type ) const;
+        void set( const char* name, const Value& v ) { d_vars[name] = v; }
+        void merge( const ValueScope& ); // as done by import; names starting with '_' are private
+
+        Vars d_vars;
+        Templates d_templates;
+        Defaults d_defaults;
+        const ValueScope* d_outer; // not owned; scope values have no outer
+    };
+
+    struct EvalItem // a target, config or toolchain; see Evaluator::Item
+    {
+        QByteArray d_label; // "//dir:name"
+        QByteArray d_dir;   // "//dir" or "//"
+        QByteArray d_name;
+        const char* d_type; // symbol, e.g. "static_library" or "config"
+        ScopeRef d_values;  // own variables; paths source absolute, labels normalized
+        SynTree* d_st;      // the call which defined the item
+        typedef QMap<QByteArray,ScopeRef> Tools;
+        Tools d_tools;      // only toolchains; tool name -> variables
+        EvalItem():d_type(0),d_st(0){}
+
+        QByteArrayList getList( const char* name ) const;
+        QByteArray getString( const char* name ) const;
+        bool getBool( const char* name, bool defaultValue = false ) const;
+    };
+
+    class ImportCache
+    {
+    public:
+        // The result of an import can be used by another Evaluator if the values read from the base scope
+        // (args, build config, builtins) and from the overrides of declare_args are the same there
+        typedef QPair<const char*,ScopeRef> Closure; // file symbol and import scope
+        struct Entry
+        {
+            ValueScope::Vars d_vars; // of the base scope read by the import
+            QSet<const char*> d_absent; // looked up but neither found in the import nor the base scope
+            QHash<const char*,const SynTree*> d_templates; // of the base scope invoked; 0 if not found
+            ValueScope::Vars d_overrides; // used by declare_args
+            QSet<const char*> d_noOverrides;
+            QByteArray d_outRoot;
+            QByteArrayList d_sourcesFilter;
+            ScopeRef d_result;
+            QList<Closure> d_closures; // other import scopes the templates of d_result refer to
+            bool d_cacheable;
+            Entry():d_cacheable(true){}
+        };
+        typedef QList<Entry> Entries;
+
+        // The same goes for a template instantiation with the same target name, dir and invoker; the names
+        // it looks up outside of its own scopes are recorded with the file of the scope where the lookup
+        // left them (an import, a BUILD.gn or the build config), since these scopes are own to each Evaluator
+        struct Instance
+        {
+            typedef QPair<const char*,const char*> Key; // origin file symbol and name
+            const SynTree* d_def; // of the template
+            QByteArray d_label; // target_name in the dir of the invocation
+            QByteArray d_outRoot;
+            QByteArrayList d_sourcesFilter;
+            ValueScope::Vars d_invoker;
+            QHash<Key,Value> d_vars;
+            QSet<Key> d_absent;
+            QHash<Key,const SynTree*> d_templates; // 0 if not found
+            QHash<Key,Value> d_defaults; // by target type; a scope or none
+            ValueScope::Vars d_overrides;
+            QSet<const char*> d_noOverrides;
+            QList<EvalItem> d_items; // generated, also by nested invocations
+            QList<QList<SynTree*> > d_nested; // of each item, the nested invocations which generated it
+            QList<QPair<const SynTree*,quint8> > d_outcomes; // of the conditions run; see Evaluator
+            bool d_cacheable;
+            Instance():d_def(0),d_cacheable(true){}
+        };
+        typedef QList<Instance> Instances;
+
+        struct Stats
+        {
+            int d_entries, d_hits, d_misses;
+            int d_instances, d_instanceHits, d_instanceMisses;
+            Stats():d_entries(0),d_hits(0),d_misses(0),d_instances(0),d_instanceHits(0),d_instanceMisses(0){}
+        };
+
+        ImportCache():d_count(0),d_instCount(0),d_hits(0),d_misses(0),d_instHits(0),d_instMisses(0){}
+
+        Entries find( const char* file ) const; // key is a Lexer symbol
+        void insert( const char* file, const Entry& );
+        void hit() { d_hits.ref(); }
+        void miss() { d_misses.ref(); }
+        Instances findInstances( const SynTree* def, const QByteArray& label ) const;
+        void insertInstance( const Instance& );
+        void instanceHit() { d_instHits.ref(); }
+        void instanceMiss() { d_instMisses.ref(); }
+        Stats getStats() const;
+        void clear();
+    private:
+        enum { MaxPerFile = 8 };
+        typedef QPair<const SynTree*,QByteArray> InstanceKey;
+        mutable QMutex d_lock;
+        QHash<const char*,Entries> d_entries;
+        QHash<InstanceKey,Instances> d_instances;
+        int d_count, d_instCount;
+        QAtomicInt d_hits, d_misses, d_instHits, d_instMisses;
+    };
+
+    class Evaluator
+    {
+    public:
+        typedef EvalItem Item;
+        typedef Item Target;
+        typedef Item Config;
+        typedef Item Toolchain;
+        typedef QList<Item*> Items;
+        typedef QHash<const SynTree*,Items> ItemsByCall; // template invocation -> items generated; not owned
+
+        enum ConditionOutcome { ThenTaken = 1, ElseTaken = 2 };
+        typedef QHash<const SynTree*,quint8> Outcomes; // R_Condition -> ConditionOutcome flags
+        typedef QHash<const char*,Outcomes> OutcomesByFile; // key is the Token::d_sourcePath symbol
+
+        struct Memory // estimate of what the results of a pass hold; data shared by passes counts in each
+        {
+            quint64 d_bytes;
+            quint32 d_scopes, d_values, d_items;
+            Memory():d_bytes(0),d_scopes(0),d_values(0),d_items(0){}
+        };
+
+        struct Flags // as seen by the compiler of a target, configs included
+        {
+            QByteArrayList d_defines, d_includeDirs, d_cflags, d_cflagsC, d_cflagsCC,
+                d_asmflags, d_ldflags, d_libs, d_libDirs;
+        };
+
+        explicit Evaluator( CodeModel*, Errors* = 0 );
+        ~Evaluator();
+
+        void setArgs( const QByteArray& args ); // same syntax as args.gn, e.g. "is_debug = false"
+        bool setArgsFile( const QString& path );
+        void setBuildDir( const QByteArray& dir ) { d_buildDir = d_outRoot = dir; } // default "//out/Default"
+        const QByteArray& getBuildDir() const { return d_buildDir; }
+        void setImportCache( ImportCache* c ) { d_cache = c; } // not owned; can be shared by Evaluators
+        CodeModel* getModel() const { return d_mdl; }
+        Errors* getErrs() const { return d_errs; }
+
+        bool evaluate( const QByteArrayList& roots = QByteArrayList() ); // labels or dirs; default root dir
+        bool evaluateToolchains( int threads = 0 ); // after evaluate; 0 means QThread::idealThreadCount
+        // can be called from any thread; a running evaluate or evaluateToolchains stops after the current
+        // BUILD.gn and returns false, and so do later calls
+        void cancel() { d_canceled->storeRelease(1); }
+        bool isCanceled() const { return d_canceled->loadAcquire() != 0; }
+
+        QByteArray getToolchain() const; // of this pass
+        const QList<Evaluator*>& getPasses() const { return d_passes; } // of the other toolchains
+        Evaluator* getPass( const QByteArray& toolchain ) const; // this for the default toolchain
+        Memory getMemory() const;
+        // items generated by each template invocation run by the last evaluate, nested invocations included
+        const ItemsByCall& getInstances() const { return d_instances; }
+
+        const Items& getTargets() const { return d_targets; }
+        const Items& getConfigs() const { return d_configs; }
+        const Items& getToolchains() const { return d_toolchains; }
+        const QByteArray& getDefaultToolchain() const { return d_defaultToolchain; }
+        Target* findTarget( const QByteArray& label ) const { return d_targetsByLabel.value(label); }
+        Config* findConfig( const QByteArray& label ) const { return d_configsByLabel.value(label); }
+        Toolchain* findToolchain( const QByteArray& label ) const { return d_toolchainsByLabel.value(label); }
+        QList<Target*> getDeps( const Target*, bool includeData = false ) const; // deps and public_deps
+        QList<const Config*> getAllConfigs( const Target* ) const; // in the order they apply
+        Flags getFlags( const Target* ) const;
+        QByteArrayList getSources( const Target* ) const;
+        bool isBinary( const Target* ) const; // source_set, static_library, executable etc.
+        const char* getSymbol( const char* ) const; // Lexer symbol of a known name
+        // of each condition run by the last evaluate; conditions never reached have no entry
+        const OutcomesByFile& getOutcomes() const { return d_outcomes; }
+
+        QString toFilePath( const QByteArray& sourceAbsolute ) const;
+        QByteArray genDir( const QByteArray& dir ) const; // target_gen_dir of a source dir
+        QByteArray outDir( const QByteArray& dir ) const; // target_out_dir of a source dir
+        static QByteArray resolvePath( const QByteArray& path, const QByteArray& dir );
+        static QByteArray resolveLabel( const QByteArray& label, const QByteArray& dir,
+                                        QByteArray* toolchain = 0 );
+        static QByteArray dirOf( const QByteArray& sourceAbsolute );
+        static bool matchPattern( const QByteArray& pattern, const QByteArray& str );
+    protected:
+        typedef QList<SynTree*> SynTreeList;
+        // Statements
+        void statementList( SynTree*, ValueScope* );
+        void statement( SynTree*, ValueScope* );
+        void assignment( SynTree*, ValueScope* );
+        void assign( SynTree*, ValueScope*, const char* name, int op, const Value& );
+        Value* mutableVar( ValueScope*, const char* name );
+        void condition( SynTree*, ValueScope* );
+        void block( SynTree*, ValueScope* );
+        Value call( SynTree*, ValueScope* );
+        // Expressions
+        Value expr( SynTree*, ValueScope* );
+        Value binary( const SynTreeList& operands, const QList<int>& ops, int& pos, int minPrec,
+                      ValueScope*, bool skip );
+        Value unaryExpr( SynTree*, ValueScope* );
+        Value primaryExpr( SynTree*, ValueScope* );
+        Value list( SynTree*, ValueScope* );
+        Value scopeValue( SynTree* block, ValueScope* );
+        Value string( SynTree*, ValueScope* );
+        Value identifier( SynTree*, ValueScope* );
+        Value arrayAccess( SynTree*, ValueScope* );
+        Value scopeAccess( SynTree*, ValueScope* );
+        Value binaryOp( SynTree*, int op, const Value& lhs, const Value& rhs );
+        Value variable( SynTree*, const char* name, ValueScope*, bool report = true );
+        Value interpolate( const QByteArray& name, const QByteArray& member, const QByteArray& index,
+                           SynTree*, ValueScope* );
+        // Functions
+        Value::ValueList args( SynTree* call, ValueScope* );
+        void import_( SynTree*, const Value::ValueList&, ValueScope* );
+        void declareArgs( SynTree*, ValueScope* );
+        void foreach_( SynTree*, ValueScope* );
+        void forwardVariablesFrom( SynTree*, const Value::ValueList&, ValueScope* );
+        void template_( SynTree*, const Value::ValueList&, ValueScope* );
+        void invoke( SynTree*, const ValueScope::Template*, const Value::ValueList&, ValueScope* );
+        void item( SynTree*, const char* type, const Value::ValueList&, ValueScope* );
+        void setDefaults( SynTree*, const Value::ValueList&, ValueScope* );
+        Value defined( SynTree*, ValueScope* );
+        Value getPathInfo( SynTree*, const Value& in, const QByteArray& what );
+        Value getLabelInfo( SynTree*, const Value::ValueList& );
+        Value rebasePath( SynTree*, const Value::ValueList& );
+        Value processFileTemplate( SynTree*, const Value::ValueList& );
+        Value readFile( SynTree*, const Value::ValueList& );
+        Value filterList( SynTree*, const Value::ValueList&, bool include );
+        // Files
+        bool runFile( const QByteArray& sourceAbsolute, ValueScope* );
+        SynTree* getFileTree( const QByteArray& sourceAbsolute );
+        bool prepare(); // runs the dotfile and the build config into d_base
+        void runPending();
+        void runPass();
+        void collectToolchainRefs( const ValueScope& );
+        void queueDir( const QByteArray& dir );
+        void loadDir( const QByteArray& dir );
+        void queueLabels( const Item* );
+        Item* record( SynTree*, const char* type, const QByteArray& name, const ValueScope& );
+        void normalize( ValueScope&, const QByteArray& dir ) const;
+        void collectConfigs( const QByteArrayList&, QList<const Config*>&, QSet<const Config*>& ) const;
+        struct InheritedConfigs
+        {
+            QList<const Config*> d_public; // public_configs of the target and along its public deps
+            QList<const Config*> d_allDependent; // all_dependent_configs of the target and its deps
+        };
+        InheritedConfigs inheritedConfigs( const Target* ) const; // d_configLock held
+        // Import and instantiation cache
+        bool recording() const { return !d_recording.isEmpty() || !d_instRecording.isEmpty(); }
+        void recordVar( const ValueScope*, const char* name, const Value* found );
+        void recordTemplate( const ValueScope*, const char* name, const ValueScope::Template* found );
+        void recordDefaults( const ValueScope*, const char* type );
+        void recordOverride( const char* name, const Value* found );
+        void recordFree( const ValueScope*, const char* name, int kind );
+        void recordImport( const ImportCache::Entry& );
+        void recordInstance( const ImportCache::Instance& );
+        bool matches( const ImportCache::Entry& ) const;
+        bool matches( const ImportCache::Instance&, const ValueScope& invoker ) const;
+        void replay( const ImportCache::Instance& );
+        bool collectClosures( const ValueScope*, QList<ImportCache::Closure>& ) const;
+        ScopeRef rebind( const ValueScope* );
+        void addOrigin( const char* file, const ScopeRef& );
+        const char* originOf( const ValueScope* ) const;
+        const ValueScope* originScope( const char* file ) const;
+        bool add( Item*, const SynTreeList& nested = SynTreeList() ); // false if deleted as a duplicate
+        Value checkType( SynTree*, const Value&, int type );
+        void error( SynTree*, const char* fmt, const QByteArray& a1 = QByteArray(),
+                    const QByteArray& a2 = QByteArray() );
+        void clearResults();
+    private:
+        friend class PassTask;
+        CodeModel* d_mdl;
+        Errors* d_errs;
+        QByteArray d_buildDir;
+        QByteArray d_outRoot; // root_out_dir of this pass
+        SynTree* d_argsTree; // owned
+        ScopeRef d_args; // values of setArgs
+        ValueScope::Vars d_overrides; // .gn default_args with d_args on top
+        ScopeRef d_base; // builtins and the build config; outer of each BUILD.gn scope
+        QHash<const char*,ScopeRef> d_imports; // file symbol -> result of the import
+        QList<ScopeRef> d_fileScopes; // of each BUILD.gn, kept for the templates defined there
+        QSet<QByteArray> d_loadedDirs;
+        QByteArrayList d_pendingDirs;
+        QByteArrayList d_sourcesFilter;
+        QByteArray d_curDir; // of the BUILD.gn or import being run
+        QByteArray d_defaultToolchain;
+        Items d_targets, d_configs, d_toolchains; // owned
+        QHash<QByteArray,Item*> d_targetsByLabel, d_configsByLabel, d_toolchainsByLabel;
+        Item::Tools* d_curTools; // of the toolchain being run
+        QSet<const char*> d_targetTypes, d_binaryTypes;
+        QHash<const char*,int> d_functions; // symbol -> builtin
+        QHash<QByteArray,const char*> d_syms; // name -> symbol, for names used by the generators
+        int d_depth; // of nested file runs and template invocations
+        OutcomesByFile d_outcomes;
+        ImportCache* d_cache;
+        QList<ImportCache::Entry*> d_recording; // of the imports being run
+        QHash<const char*,ImportCache::Entry> d_importReads; // file symbol -> what the import read
+        QHash<const ValueScope*,ScopeRef> d_rebound; // scope of another Evaluator -> own copy
+        QHash<const ValueScope*,const char*> d_origins; // import or BUILD.gn scope -> file symbol
+        QHash<const char*,ScopeRef> d_originScopes; // file symbol -> import or BUILD.gn scope
+        struct InstanceFrame;
+        QList<InstanceFrame*> d_instRecording; // of the template invocations being run
+        SynTreeList d_invocations; // being run
+        ItemsByCall d_instances;
+        quint32 d_errCount; // reported by this Evaluator
+        QByteArray d_toolchain; // of a pass started by evaluateToolchains, empty for the default one
+        ScopeRef d_toolchainArgs;
+        QMap<QByteArray,QSet<QByteArray> > d_toolchainRefs; // toolchain -> dirs referenced with it
+        QList<Evaluator*> d_passes; // owned
+        ImportCache* d_ownCache;
+        mutable QMutex d_configLock; // getAllConfigs can be called by several generator units at once
+        mutable QHash<const Target*,InheritedConfigs> d_inherited; // filled on demand, cleared by add()
+        bool d_prepared;
+        QAtomicInt d_cancelFlag;
+        QAtomicInt* d_canceled; // d_cancelFlag, or the one of the Evaluator which started this pass
+    };
+}
+
+#endif // GNEVALUATOR_H
@@ -21,55 +21,141 @@
 #include <QFile>
 #include <QBuffer>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <string.h>
 using namespace Gn;
 
-FileCache::FileCache(QObject *parent) : QObject(parent)
+FileCache::FileCache(QObject *parent) : QObject(parent),d_head(0),d_tail(0),d_bytes(0),
+    d_budget(DefaultBudget),d_supportSvExt(false)
 {
+    ::memset( &d_stats, 0, sizeof(Stats) );
+}
+
+FileCache::~FileCache()
+{
+    qDeleteAll(d_files);
 }
 
 #define _USE_CANONOCALS
 
-void FileCache::addFile(const QString& path, const QByteArray& content)
+static inline QString canonical( const QString& path )
 {
 #ifdef _USE_CANONOCALS
     const QString cpath = QFileInfo(path).canonicalFilePath();
-#else
-    const QString cpath = path;
+    if( !cpath.isEmpty() )
+        return cpath;
 #endif
-    d_lock.lockForWrite();
-    d_files[cpath] = content;
+    return path; // canonicalFilePath is empty for files not (yet) existing
+}
+
+static inline QByteArray hashOf( const QByteArray& content )
+{
+    return QCryptographicHash::hash( content, QCryptographicHash::Md5 );
+}
+
+void FileCache::unlink(FileCache::Entry* e) const
+{
+    if( e->d_prev )
+        e->d_prev->d_next = e->d_next;
+    else if( d_head == e )
+        d_head = e->d_next;
+    if( e->d_next )
+        e->d_next->d_prev = e->d_prev;
+    else if( d_tail == e )
+        d_tail = e->d_prev;
+    e->d_prev = e->d_next = 0;
+}
+
+void FileCache::touch(FileCache::Entry* e) const
+{
+    if( d_head == e )
+        return;
+    unlink(e);
+    e->d_next = d_head;
+    if( d_head )
+        d_head->d_prev = e;
+    d_head = e;
+    if( d_tail == 0 )
+        d_tail = e;
+}
+
+void FileCache::drop(FileCache::Entry* e)
+{
+    unlink(e);
+    d_bytes -= e->d_content.size() + e->d_lines.size() * sizeof(quint32);
+    d_files.remove(e->d_path);
+    delete e;
+}
+
+void FileCache::evict()
+{
+    Entry* e = d_tail;
+    while( e && d_bytes > d_budget )
+    {
+        Entry* prev = e->d_prev;
+        if( !e->d_pinned )
+        {
+            drop(e);
+            d_stats.d_evictions++;
+        }
+        e = prev;
+    }
+}
+
+void FileCache::store(const QString& cpath, const QByteArray& content, const QByteArray& hash,
+                      qint64 modified, bool pinned)
+{
+    Entry* e = d_files.value(cpath);
+    if( e == 0 )
+    {
+        e = new Entry();
+        e->d_path = cpath;
+        d_files.insert(cpath,e);
+    }
+    d_bytes += content.size() - e->d_content.size() - e->d_lines.size() * sizeof(quint32);
+    e->d_content = content;
+    e->d_lines.clear();
+    e->d_hash = hash;
+    e->d_modified = modified;
+    e->d_pinned = pinned;
+    touch(e);
+    evict();
+}
+
+void FileCache::addFile(const QString& path, const QByteArray& content)
+{
+    const QString cpath = canonical(path);
+    const QByteArray hash = hashOf(content);
+    d_lock.lock();
+    store( cpath, content, hash, 0, true );
     d_lock.unlock();
 }
 
 void FileCache::removeFile(const QString& path)
 {
-#ifdef _USE_CANONOCALS
-    const QString cpath = QFileInfo(path).canonicalFilePath();
-#else
-    const QString cpath = path;
-#endif
-    d_lock.lockForWrite();
-    d_files.remove(cpath);
+    const QString cpath = canonical(path);
+    d_lock.lock();
+    Entry* e = d_files.value(cpath);
+    if( e )
+        drop(e);
     d_lock.unlock();
 }
 
 QByteArray FileCache::getFile(const QString& path, bool* found) const
 {
     QByteArray res;
-#ifdef _USE_CANONOCALS
-    const QString cpath = QFileInfo(path).canonicalFilePath();
-#else
-    const QString cpath = path;
-#endif
+    const QString cpath = canonical(path);
 
-    d_lock.lockForRead();
+    d_lock.lock();
 
     if( found )
         *found = false;
-    Files::const_iterator i = d_files.find(cpath);
-    if( i != d_files.end() )
+    Entry* e = d_files.value(cpath);
+    if( e )
     {
-        res = i.value();
+        res = e->d_content;
+        touch(e);
         if( found )
             *found = true;
     }
@@ -79,16 +165,118 @@ QByteArray FileCache::getFile(const QString& path, bool* found) const
     return res;
 }
 
+QByteArray FileCache::readFile(const QString& path, bool* ok)
+{
+    const QFileInfo info(path);
+    const QString cpath = canonical(path);
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    if( ok )
+        *ok = true;
+
+    d_lock.lock();
+    Entry* e = d_files.value(cpath);
+    if( e && ( e->d_pinned || e->d_modified == modified ) )
+    {
+        const QByteArray res = e->d_content;
+        touch(e);
+        d_stats.d_hits++;
+        d_lock.unlock();
+        return res;
+    }
+    d_lock.unlock();
+
+    // the file is read and hashed without holding the lock
+    QFile f(path);
+    if( !f.open(QIODevice::ReadOnly) )
+    {
+        if( ok )
+            *ok = false;
+        return QByteArray();
+    }
+    QByteArray content = f.readAll();
+    f.close();
+    const QByteArray hash = hashOf(content);
+
+    d_lock.lock();
+    e = d_files.value(cpath);
+    if( e && e->d_pinned )
+    {
+        // addFile was called meanwhile
+        content = e->d_content;
+        touch(e);
+    }else if( e && e->d_hash == hash )
+    {
+        // touched, but unchanged; keep the shared old copy
+        content = e->d_content;
+        e->d_modified = modified;
+        touch(e);
+        d_stats.d_unchanged++;
+    }else
+    {
+        if( e )
+            d_stats.d_reloads++;
+        else
+            d_stats.d_misses++;
+        if( content.size() > d_budget )
+        {
+            if( e )
+                drop(e); // too large to be cached, but still returned
+        }else
+            store( cpath, content, hash, modified, false );
+    }
+    d_lock.unlock();
+    return content;
+}
+
+QByteArray FileCache::getHash(const QString& path) const
+{
+    const QString cpath = canonical(path);
+    d_lock.lock();
+    Entry* e = d_files.value(cpath);
+    const QByteArray res = e ? e->d_hash : QByteArray();
+    d_lock.unlock();
+    return res;
+}
+
+void FileCache::clear()
+{
+    d_lock.lock();
+    qDeleteAll(d_files);
+    d_files.clear();
+    d_head = d_tail = 0;
+    d_bytes = 0;
+    d_lock.unlock();
+}
+
+void FileCache::setBudget(qint64 bytes)
+{
+    d_lock.lock();
+    d_budget = bytes;
+    evict();
+    d_lock.unlock();
+}
+
+FileCache::Stats FileCache::getStats() const
+{
+    d_lock.lock();
+    Stats res = d_stats;
+    res.d_files = d_files.size();
+    res.d_bytes = d_bytes;
+    res.d_budget = d_budget;
+    d_lock.unlock();
+    return res;
+}
+
 void FileCache::setSupportSvExt(bool b)
 {
-    d_lock.lockForWrite();
+    d_lock.lock();
     d_supportSvExt = b;
     d_lock.unlock();
 }
 
 bool FileCache::supportSvExt() const
 {
-    d_lock.lockForRead();
+    d_lock.lock();
     const bool res = d_supportSvExt;
     d_lock.unlock();
     return res;
@@ -106,7 +294,7 @@ static inline bool endsWith( const QStringList& suff, const QString& filePath )
 
 bool FileCache::supportSvExt(const QString& path) const
 {
-    d_lock.lockForRead();
+    d_lock.lock();
     const bool flag = d_supportSvExt;
     const QStringList suff = d_svSuffix;
     d_lock.unlock();
@@ -118,39 +306,88 @@ bool FileCache::supportSvExt(const QString& path) const
 
 void FileCache::setSvSuffix(const QStringList& s)
 {
-    d_lock.lockForWrite();
+    d_lock.lock();
     d_svSuffix = s;
     d_lock.unlock();
 }
 
 QStringList FileCache::svSuffix() const
 {
-    d_lock.lockForRead();
+    d_lock.lock();
     const QStringList res = d_svSuffix;
     d_lock.unlock();
     return res;
 }
 
+QVector<quint32> FileCache::lineStarts(const QByteArray& content)
+{
+    QVector<quint32> res;
+    res.reserve( content.size() / 32 + 1 );
+    res.append(0);
+    const char* p = content.constData();
+    const int len = content.size();
+    for( int i = 0; i < len; i++ )
+    {
+        if( p[i] == '\n' && i + 1 < len )
+            res.append( i + 1 );
+    }
+    res.squeeze();
+    return res;
+}
+
+QByteArray FileCache::lineAt(const QByteArray& content, const QVector<quint32>& starts, int line,
+                             const QByteArray& def)
+{
+    if( line < 1 || line > starts.size() || content.isEmpty() )
+        return def;
+    const int from = starts[line-1];
+    int to = line < starts.size() ? starts[line] : content.size();
+    if( to > from && content[to-1] == '\n' )
+        to--;
+    if( to > from && content[to-1] == '\r' )
+        to--;
+    return content.mid( from, to - from );
+}
+
 QByteArray FileCache::fetchTextLineFromFile(const QString& path, int line, const QByteArray& defaultString)
 {
-    QIODevice* in = createFileStreamForReading( path );
-    if( in == 0 )
-        return defaultString;
-    QByteArray str;
-    for( int i = 0; i < line; i++ )
+    QList<int> lines;
+    lines << line;
+    return fetchTextLines( path, lines, defaultString ).first();
+}
+
+QByteArrayList FileCache::fetchTextLines(const QString& path, const QList<int>& lines, const QByteArray& defaultString)
+{
+    QByteArrayList res;
+    bool ok;
+    const QByteArray content = readFile( path, &ok );
+    if( !ok )
     {
-        if( in->atEnd() )
+        for( int i = 0; i < lines.size(); i++ )
+            res.append( defaultString );
+        return res;
+    }
+
+    QVector<quint32> starts;
+    const QString cpath = canonical(path);
+    d_lock.lock();
+    Entry* e = d_files.value(cpath);
+    if( e && e->d_content.constData() == content.constData() )
+    {
+        if( e->d_lines.isEmpty() )
         {
-            delete in;
-            return defaultString;
+            e->d_lines = lineStarts(content);
+            d_bytes += e->d_lines.size() * sizeof(quint32);
         }
-        str = in->readLine();
+        starts = e->d_lines;
     }
-    delete in;
-    str.chop(1);
-    if( str.endsWith('\r') )
-        str.chop(1);
-    return str;
+    d_lock.unlock();
+    if( starts.isEmpty() )
+        starts = lineStarts(content); // too large to be cached or replaced meanwhile
+
+    foreach( int line, lines )
+        res.append( lineAt( content, starts, line, defaultString ) );
+    return res;
 }
 
 QIODevice*FileCache::createFileStreamForReading(const QString& path) const
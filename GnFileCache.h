@@ -22,22 +22,53 @@
 
 #include <QHash>
 #include <QObject>
-#include <QReadWriteLock>
+#include <QMutex>
 #include <QStringList>
+#include <QVector>
+#include <QByteArrayList>
 
 class QIODevice;
 
+/*
+ *  Shared content cache of the library
+ *  - readFile() returns the cached content as long as the file on disk didn't change (modification
+ *    time), otherwise it reads the file again; an MD5 hash per entry detects touched but unchanged files
+ *  - The cached bytes are limited by a budget; the least recently used entries are dropped first
+ *  - Content set with addFile() supersedes the file on disk and is never dropped (e.g. unsaved edits)
+ *  - The line start offsets of an entry are kept with the content, so any line is found in O(1)
+*/
+
 namespace Gn
 {
     class FileCache : public QObject
     {
         // this class is thread-safe
     public:
+        struct Stats
+        {
+            quint32 d_hits;      // served from the cache
+            quint32 d_misses;    // read from disk, not cached before
+            quint32 d_reloads;   // read from disk since the file changed
+            quint32 d_unchanged; // modified on disk, but same hash
+            quint32 d_evictions;
+            quint32 d_files;
+            qint64 d_bytes;
+            qint64 d_budget;
+        };
+        enum { DefaultBudget = 256 * 1024 * 1024 };
+
         explicit FileCache(QObject *parent = 0);
+        ~FileCache();
 
         void addFile( const QString& path, const QByteArray& content );
         void removeFile( const QString& path );
-        QByteArray getFile( const QString& path, bool* found = 0) const;
+        QByteArray getFile( const QString& path, bool* found = 0) const; // only what is in the cache
+        QByteArray readFile( const QString& path, bool* ok = 0 ); // from the cache or from disk
+        QByteArray getHash( const QString& path ) const; // empty if not cached
+        void clear();
+
+        void setBudget( qint64 bytes );
+        Stats getStats() const;
 
         void setSupportSvExt( bool b );
         bool supportSvExt() const;
@@ -45,16 +76,44 @@ namespace Gn
         void setSvSuffix( const QStringList& s);
         QStringList svSuffix() const;
 
-        // utility
+        // utility; line is one based, the line terminator is not included
         QByteArray fetchTextLineFromFile( const QString& path, int line, const QByteArray& defaultString = QByteArray() );
+        QByteArrayList fetchTextLines( const QString& path, const QList<int>& lines,
+                                       const QByteArray& defaultString = QByteArray() );
         QIODevice* createFileStreamForReading(const QString& path) const; // caller has to delete afterwards
 
     private:
-        typedef QHash<QString,QByteArray> Files;
+        struct Entry
+        {
+            QString d_path;
+            QByteArray d_content;
+            QByteArray d_hash;
+            QVector<quint32> d_lines; // start offset of each line, built on first line access
+            qint64 d_modified; // msecs since epoch
+            bool d_pinned; // set by addFile
+            Entry* d_prev; // towards more recently used
+            Entry* d_next;
+            Entry():d_modified(0),d_pinned(false),d_prev(0),d_next(0){}
+        };
+        static QVector<quint32> lineStarts( const QByteArray& );
+        static QByteArray lineAt( const QByteArray&, const QVector<quint32>&, int line, const QByteArray& def );
+        void touch( Entry* ) const;
+        void unlink( Entry* ) const;
+        void drop( Entry* );
+        void evict();
+        void store( const QString& path, const QByteArray& content, const QByteArray& hash,
+                    qint64 modified, bool pinned );
+
+        typedef QHash<QString,Entry*> Files;
         Files d_files; // path->content
+        mutable Entry* d_head; // most recently used
+        mutable Entry* d_tail;
+        qint64 d_bytes;
+        qint64 d_budget;
+        mutable Stats d_stats;
         QStringList d_svSuffix;
         bool d_supportSvExt;
-        mutable QReadWriteLock d_lock;
+        mutable QMutex d_lock;
     };
 }
 
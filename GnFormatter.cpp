@@ -0,0 +1,580 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnFormatter.h"
+#include "GnErrors.h"
+#include "GnSynTree.h"
+#include <QAtomicInt>
+#include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+using namespace Gn;
+
+Formatter::Formatter():d_assignList(0),d_indent(0),
+    d_wantNl(false),d_wantBlank(false),d_wantSpace(false),d_noBlank(true),d_atBol(true)
+{
+}
+
+bool Formatter::format(const QByteArray& source, QByteArray& out, const QString& path, Errors* err)
+{
+    out = source;
+    if( !d_cst.parse( source, path, err ) )
+    {
+        d_cst.clear();
+        return false;
+    }
+
+    d_out.clear();
+    d_out.reserve( source.size() + source.size() / 8 );
+    d_suffix.clear();
+    d_done = QBitArray( d_cst.getTerminalCount() );
+    d_assignList = 0;
+    d_assignName.clear();
+    d_indent = 0;
+    d_wantNl = d_wantBlank = d_wantSpace = false;
+    d_noBlank = d_atBol = true;
+
+    if( d_cst.getRoot() )
+        statementList( d_cst.getRoot() );
+    trivia( d_cst.getTrailingTrivia(), true, d_cst.getTerminalCount() == 0 );
+    d_wantBlank = false;
+    if( d_wantNl || !d_suffix.isEmpty() || ( !d_out.isEmpty() && !d_out.endsWith('\n') ) )
+        flushLine();
+
+    out = d_out;
+    d_out.clear();
+    d_cst.clear();
+    return true;
+}
+
+Formatter::Result Formatter::formatFile(const QString& path, bool writeBack, Errors* err)
+{
+    Result res;
+    res.d_path = path;
+    QFile f(path);
+    if( !f.open(QIODevice::ReadOnly) )
+    {
+        if( err )
+            err->error( Errors::Lexer, path, 0, 0, "cannot open file for reading" );
+        return res;
+    }
+    const QByteArray source = f.readAll();
+    f.close();
+
+    QByteArray out;
+    if( !format( source, out, path, err ) )
+        return res;
+    res.d_ok = true;
+    res.d_changed = out != source;
+    if( !res.d_changed )
+        return res;
+    res.d_diff = diff( source, out, path );
+    if( writeBack )
+    {
+        if( !f.open(QIODevice::WriteOnly) || f.write(out) != out.size() )
+        {
+            if( err )
+                err->error( Errors::Generator, path, 0, 0, "cannot write formatted file" );
+            res.d_ok = false;
+        }
+    }
+    return res;
+}
+
+namespace Gn
+{
+    class FormatTask : public QRunnable
+    {
+    public:
+        FormatTask( const QStringList& files, Formatter::Result* res, QAtomicInt& next, bool writeBack, Errors* err ):
+            d_files(files),d_res(res),d_next(next),d_writeBack(writeBack),d_err(err){}
+        void run()
+        {
+            Formatter f;
+            int i;
+            while( ( i = d_next.fetchAndAddOrdered(1) ) < d_files.size() )
+                d_res[i] = f.formatFile( d_files[i], d_writeBack, d_err );
+        }
+    private:
+        const QStringList& d_files;
+        Formatter::Result* d_res; // each task only writes the elements it fetched
+        QAtomicInt& d_next;
+        bool d_writeBack;
+        Errors* d_err;
+    };
+}
+
+Formatter::Results Formatter::formatFiles(const QStringList& files, bool writeBack, Errors* err, int threads)
+{
+    Results res( files.size() );
+    if( threads <= 0 )
+        threads = QThread::idealThreadCount();
+    threads = qMax( 1, qMin( threads, files.size() ) );
+    QAtomicInt next(0);
+    if( threads == 1 )
+    {
+        FormatTask t( files, res.data(), next, writeBack, err );
+        t.run();
+        return res;
+    }
+    QThreadPool pool;
+    pool.setMaxThreadCount( threads );
+    for( int i = 0; i < threads; i++ )
+        pool.start( new FormatTask( files, res.data(), next, writeBack, err ) );
+    pool.waitForDone();
+    return res;
+}
+
+QByteArray Formatter::diff(const QByteArray& oldText, const QByteArray& newText, const QString& path)
+{
+    // one hunk spanning from the first to the last differing line; good enough for a presubmit report
+    const QList<QByteArray> a = oldText.split('\n');
+    const QList<QByteArray> b = newText.split('\n');
+    int pre = 0;
+    while( pre < a.size() && pre < b.size() && a[pre] == b[pre] )
+        pre++;
+    if( pre == a.size() && pre == b.size() )
+        return QByteArray();
+    int suf = 0;
+    while( suf < a.size() - pre && suf < b.size() - pre && a[a.size()-1-suf] == b[b.size()-1-suf] )
+        suf++;
+
+    const int context = 3;
+    const int from = qMax( 0, pre - context );
+    const int aTo = qMin( a.size(), a.size() - suf + context );
+    const int bTo = qMin( b.size(), b.size() - suf + context );
+
+    const QByteArray p = path.toUtf8();
+    QByteArray res = "--- " + p + "\n+++ " + p + "\n";
+    res += "@@ -" + QByteArray::number( from + 1 ) + "," + QByteArray::number( aTo - from ) +
+            " +" + QByteArray::number( from + 1 ) + "," + QByteArray::number( bTo - from ) + " @@\n";
+    for( int i = from; i < pre; i++ )
+        res += " " + a[i] + "\n";
+    for( int i = pre; i < a.size() - suf; i++ )
+        res += "-" + a[i] + "\n";
+    for( int i = pre; i < b.size() - suf; i++ )
+        res += "+" + b[i] + "\n";
+    for( int i = a.size() - suf; i < aTo; i++ )
+        res += " " + a[i] + "\n";
+    return res;
+}
+
+void Formatter::node(SynTree* st)
+{
+    switch( st->d_tok.d_type )
+    {
+    case SynTree::R_StatementList:
+        statementList(st);
+        break;
+    case SynTree::R_Assignment:
+        assignment(st);
+        break;
+    case SynTree::R_Call:
+        call(st);
+        break;
+    case SynTree::R_Condition:
+        condition(st);
+        break;
+    case SynTree::R_Block:
+        block(st);
+        break;
+    case SynTree::R_Expr_nlr_:
+        exprNlr(st);
+        break;
+    case SynTree::R_List_:
+        list(st);
+        break;
+    default:
+        // Statement, LValue, Expr, UnaryExpr, PrimaryExpr, ArrayAccess, ScopeAccess, signed_, Scope_
+        // and the operator rules are written without any spacing
+        if( st->d_tok.d_type < SynTree::R_First )
+            terminal(st);
+        else
+            foreach( SynTree* sub, st->d_children )
+                node(sub);
+        break;
+    }
+}
+
+void Formatter::statementList(SynTree* st)
+{
+    foreach( SynTree* s, st->d_children )
+    {
+        breakLine();
+        leading( firstTerminal(s), true );
+        node(s);
+    }
+}
+
+void Formatter::assignment(SynTree* st)
+{
+    Q_ASSERT( st->d_children.size() == 3 );
+    SynTree* lhs = st->d_children[0];
+    node( lhs );
+    space();
+    node( st->d_children[1] );
+    space();
+
+    SynTree* rhs = st->d_children[2];
+    SynTree* l = rhs;
+    while( l->d_children.size() == 1 && ( l->d_tok.d_type == SynTree::R_Expr ||
+                                          l->d_tok.d_type == SynTree::R_UnaryExpr ||
+                                          l->d_tok.d_type == SynTree::R_PrimaryExpr ) )
+        l = l->d_children.first();
+
+    SynTree* oldList = d_assignList;
+    const QByteArray oldName = d_assignName;
+    d_assignList = l->d_tok.d_type == SynTree::R_List_ ? l : 0;
+    d_assignName = lhs->d_children.size() == 1 ? lhs->d_children.first()->d_tok.d_val : QByteArray();
+    node( rhs );
+    d_assignList = oldList;
+    d_assignName = oldName;
+}
+
+void Formatter::call(SynTree* st)
+{
+    // identifier '(' [ ExprList ] ')' [ Block ]
+    int i = 0;
+    terminal( st->d_children[i++] );
+    terminal( st->d_children[i++] );
+    if( st->d_children[i]->d_tok.d_type == SynTree::R_ExprList )
+    {
+        SynTree* args = st->d_children[i++];
+        for( int j = 0; j < args->d_children.size(); j++ )
+        {
+            if( j != 0 )
+            {
+                write(",");
+                space();
+            }
+            node( args->d_children[j] );
+        }
+    }
+    terminal( st->d_children[i++] );
+    if( i < st->d_children.size() )
+    {
+        space();
+        block( st->d_children[i] );
+    }
+}
+
+void Formatter::condition(SynTree* st)
+{
+    // 'if' '(' Expr ')' Block [ 'else' ( Condition | Block ) ]
+    Q_ASSERT( st->d_children.size() >= 5 );
+    terminal( st->d_children[0] );
+    space();
+    terminal( st->d_children[1] );
+    node( st->d_children[2] );
+    terminal( st->d_children[3] );
+    space();
+    block( st->d_children[4] );
+    if( st->d_children.size() > 6 )
+    {
+        space();
+        terminal( st->d_children[5] );
+        space();
+        node( st->d_children[6] );
+    }
+}
+
+void Formatter::block(SynTree* st)
+{
+    // '{' StatementList '}'
+    Q_ASSERT( st->d_children.size() == 3 );
+    terminal( st->d_children[0] );
+    d_indent += 2;
+    statementList( st->d_children[1] );
+    leading( st->d_children[2], false ); // comments at the end of the block are indented like statements
+    d_indent -= 2;
+    breakLine();
+    terminal( st->d_children[2] );
+}
+
+void Formatter::exprNlr(SynTree* st)
+{
+    // BinaryOp Expr [ Expr_nlr_ ]
+    space();
+    node( st->d_children[0] );
+    space();
+    for( int i = 1; i < st->d_children.size(); i++ )
+        node( st->d_children[i] );
+}
+
+void Formatter::list(SynTree* st)
+{
+    // '[' { Expr } ']', commas are not in the tree
+    SynTree* close = st->d_children.last();
+    QList<SynTree*> elems = st->d_children.mid( 1, st->d_children.size() - 2 );
+    terminal( st->d_children.first() );
+
+    const bool multiLine = hasComments(st) || ( st == d_assignList && elems.size() > 1 ) ||
+            column() + flatWidth(st) > LineWidth;
+    if( !multiLine )
+    {
+        if( !elems.isEmpty() )
+        {
+            space();
+            for( int i = 0; i < elems.size(); i++ )
+            {
+                if( i != 0 )
+                {
+                    write(",");
+                    space();
+                }
+                node( elems[i] );
+            }
+            space();
+        }
+        terminal( close );
+        return;
+    }
+
+    QList<bool> blankBefore;
+    // a same-line comment is leading trivia of the next element, so it would move with the wrong one
+    const bool sorted = st == d_assignList && !hasComments(st) && sortList( elems, blankBefore );
+    d_indent += 2;
+    for( int i = 0; i < elems.size(); i++ )
+    {
+        breakLine();
+        if( sorted )
+            d_wantBlank = blankBefore[i];
+        else
+            leading( firstTerminal( elems[i] ), true );
+        node( elems[i] );
+        write(",");
+    }
+    leading( close, false );
+    d_indent -= 2;
+    breakLine();
+    terminal( close );
+}
+
+void Formatter::terminal(SynTree* st)
+{
+    leading( st, false );
+    write( d_cst.getText(st) );
+}
+
+void Formatter::leading(SynTree* terminal, bool atLineStart)
+{
+    const int i = d_cst.indexOf( terminal );
+    if( i < 0 || d_done.testBit(i) )
+        return;
+    d_done.setBit(i);
+    trivia( d_cst.getLeadingTrivia(i), atLineStart, i == 0 );
+}
+
+void Formatter::trivia(const Cst::TriviaList& l, bool atLineStart, bool fileStart)
+{
+    int nl = fileStart ? 1 : 0; // newlines since the last token or comment
+    foreach( const Cst::Trivia& t, l )
+    {
+        switch( t.d_kind )
+        {
+        case Cst::Trivia::Newline:
+            nl++;
+            break;
+        case Cst::Trivia::Comment:
+            {
+                QByteArray text = d_cst.getText(t);
+                int len = text.size();
+                while( len > 0 && ( text[len-1] == ' ' || text[len-1] == '\t' ) )
+                    len--;
+                text.truncate(len);
+                if( nl == 0 && d_suffix.isEmpty() )
+                    d_suffix = text;
+                else
+                {
+                    if( nl > 1 )
+                        d_wantBlank = true;
+                    breakLine();
+                    write( text );
+                    breakLine();
+                }
+                nl = 0;
+            }
+            break;
+        case Cst::Trivia::Other:
+            space();
+            write( d_cst.getText(t) );
+            break;
+        default:
+            break;
+        }
+    }
+    if( atLineStart && nl > 1 )
+        d_wantBlank = true;
+}
+
+void Formatter::write(const QByteArray& str)
+{
+    if( !d_suffix.isEmpty() )
+        d_wantNl = true; // the comment runs to the end of the line
+    if( d_wantNl )
+        flushLine();
+    if( d_atBol )
+    {
+        d_out += QByteArray( d_indent, ' ' );
+        d_atBol = false;
+    }else if( d_wantSpace )
+        d_out += ' ';
+    d_wantSpace = false;
+    d_out += str;
+    d_noBlank = str == "{" || str == "[";
+}
+
+void Formatter::flushLine()
+{
+    if( !d_suffix.isEmpty() )
+    {
+        d_out += "  ";
+        d_out += d_suffix;
+        d_suffix.clear();
+    }
+    if( !d_out.isEmpty() )
+    {
+        d_out += '\n';
+        if( d_wantBlank && !d_noBlank )
+            d_out += '\n';
+    }
+    d_wantNl = d_wantBlank = d_wantSpace = false;
+    d_atBol = true;
+}
+
+int Formatter::column() const
+{
+    if( d_atBol || d_wantNl )
+        return d_indent;
+    return d_out.size() - ( d_out.lastIndexOf('\n') + 1 ) + ( d_wantSpace ? 1 : 0 );
+}
+
+int Formatter::flatWidth(SynTree* st) const
+{
+    // upper bound of the width if written on one line
+    if( st->d_tok.d_type < SynTree::R_First )
+        return st->d_tok.d_len + 1;
+    int w = 0;
+    foreach( SynTree* sub, st->d_children )
+        w += flatWidth(sub);
+    return w;
+}
+
+bool Formatter::hasComments(SynTree* st) const
+{
+    const int first = d_cst.indexOf( firstTerminal(st) );
+    const int last = d_cst.indexOf( lastTerminal(st) );
+    if( first < 0 || last < 0 )
+        return false;
+    for( int i = first + 1; i <= last; i++ )
+    {
+        foreach( const Cst::Trivia& t, d_cst.getLeadingTrivia(i) )
+        {
+            if( t.d_kind == Cst::Trivia::Comment )
+                return true;
+        }
+    }
+    return false;
+}
+
+struct SortItem
+{
+    int d_class;
+    QByteArray d_text;
+    SynTree* d_st;
+    bool operator<( const SortItem& rhs ) const
+    {
+        return d_class < rhs.d_class || ( d_class == rhs.d_class && d_text < rhs.d_text );
+    }
+};
+
+bool Formatter::sortList(QList<SynTree*>& elems, QList<bool>& blankBefore) const
+{
+    enum { None, Files, Labels };
+    int kind = None;
+    if( d_assignName == "sources" || d_assignName == "public" || d_assignName == "inputs" )
+        kind = Files;
+    else if( d_assignName == "deps" || d_assignName == "public_deps" || d_assignName == "data_deps" )
+        kind = Labels;
+    if( kind == None )
+        return false;
+
+    QList<SortItem> items;
+    blankBefore.clear();
+    foreach( SynTree* e, elems )
+    {
+        SynTree* s = e;
+        while( s->d_children.size() == 1 )
+            s = s->d_children.first();
+        if( s->d_tok.d_type != Tok_string )
+            return false;
+        SortItem item;
+        item.d_text = d_cst.getText(s);
+        item.d_st = e;
+        item.d_class = 0;
+        if( kind == Labels )
+        {
+            // local labels first, then relative, then absolute ones
+            if( item.d_text.startsWith("\":") )
+                item.d_class = 0;
+            else if( item.d_text.startsWith("\"//") )
+                item.d_class = 2;
+            else
+                item.d_class = 1;
+        }
+        items.append(item);
+        int nl = 0;
+        foreach( const Cst::Trivia& t, d_cst.getLeadingTrivia( d_cst.indexOf(s) ) )
+        {
+            if( t.d_kind == Cst::Trivia::Newline )
+                nl++;
+        }
+        blankBefore.append( nl > 1 );
+    }
+
+    // blank lines separate groups which are sorted individually
+    int from = 0;
+    for( int i = 1; i <= items.size(); i++ )
+    {
+        if( i == items.size() || blankBefore[i] )
+        {
+            std::stable_sort( items.begin() + from, items.begin() + i );
+            from = i;
+        }
+    }
+    for( int i = 0; i < items.size(); i++ )
+        elems[i] = items[i].d_st;
+    return true;
+}
+
+SynTree* Formatter::firstTerminal(SynTree* st)
+{
+    while( st && st->d_tok.d_type >= SynTree::R_First )
+        st = st->d_children.isEmpty() ? 0 : st->d_children.first();
+    return st;
+}
+
+SynTree* Formatter::lastTerminal(SynTree* st)
+{
+    while( st && st->d_tok.d_type >= SynTree::R_First )
+        st = st->d_children.isEmpty() ? 0 : st->d_children.last();
+    return st;
+}
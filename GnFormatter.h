@@ -0,0 +1,99 @@
+#ifndef GNFORMATTER_H
+#define GNFORMATTER_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnCst.h>
+#include <QBitArray>
+#include <QStringList>
+
+/*
+ *  Reformats GN files in canonical style (like 'gn format')
+ *  - Two spaces indentation, one statement per line, spaces around binary and assignment operators
+ *  - Lists assigned to a variable with more than one element, lists containing comments and lists
+ *    exceeding the line width are written one element per line with trailing comma
+ *  - String lists assigned to sources, deps etc. are sorted unless they contain comments
+ *  - Comments are preserved; consecutive blank lines are collapsed into one
+ *  - Files with syntax errors are left untouched
+ *  - formatFiles processes a list of files in parallel in the same process
+*/
+
+namespace Gn
+{
+    class Errors;
+
+    class Formatter
+    {
+    public:
+        enum { LineWidth = 80 };
+
+        struct Result
+        {
+            QString d_path;
+            bool d_ok;      // false if file couldn't be read, parsed or written
+            bool d_changed; // formatted text differs from file content
+            QByteArray d_diff; // unified diff, empty if !d_changed
+            Result():d_ok(false),d_changed(false){}
+        };
+        typedef QVector<Result> Results;
+
+        Formatter();
+
+        bool format( const QByteArray& source, QByteArray& out, const QString& path = QString(), Errors* = 0 );
+        Result formatFile( const QString& path, bool writeBack = false, Errors* = 0 );
+
+        // threads == 0 means QThread::idealThreadCount; results are in the order of files
+        static Results formatFiles( const QStringList& files, bool writeBack = false, Errors* = 0, int threads = 0 );
+        static QByteArray diff( const QByteArray& oldText, const QByteArray& newText, const QString& path );
+    protected:
+        void node( SynTree* );
+        void statementList( SynTree* );
+        void assignment( SynTree* );
+        void call( SynTree* );
+        void condition( SynTree* );
+        void block( SynTree* );
+        void exprNlr( SynTree* );
+        void list( SynTree* );
+        void terminal( SynTree* );
+        void leading( SynTree* terminal, bool atLineStart );
+        void trivia( const Cst::TriviaList&, bool atLineStart, bool fileStart );
+        void write( const QByteArray& );
+        void space() { d_wantSpace = true; }
+        void breakLine() { d_wantNl = true; }
+        void flushLine();
+        int column() const;
+        int flatWidth( SynTree* ) const;
+        bool hasComments( SynTree* ) const;
+        bool sortList( QList<SynTree*>& elems, QList<bool>& blankBefore ) const;
+        static SynTree* firstTerminal( SynTree* );
+        static SynTree* lastTerminal( SynTree* );
+    private:
+        Cst d_cst;
+        QByteArray d_out;
+        QByteArray d_suffix; // comment to be appended to the current line
+        QBitArray d_done; // leading trivia already written, per terminal index
+        SynTree* d_assignList; // list which is the direct rhs of the current assignment
+        QByteArray d_assignName;
+        int d_indent;
+        bool d_wantNl, d_wantBlank, d_wantSpace, d_noBlank, d_atBol;
+    };
+}
+
+#endif // GNFORMATTER_H
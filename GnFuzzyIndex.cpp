@@ -0,0 +1,214 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnFuzzyIndex.h"
+#include "GnCodeModel.h"
+#include "GnSynTree.h"
+#include "GnLexer.h"
+#include <algorithm>
+using namespace Gn;
+
+static inline int charClass( char c )
+{
+    if( c >= 'a' && c <= 'z' )
+        return c - 'a';
+    if( c >= '0' && c <= '9' )
+        return 26 + c - '0';
+    switch( c )
+    {
+    case '_':
+        return 36;
+    case '/':
+        return 37;
+    case '.':
+        return 38;
+    case '-':
+        return 39;
+    case ':':
+        return 40;
+    case ' ':
+        return 41;
+    default:
+        return 42;
+    }
+}
+
+static inline bool isSeparator( char c )
+{
+    return c == '/' || c == '_' || c == '.' || c == '-' || c == ':' || c == ' ';
+}
+
+FuzzyIndex::FuzzyIndex()
+{
+}
+
+void FuzzyIndex::build(const CodeModel* mdl)
+{
+    clear();
+    const QByteArray templ = Lexer::getSymbol("template");
+    const QByteArray arg = Lexer::getSymbol("declare_args");
+
+    const QByteArrayList files = mdl->getFileList();
+    foreach( const QByteArray& f, files )
+    {
+        const CodeModel::Scope* s = mdl->getScope(f);
+        add( mdl->relativePath(f).toUtf8(), File, s ? s->d_st : 0, f.constData(), 0 );
+    }
+
+    const CodeModel::ObjRefs& objs = mdl->getAllObjDefs();
+    for( CodeModel::ObjRefs::const_iterator i = objs.begin(); i != objs.end(); ++i )
+    {
+        foreach( CodeModel::Scope* s, i.value() )
+        {
+            if( s->d_st == 0 )
+                continue;
+            add( s->d_name, s->d_kind.constData() == templ.constData() ? Template : Target, s->d_st,
+                 s->d_st->d_tok.d_sourcePath.constData(), s->d_kind.constData() );
+        }
+    }
+
+    foreach( SynTree* st, mdl->getDeclaredArgs() )
+        add( st->d_tok.d_val, Arg, st, st->d_tok.d_sourcePath.constData(), arg.constData() );
+    d_entries.squeeze();
+}
+
+void FuzzyIndex::clear()
+{
+    d_entries.clear();
+    d_text.clear();
+    d_lower.clear();
+}
+
+void FuzzyIndex::add(const QByteArray& text, quint8 kind, SynTree* st, const char* file, const char* detail)
+{
+    Entry e;
+    e.d_off = d_text.size();
+    e.d_len = qMin( text.size(), 0xffff );
+    e.d_kind = kind;
+    e.d_st = st;
+    e.d_file = file;
+    e.d_detail = detail;
+    d_text.append( text.constData(), e.d_len );
+    d_lower.append( text.left(e.d_len).toLower() );
+    e.d_mask = mask( d_lower.constData() + e.d_off, e.d_len );
+    d_entries.append(e);
+}
+
+quint64 FuzzyIndex::mask(const char* lower, int len)
+{
+    quint64 res = 0;
+    for( int i = 0; i < len; i++ )
+        res |= quint64(1) << charClass( lower[i] );
+    return res;
+}
+
+QByteArray FuzzyIndex::getText(quint32 entry) const
+{
+    const Entry& e = d_entries[entry];
+    return d_text.mid( e.d_off, e.d_len );
+}
+
+enum { MatchBonus = 16, StartBonus = 10, WordBonus = 8, CamelBonus = 7, ConsecutiveBonus = 6, MaxStarts = 8 };
+
+static qint32 scoreFrom( const char* text, const char* lower, int len, const char* q, int qlen, int start )
+{
+    qint32 res = 0;
+    int prev = -2;
+    int pos = start;
+    for( int k = 0; k < qlen; k++ )
+    {
+        while( pos < len && lower[pos] != q[k] )
+            pos++;
+        if( pos >= len )
+            return 0;
+        res += MatchBonus;
+        if( pos == 0 )
+            res += StartBonus;
+        else if( isSeparator( text[pos-1] ) )
+            res += WordBonus;
+        else if( text[pos] >= 'A' && text[pos] <= 'Z' && text[pos-1] >= 'a' && text[pos-1] <= 'z' )
+            res += CamelBonus;
+        if( pos == prev + 1 )
+            res += ConsecutiveBonus;
+        else if( prev >= 0 )
+            res -= qMin( pos - prev - 1, 4 ); // gap
+        prev = pos;
+        pos++;
+    }
+    return res;
+}
+
+qint32 FuzzyIndex::score(const char* text, const char* lower, int len, const char* q, int qlen)
+{
+    if( qlen == 0 || qlen > len )
+        return 0;
+    // the greedy match from the first occurrence tells whether there is a match at all; later
+    // occurrences of the first query character may give a better alignment (e.g. a word start)
+    qint32 best = 0;
+    int starts = 0;
+    for( int i = 0; i <= len - qlen && starts < MaxStarts; i++ )
+    {
+        if( lower[i] != q[0] )
+            continue;
+        const qint32 s = scoreFrom( text, lower, len, q, qlen, i );
+        if( s == 0 )
+            break; // no later start can match either
+        best = qMax( best, s );
+        starts++;
+    }
+    if( best > 0 )
+    {
+        best -= len / 8; // shorter names first
+        if( best < 1 )
+            best = 1;
+    }
+    return best;
+}
+
+static bool BetterMatch( const FuzzyIndex::Match& lhs, const FuzzyIndex::Match& rhs )
+{
+    return lhs.d_score > rhs.d_score || ( lhs.d_score == rhs.d_score && lhs.d_entry < rhs.d_entry );
+}
+
+FuzzyIndex::Matches FuzzyIndex::find(const QByteArray& query, int maxHits) const
+{
+    Matches res;
+    const QByteArray q = query.trimmed().toLower();
+    if( q.isEmpty() )
+        return res;
+    const quint64 qmask = mask( q.constData(), q.size() );
+    const char* text = d_text.constData();
+    const char* lower = d_lower.constData();
+    for( int i = 0; i < d_entries.size(); i++ )
+    {
+        const Entry& e = d_entries[i];
+        if( ( e.d_mask & qmask ) != qmask || e.d_len < q.size() )
+            continue;
+        const qint32 s = score( text + e.d_off, lower + e.d_off, e.d_len, q.constData(), q.size() );
+        if( s > 0 )
+            res.append( Match( i, s ) );
+    }
+    if( res.size() > maxHits )
+    {
+        std::partial_sort( res.begin(), res.begin() + maxHits, res.end(), BetterMatch );
+        res.resize( maxHits );
+    }else
+        std::sort( res.begin(), res.end(), BetterMatch );
+    return res;
+}
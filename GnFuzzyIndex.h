@@ -0,0 +1,88 @@
+#ifndef GNFUZZYINDEX_H
+#define GNFUZZYINDEX_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QVector>
+#include <QByteArray>
+
+/*
+ *  Index for "go to anything": file paths, named objects (targets, configs, templates, ...)
+ *  and declared args
+ *  - The names are stored back to back in one buffer (plus a case folded copy); an entry only
+ *    holds offset, length, kind and a 64 bit mask of the character classes it contains
+ *  - A query first rejects all entries whose mask lacks a character of the query, then scores
+ *    the rest by in-order matching with bonuses for word starts and consecutive characters
+*/
+
+namespace Gn
+{
+    class CodeModel;
+    class SynTree;
+
+    class FuzzyIndex
+    {
+    public:
+        enum Kind { File, Target, Template, Arg };
+        struct Match
+        {
+            quint32 d_entry;
+            qint32 d_score;
+            Match(quint32 e = 0, qint32 s = 0):d_entry(e),d_score(s){}
+        };
+        typedef QVector<Match> Matches;
+
+        FuzzyIndex();
+
+        void build( const CodeModel* );
+        void clear();
+        int getCount() const { return d_entries.size(); }
+
+        Matches find( const QByteArray& query, int maxHits = 50 ) const;
+
+        QByteArray getText( quint32 entry ) const;
+        quint8 getKind( quint32 entry ) const { return d_entries[entry].d_kind; }
+        SynTree* getSynTree( quint32 entry ) const { return d_entries[entry].d_st; }
+        const char* getFile( quint32 entry ) const { return d_entries[entry].d_file; }
+        const char* getDetail( quint32 entry ) const { return d_entries[entry].d_detail; }
+
+        // returns 0 if query is no subsequence of text, else a positive score; lower is case folded text
+        static qint32 score( const char* text, const char* lower, int len, const char* query, int qlen );
+    protected:
+        void add( const QByteArray& text, quint8 kind, SynTree*, const char* file, const char* detail );
+        static quint64 mask( const char* lower, int len );
+    private:
+        struct Entry
+        {
+            quint64 d_mask;
+            quint32 d_off;
+            quint16 d_len;
+            quint8 d_kind;
+            SynTree* d_st;
+            const char* d_file; // symbol
+            const char* d_detail; // symbol, e.g. the kind of a named object
+        };
+        QVector<Entry> d_entries;
+        QByteArray d_text;
+        QByteArray d_lower;
+    };
+}
+
+#endif // GNFUZZYINDEX_H
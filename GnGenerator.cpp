@@ -0,0 +1,240 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnGenerator.h"
+#include "GnErrors.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+using namespace Gn;
+
+namespace Gn
+{
+    class GenerateTask : public QRunnable
+    {
+    public:
+        GenerateTask( Generator* gen, int count, QAtomicInt& next ):d_gen(gen),d_count(count),d_next(next){}
+        void run()
+        {
+            int i;
+            while( ( i = d_next.fetchAndAddOrdered(1) ) < d_count )
+                d_gen->generateUnit(i);
+        }
+    private:
+        Generator* d_gen;
+        int d_count;
+        QAtomicInt& d_next;
+    };
+}
+
+Generator::Generator(Evaluator* e):d_eval(e),d_written(0),d_unchanged(0),d_failed(0),d_threads(0)
+{
+    Q_ASSERT( e != 0 );
+}
+
+bool Generator::generate()
+{
+    d_written.store(0);
+    d_unchanged.store(0);
+    d_failed.store(0);
+    d_names.clear();
+    assignNames( d_eval->getTargets() );
+    assignNames( d_eval->getConfigs() );
+    const int count = prepare();
+    int threads = d_threads <= 0 ? QThread::idealThreadCount() : d_threads;
+    threads = qMax( 1, qMin( threads, count ) );
+    QAtomicInt next(0);
+    if( threads == 1 )
+    {
+        GenerateTask t( this, count, next );
+        t.run();
+    }else
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount( threads );
+        for( int i = 0; i < threads; i++ )
+            pool.start( new GenerateTask( this, count, next ) );
+        pool.waitForDone();
+    }
+    finish();
+    return d_failed.load() == 0;
+}
+
+Generator::Stats Generator::getStats() const
+{
+    Stats s;
+    s.d_written = d_written.load();
+    s.d_unchanged = d_unchanged.load();
+    s.d_failed = d_failed.load();
+    return s;
+}
+
+bool Generator::writeFileIfChanged(const QString& path, const QByteArray& content, bool* changed)
+{
+    if( changed )
+        *changed = false;
+    const QFileInfo info(path);
+    if( info.exists() && info.size() == content.size() )
+    {
+        QFile in(path);
+        if( in.open(QIODevice::ReadOnly) && in.readAll() == content )
+            return true;
+    }
+    if( !QDir().mkpath( info.absolutePath() ) )
+        return false;
+    QFile out(path);
+    if( !out.open(QIODevice::WriteOnly | QIODevice::Truncate) )
+        return false;
+    if( out.write(content) != content.size() )
+        return false;
+    if( changed )
+        *changed = true;
+    return true;
+}
+
+bool Generator::writeFile(const QString& path, const QByteArray& content)
+{
+    bool changed;
+    if( !writeFileIfChanged( path, content, &changed ) )
+    {
+        fail( path, "cannot write file" );
+        return false;
+    }
+    if( changed )
+        d_written.fetchAndAddOrdered(1);
+    else
+        d_unchanged.fetchAndAddOrdered(1);
+    return true;
+}
+
+static bool sameContent( const QString& a, const QString& b )
+{
+    QFile fa(a), fb(b);
+    if( !fa.open(QIODevice::ReadOnly) || !fb.open(QIODevice::ReadOnly) || fa.size() != fb.size() )
+        return false;
+    while( !fa.atEnd() )
+    {
+        if( fa.read(64 * 1024) != fb.read(64 * 1024) )
+            return false;
+    }
+    return true;
+}
+
+bool Generator::replaceFile(const QString& path, const QString& tmp)
+{
+    if( sameContent( path, tmp ) )
+    {
+        QFile::remove(tmp);
+        d_unchanged.fetchAndAddOrdered(1);
+        return true;
+    }
+    QFile::remove(path);
+    if( !QFile::rename( tmp, path ) )
+    {
+        fail( path, "cannot write file" );
+        return false;
+    }
+    d_written.fetchAndAddOrdered(1);
+    return true;
+}
+
+void Generator::error(const QString& path, const QString& msg)
+{
+    d_eval->getErrs()->error( Errors::Generator, path, 0, 0, msg );
+}
+
+void Generator::fail(const QString& path, const QString& msg)
+{
+    d_failed.fetchAndAddOrdered(1);
+    error( path, msg );
+}
+
+void Generator::collectDeps(const Evaluator::Target* t, TargetList& link, TargetList& order,
+                            QSet<const Evaluator::Target*>& visited) const
+{
+    // groups are transparent; executables and non-binary targets are only build order dependencies
+    foreach( const Evaluator::Target* d, d_eval->getDeps(t) )
+    {
+        if( visited.contains(d) )
+            continue;
+        visited.insert(d);
+        if( d->d_type == d_eval->getSymbol("group") )
+        {
+            order.append(d);
+            collectDeps( d, link, order, visited );
+        }else if( d_eval->isBinary(d) && d->d_type != d_eval->getSymbol("executable") )
+            link.append(d);
+        else
+            order.append(d);
+    }
+}
+
+QByteArray Generator::mangledName(const Evaluator::Item* i) const
+{
+    QHash<const Evaluator::Item*,QByteArray>::const_iterator n = d_names.constFind(i);
+    if( n != d_names.constEnd() )
+        return n.value();
+    return mangle(i->d_label);
+}
+
+static bool LabelLessThan( const Evaluator::Item* lhs, const Evaluator::Item* rhs )
+{
+    return lhs->d_label < rhs->d_label;
+}
+
+void Generator::assignNames(const Evaluator::Items& items)
+{
+    // "//a/b:c" and "//a:b_c" both become "a_b_c"; all but the first in label order get a suffix,
+    // so the names don't depend on the evaluation order and stay the same as long as the labels do
+    QHash<QByteArray,QList<const Evaluator::Item*> > byName;
+    foreach( const Evaluator::Item* i, items )
+        byName[mangle(i->d_label)].append(i);
+    QHash<QByteArray,QList<const Evaluator::Item*> >::iterator i;
+    for( i = byName.begin(); i != byName.end(); ++i )
+    {
+        if( i.value().size() < 2 )
+            continue;
+        std::sort( i.value().begin(), i.value().end(), LabelLessThan );
+        int suffix = 2;
+        for( int k = 1; k < i.value().size(); k++ )
+        {
+            QByteArray name;
+            do
+                name = i.key() + "_" + QByteArray::number(suffix++);
+            while( byName.contains(name) );
+            d_names.insert( i.value()[k], name );
+        }
+    }
+}
+
+QByteArray Generator::mangle(const QByteArray& label)
+{
+    QByteArray res = label.startsWith("//") ? label.mid(2) : label;
+    for( int k = 0; k < res.size(); k++ )
+    {
+        const char c = res[k];
+        if( !( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '_' ) )
+            res[k] = '_';
+    }
+    return res;
+}
@@ -0,0 +1,85 @@
+#ifndef GNGENERATOR_H
+#define GNGENERATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnEvaluator.h>
+#include <QAtomicInt>
+#include <QString>
+
+/*
+ *  Base of the generators which translate the targets of an Evaluator to the files of another build system
+ *  - generate() calls prepare(), then generateUnit() for each unit in parallel, then finish()
+ *  - Units only read the Evaluator, which doesn't change after evaluate(), and write their own files
+ *  - writeFile() leaves files alone whose content wouldn't change, so a regeneration keeps their
+ *    timestamps and the other build system only reconsiders what actually changed
+ *  - Errors are reported as Generator errors to the Errors of the Evaluator
+*/
+
+namespace Gn
+{
+    class Generator
+    {
+    public:
+        typedef QList<const Evaluator::Target*> TargetList;
+        struct Stats
+        {
+            quint32 d_written, d_unchanged, d_failed; // files
+            Stats():d_written(0),d_unchanged(0),d_failed(0){}
+        };
+
+        explicit Generator( Evaluator* );
+        virtual ~Generator() {}
+
+        void setOutputDir( const QString& dir ) { d_outDir = dir; }
+        const QString& getOutputDir() const { return d_outDir; }
+        void setThreads( int n ) { d_threads = n; } // 0 means QThread::idealThreadCount
+
+        bool generate(); // false if a file couldn't be written
+        Stats getStats() const;
+
+        static bool writeFileIfChanged( const QString& path, const QByteArray& content, bool* changed = 0 );
+    protected:
+        virtual int prepare() = 0; // returns the number of units
+        virtual void generateUnit( int ) = 0; // called in parallel
+        virtual void finish() {}
+        bool writeFile( const QString& path, const QByteArray& content ); // thread-safe
+        bool replaceFile( const QString& path, const QString& tmp ); // tmp was streamed; replaces path if different
+        void error( const QString& path, const QString& msg );
+        void fail( const QString& path, const QString& msg ); // error() and counts the file as failed
+        // direct deps with groups resolved; link gets the libraries, order the other build order dependencies
+        void collectDeps( const Evaluator::Target*, TargetList& link, TargetList& order,
+                          QSet<const Evaluator::Target*>& visited ) const;
+        // from the label, e.g. "base_util_strings"; unique among the targets and among the configs
+        QByteArray mangledName( const Evaluator::Item* ) const;
+
+        Evaluator* d_eval;
+        QString d_outDir;
+    private:
+        friend class GenerateTask;
+        static QByteArray mangle( const QByteArray& label );
+        void assignNames( const Evaluator::Items& );
+        QHash<const Evaluator::Item*,QByteArray> d_names; // only set where the label doesn't suffice
+        QAtomicInt d_written, d_unchanged, d_failed;
+        int d_threads;
+    };
+}
+
+#endif // GNGENERATOR_H
@@ -0,0 +1,106 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN Viewer application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnGotoDialog.h"
+#include "GnCodeModel.h"
+#include "GnSynTree.h"
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+#include <QApplication>
+using namespace Gn;
+
+GotoDialog::GotoDialog(CodeModel* mdl, QWidget* parent):QDialog(parent),d_mdl(mdl)
+{
+    Q_ASSERT( mdl != 0 );
+    setWindowTitle( tr("Go to Anything") );
+    QVBoxLayout* vbox = new QVBoxLayout(this);
+    vbox->setMargin(2);
+    vbox->setSpacing(2);
+    d_edit = new QLineEdit(this);
+    d_edit->setPlaceholderText( tr("file, target, template or arg") );
+    vbox->addWidget(d_edit);
+    d_list = new QListWidget(this);
+    d_list->setUniformItemSizes(true);
+    vbox->addWidget(d_list);
+    d_edit->installEventFilter(this);
+    resize( 700, 400 );
+
+    connect( d_edit, SIGNAL(textChanged(QString)), this, SLOT(onTextChanged(QString)) );
+    connect( d_edit, SIGNAL(returnPressed()), this, SLOT(accept()) );
+    connect( d_list, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(accept()) );
+}
+
+int GotoDialog::getSelected() const
+{
+    if( d_list->currentItem() == 0 )
+        return -1;
+    return d_list->currentItem()->data(Qt::UserRole).toInt();
+}
+
+void GotoDialog::onTextChanged(const QString& str)
+{
+    d_list->clear();
+    const FuzzyIndex* idx = d_mdl->getFuzzyIndex();
+    const FuzzyIndex::Matches hits = idx->find( str.toUtf8(), MaxShown );
+    foreach( const FuzzyIndex::Match& m, hits )
+    {
+        // only the shown entries are formatted
+        QString text = QString::fromUtf8( idx->getText(m.d_entry) );
+        QString where;
+        switch( idx->getKind(m.d_entry) )
+        {
+        case FuzzyIndex::File:
+            break;
+        default:
+            {
+                const SynTree* st = idx->getSynTree(m.d_entry);
+                where = QString("%1:%2").arg(d_mdl->relativePath(idx->getFile(m.d_entry)))
+                        .arg( st ? st->d_tok.d_lineNr : 0 );
+                text = QString("%1   [%2]   %3").arg(text).arg(idx->getDetail(m.d_entry)).arg(where);
+            }
+            break;
+        }
+        QListWidgetItem* item = new QListWidgetItem( text, d_list );
+        item->setToolTip( text );
+        item->setData( Qt::UserRole, m.d_entry );
+    }
+    if( d_list->count() )
+        d_list->setCurrentRow(0);
+}
+
+bool GotoDialog::eventFilter(QObject* watched, QEvent* event)
+{
+    // keep the focus in the line edit, but let the arrow keys move the selection
+    if( watched == d_edit && event->type() == QEvent::KeyPress )
+    {
+        QKeyEvent* e = static_cast<QKeyEvent*>(event);
+        switch( e->key() )
+        {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent( d_list, event );
+            return true;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
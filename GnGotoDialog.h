@@ -0,0 +1,55 @@
+#ifndef GNGOTODIALOG_H
+#define GNGOTODIALOG_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN Viewer application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QDialog>
+
+class QLineEdit;
+class QListWidget;
+
+namespace Gn
+{
+    class CodeModel;
+
+    // Go to anything: the list shows the best FuzzyIndex matches for the text typed so far
+    class GotoDialog : public QDialog
+    {
+        Q_OBJECT
+    public:
+        enum { MaxShown = 50 };
+        GotoDialog( CodeModel*, QWidget* parent = 0 );
+
+        int getSelected() const; // FuzzyIndex entry or -1
+
+    protected slots:
+        void onTextChanged( const QString& );
+
+    protected:
+        bool eventFilter(QObject* watched, QEvent* event);
+
+    private:
+        CodeModel* d_mdl;
+        QLineEdit* d_edit;
+        QListWidget* d_list;
+    };
+}
+
+#endif // GNGOTODIALOG_H
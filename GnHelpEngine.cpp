@@ -18,24 +18,28 @@
 */
 
 #include "GnHelpEngine.h"
-
+#include "GnHelpIndex.h"
 #include <QBuffer>
 #include <QFile>
+#include <QCryptographicHash>
 #include <QtDebug>
 using namespace Gn;
 
 static const char* s_nameRef = "### <a name=";
 static const int s_nameRefLen = 13;
 
-HelpEngine::HelpEngine(QObject *parent) : QObject(parent)
+HelpEngine::HelpEngine(QObject *parent) : QObject(parent),d_html(64)
 {
 
 }
 
 QString HelpEngine::getHelpFrom(const QByteArray& name)
 {
+    if( const QString* cached = d_html.object(name) )
+        return *cached;
+
     if( d_sections.isEmpty() )
-        parseFile();
+        loadIndex();
 
     Sections::const_iterator i = d_sections.find(name);
     if( i == d_sections.end() )
@@ -49,14 +53,32 @@ QString HelpEngine::getHelpFrom(const QByteArray& name)
         html += formatMd(getSection(s.d_pos, s.d_len),s.d_kind);
     }
     html += "</body></html>";
+    d_html.insert( name, new QString(html) );
     return html;
 }
 
-void HelpEngine::parseFile()
+void HelpEngine::loadIndex()
 {
     QFile in(":/embedded_files/gn_help.md");
     if( !in.open(QIODevice::ReadOnly ) )
         Q_ASSERT( false );
+    d_file = in.readAll();
+
+    if( QCryptographicHash::hash( d_file, QCryptographicHash::Md5 ).toHex() == s_helpFileMd5 )
+    {
+        for( int i = 0; i < s_helpIndexCount; i++ )
+        {
+            const HelpIndexEntry& e = s_helpIndex[i];
+            d_sections[e.d_name].append( Section( e.d_pos, e.d_len, e.d_kind ) );
+        }
+    }else
+        parseFile(); // gn_help.md was replaced without running embedded_files/run_helpgen
+}
+
+void HelpEngine::parseFile()
+{
+    QBuffer in(&d_file);
+    in.open(QIODevice::ReadOnly);
 
     int pos = in.pos();
     QByteArray line = in.readLine();
@@ -156,12 +178,8 @@ QString HelpEngine::formatMd(const QByteArray& str, int kind)
     return html;
 }
 
-QByteArray HelpEngine::getSection(int pos, int len)
+QByteArray HelpEngine::getSection(int pos, int len) const
 {
-    QFile in(":/embedded_files/gn_help.md");
-    if( !in.open(QIODevice::ReadOnly ) )
-        Q_ASSERT( false );
-    in.seek(pos);
-    return in.read(len);
+    return d_file.mid(pos, len);
 }
 
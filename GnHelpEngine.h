@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <QHash>
+#include <QCache>
 
 namespace Gn
 {
@@ -43,12 +44,15 @@ namespace Gn
         QString getHelpFrom( const QByteArray& name );
 
     protected:
+        void loadIndex();
         void parseFile();
         static QString formatMd(const QByteArray& str , int kind = 0);
-        static QByteArray getSection( int pos, int len );
+        QByteArray getSection( int pos, int len ) const;
     private:
         typedef QHash<QByteArray,SectionList> Sections;
         Sections d_sections;
+        QByteArray d_file; // gn_help.md, read once
+        QCache<QByteArray,QString> d_html; // rendered help per name, least recently used dropped first
     };
 }
 
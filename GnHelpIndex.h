@@ -0,0 +1,174 @@
+#ifndef GNHELPINDEX_H
+#define GNHELPINDEX_H
+// This file was automatically generated by embedded_files/run_helpgen from gn_help.md; don't modify it!
+
+// Section index of embedded_files/gn_help.md, sorted by name; sections with the same name
+// keep their order in the file.
+
+namespace Gn
+{
+    struct HelpIndexEntry
+    {
+        const char* d_name;
+        unsigned d_pos;
+        unsigned d_len;
+        unsigned char d_kind;
+    };
+
+    static const char* s_helpFileMd5 = "7e99b9344e8ebffd025cb052c3182fb3";
+
+    static const HelpIndexEntry s_helpIndex[] =
+    {
+        { "action", 46783, 3174, 1 },
+        { "action_foreach", 49957, 3374, 1 },
+        { "aliased_deps", 156747, 982, 2 },
+        { "all_dependent_configs", 157729, 1542, 2 },
+        { "allow_circular_includes_from", 159271, 2852, 2 },
+        { "analyze", 12937, 3284, 3 },
+        { "arflags", 162123, 1499, 2 },
+        { "args", 16221, 2889, 3 },
+        { "args", 163622, 359, 2 },
+        { "asmflags", 163981, 966, 2 },
+        { "assert", 75650, 407, 1 },
+        { "assert_no_deps", 164947, 1592, 2 },
+        { "buildargs", 230314, 2452, 0 },
+        { "bundle_contents_dir", 166539, 456, 2 },
+        { "bundle_data", 53331, 1688, 1 },
+        { "bundle_deps_filter", 166995, 990, 2 },
+        { "bundle_executable_dir", 167985, 485, 2 },
+        { "bundle_resources_dir", 168470, 479, 2 },
+        { "bundle_root_dir", 168949, 811, 2 },
+        { "cflags", 169760, 1270, 2 },
+        { "cflags_c", 171030, 1272, 2 },
+        { "cflags_cc", 172302, 1273, 2 },
+        { "cflags_objc", 173575, 1275, 2 },
+        { "cflags_objcc", 174850, 1276, 2 },
+        { "check", 19110, 4662, 3 },
+        { "check_includes", 176126, 983, 2 },
+        { "clean", 23772, 208, 3 },
+        { "code_signing_args", 177109, 383, 2 },
+        { "code_signing_outputs", 177492, 273, 2 },
+        { "code_signing_script", 177765, 282, 2 },
+        { "code_signing_sources", 178047, 322, 2 },
+        { "complete_static_lib", 178369, 1550, 2 },
+        { "config", 76057, 2483, 1 },
+        { "configs", 179919, 3580, 2 },
+        { "contents", 183499, 169, 2 },
+        { "copy", 55019, 1370, 1 },
+        { "crate_name", 183668, 313, 2 },
+        { "crate_root", 183981, 518, 2 },
+        { "crate_type", 184499, 947, 2 },
+        { "create_bundle", 56389, 5782, 1 },
+        { "current_cpu", 145417, 596, 2 },
+        { "current_os", 146013, 590, 2 },
+        { "current_toolchain", 146603, 406, 2 },
+        { "data", 185446, 1384, 2 },
+        { "data_deps", 186830, 690, 2 },
+        { "data_keys", 187520, 294, 2 },
+        { "declare_args", 78540, 2353, 1 },
+        { "default_toolchain", 147009, 249, 2 },
+        { "defined", 80893, 1013, 1 },
+        { "defines", 187814, 1067, 2 },
+        { "depfile", 188881, 1557, 2 },
+        { "deps", 190438, 1224, 2 },
+        { "desc", 23980, 4905, 3 },
+        { "dotfile", 232766, 4073, 0 },
+        { "edition", 191662, 432, 2 },
+        { "exec_script", 81906, 2012, 1 },
+        { "executable", 62171, 1001, 1 },
+        { "execution", 236839, 3374, 0 },
+        { "foreach", 83918, 930, 1 },
+        { "format", 28885, 1294, 3 },
+        { "forward_variables_from", 84848, 3259, 1 },
+        { "friend", 192094, 2180, 2 },
+        { "gen", 30179, 5065, 3 },
+        { "generated_file", 63172, 3622, 1 },
+        { "get_label_info", 88107, 2217, 1 },
+        { "get_path_info", 90324, 2787, 1 },
+        { "get_target_outputs", 93111, 2205, 1 },
+        { "getenv", 95316, 604, 1 },
+        { "grammar", 240213, 7693, 0 },
+        { "group", 66794, 523, 1 },
+        { "help", 35244, 403, 3 },
+        { "host_cpu", 147258, 573, 2 },
+        { "host_os", 147831, 388, 2 },
+        { "import", 95920, 1390, 1 },
+        { "include_dirs", 194274, 1080, 2 },
+        { "inputs", 195354, 2935, 2 },
+        { "invoker", 148219, 873, 2 },
+        { "io_conversion", 247906, 3768, 0 },
+        { "label_pattern", 251674, 1243, 0 },
+        { "labels", 252917, 1947, 0 },
+        { "ldflags", 198289, 1304, 2 },
+        { "lib_dirs", 199593, 1620, 2 },
+        { "libs", 201213, 2768, 2 },
+        { "loadable_module", 67317, 1417, 1 },
+        { "ls", 35647, 2467, 3 },
+        { "meta", 38114, 2318, 3 },
+        { "metadata", 203981, 883, 2 },
+        { "ninja_rules", 254864, 2091, 0 },
+        { "nogncheck", 256955, 1298, 0 },
+        { "not_needed", 97310, 694, 1 },
+        { "output_conversion", 204864, 215, 2 },
+        { "output_dir", 205079, 1025, 2 },
+        { "output_extension", 206104, 1106, 2 },
+        { "output_name", 207210, 990, 2 },
+        { "output_prefix_override", 208200, 740, 2 },
+        { "outputs", 208940, 1045, 2 },
+        { "partial_info_plist", 209985, 478, 2 },
+        { "path", 40432, 1569, 3 },
+        { "pool", 98004, 1261, 1 },
+        { "pool", 210463, 315, 2 },
+        { "precompiled_header", 210778, 2594, 2 },
+        { "precompiled_header_type", 213372, 146, 2 },
+        { "precompiled_source", 213518, 316, 2 },
+        { "print", 99265, 558, 1 },
+        { "process_file_template", 99823, 1327, 1 },
+        { "product_type", 213834, 386, 2 },
+        { "public", 214220, 2367, 2 },
+        { "public_configs", 216587, 3609, 2 },
+        { "public_deps", 220196, 1662, 2 },
+        { "python_path", 149092, 266, 2 },
+        { "read_file", 101150, 492, 1 },
+        { "rebase", 221858, 649, 2 },
+        { "rebase_path", 101642, 3988, 1 },
+        { "refs", 42001, 4782, 3 },
+        { "response_file_contents", 222507, 1458, 2 },
+        { "root_build_dir", 149358, 380, 2 },
+        { "root_gen_dir", 149738, 700, 2 },
+        { "root_out_dir", 150438, 927, 2 },
+        { "runtime_deps", 258253, 3281, 0 },
+        { "rust_library", 68734, 1237, 1 },
+        { "script", 223965, 244, 2 },
+        { "set_default_toolchain", 105630, 1330, 1 },
+        { "set_defaults", 106960, 1275, 1 },
+        { "set_sources_assignment_filter", 108235, 2152, 1 },
+        { "shared_library", 69971, 1356, 1 },
+        { "source_expansion", 261534, 4776, 0 },
+        { "source_set", 71327, 2235, 1 },
+        { "sources", 224209, 1509, 2 },
+        { "split_list", 110387, 638, 1 },
+        { "static_library", 73562, 1242, 1 },
+        { "string_replace", 111025, 543, 1 },
+        { "switch_list", 266310, 1120, 0 },
+        { "target", 74804, 846, 1 },
+        { "target_cpu", 151365, 1086, 2 },
+        { "target_gen_dir", 152451, 857, 2 },
+        { "target_name", 153308, 1298, 2 },
+        { "target_os", 154606, 1317, 2 },
+        { "target_out_dir", 155923, 824, 2 },
+        { "template", 111568, 6476, 1 },
+        { "testonly", 225718, 493, 2 },
+        { "tool", 118044, 20431, 1 },
+        { "toolchain", 138475, 5996, 1 },
+        { "visibility", 226211, 1783, 2 },
+        { "walk_keys", 227994, 551, 2 },
+        { "write_file", 144471, 946, 1 },
+        { "write_runtime_deps", 228545, 889, 2 },
+        { "xcode_extra_attributes", 229434, 357, 2 },
+        { "xcode_test_application_name", 229791, 523, 2 },
+    };
+    static const int s_helpIndexCount = sizeof(s_helpIndex) / sizeof(HelpIndexEntry);
+}
+
+#endif // GNHELPINDEX_H
@@ -20,11 +20,19 @@
 #include "GnHighlighter.h"
 #include "GnLexer.h"
 #include "GnCodeModel.h"
+#include "GnSynTree.h"
+#include <QTextDocument>
 using namespace Gn;
 
+static const int s_margin = 20; // blocks highlighted in advance above and below the visible range
+
 Highlighter::Highlighter(CodeModel* mdl, QTextDocument* parent) :
-    QSyntaxHighlighter(parent),d_mdl(mdl)
+    QSyntaxHighlighter(parent),d_mdl(mdl),d_loadRevision(-1),d_generation(0),
+    d_firstVisible(0),d_lastVisible(0)
 {
+    d_lex = new Lexer(this);
+    d_lex->setIgnoreComments(false);
+    d_lex->setPackComments(false);
     Q_ASSERT( mdl != 0 );
     for( int i = 0; i < C_Max; i++ )
     {
@@ -51,104 +59,242 @@ QTextCharFormat Highlighter::formatForCategory(int c) const
     return d_format[c];
 }
 
-void Highlighter::highlightBlock(const QString& text)
+static void collectTerminals( const SynTree* st, QVector<const SynTree*>& res )
 {
-    const int previousBlockState_ = previousBlockState();
-    int lexerState = 0, initialBraceDepth = 0;
-    if (previousBlockState_ != -1) {
-        lexerState = previousBlockState_ & 0xff;
-        initialBraceDepth = previousBlockState_ >> 8;
-    }
+    if( st->d_tok.d_type < SynTree::R_First )
+    {
+        if( st->d_tok.d_type != Tok_Invalid && st->d_tok.d_len > 0 )
+            res.append(st);
+    }else
+        foreach( SynTree* sub, st->d_children )
+            collectTerminals( sub, res );
+}
 
-    int braceDepth = initialBraceDepth;
+void Highlighter::setSourcePath(const QByteArray& path)
+{
+    d_terms.clear();
+    d_lineStart.clear();
+    d_loadRevision = -1;
+    d_generation++;
+    CodeModel::Scope* s = path.isEmpty() ? 0 : d_mdl->getScope(path);
+    if( s == 0 || s->d_st == 0 )
+        return;
+    collectTerminals( s->d_st, d_terms );
+    if( d_terms.isEmpty() )
+        return;
+    const int lines = d_terms.last()->d_tok.d_lineNr + 2;
+    d_lineStart.resize( lines );
+    int t = 0;
+    for( int l = 0; l < lines; l++ )
+    {
+        while( t < d_terms.size() && int(d_terms[t]->d_tok.d_lineNr) < l )
+            t++;
+        d_lineStart[l] = t;
+    }
+}
 
+void Highlighter::setVisibleRange(int firstBlock, int lastBlock)
+{
+    d_firstVisible = firstBlock;
+    d_lastVisible = lastBlock;
+    QTextDocument* doc = document();
+    if( doc == 0 )
+        return;
+    QTextBlock b = doc->findBlockByNumber( qMax( 0, firstBlock - s_margin ) );
+    const int last = lastBlock + s_margin;
+    while( b.isValid() && b.blockNumber() <= last )
+    {
+        BlockData* data = static_cast<BlockData*>( b.userData() );
+        if( data == 0 || data->d_deferred )
+            rehighlightBlock(b);
+        b = b.next();
+    }
+}
 
-    int start = 0;
-    if( lexerState > 0 )
+int Highlighter::toCharPos(const QString& line, int bytePos)
+{
+    int bytes = 0;
+    int i = 0;
+    for( ; i < line.size() && bytes < bytePos; i++ )
     {
-        // wir sind in einem Multi Line Comment
-        // suche das Ende
-        QTextCharFormat f = formatForCategory(C_Cmt);
-        f.setProperty( TokenProp, int(Tok_Comment) );
-        int pos = 0;
-        //Lexer::parseComment( text.toLatin1(), pos, lexerState );
-        if( lexerState > 0 )
+        const ushort c = line[i].unicode();
+        if( c < 0x80 )
+            bytes += 1;
+        else if( c < 0x800 )
+            bytes += 2;
+        else if( QChar::isHighSurrogate(c) && i + 1 < line.size() )
         {
-            // the whole block ist part of the comment
-            setFormat( start, text.size(), f );
-            setCurrentBlockState( (braceDepth << 8) | lexerState);
-            return;
+            bytes += 4;
+            i++;
         }else
+            bytes += 3;
+    }
+    return i + ( bytePos - bytes > 0 ? bytePos - bytes : 0 ); // positions beyond the line stay beyond
+}
+
+int Highlighter::toBytePos(const QString& line, int charPos)
+{
+    int bytes = 0;
+    for( int i = 0; i < charPos; i++ )
+    {
+        if( i >= line.size() )
         {
-            // End of Comment found
-            setFormat( start, pos , f );
-            lexerState = 0;
-            braceDepth--;
-            start = pos;
+            bytes += charPos - i;
+            break;
         }
+        const ushort c = line[i].unicode();
+        if( c < 0x80 )
+            bytes += 1;
+        else if( c < 0x800 )
+            bytes += 2;
+        else if( QChar::isHighSurrogate(c) && i + 1 < line.size() )
+        {
+            bytes += 4;
+            i++;
+        }else
+            bytes += 3;
     }
+    return bytes;
+}
 
+bool Highlighter::isNearVisible(int block) const
+{
+    return block >= d_firstVisible - s_margin && block <= d_lastVisible + s_margin;
+}
 
-    Gn::Lexer lex;
-    lex.setIgnoreComments(false);
-    lex.setPackComments(false);
+bool Highlighter::modelBlock(int line, const QByteArray& text, Highlighter::Spans& spans)
+{
+    if( d_lineStart.isEmpty() )
+        return false;
+    if( d_loadRevision == -1 )
+        d_loadRevision = document()->revision(); // first call happens when the text is set
+    else if( document()->revision() != d_loadRevision )
+    {
+        // edited; from now on only the changed blocks are lexed again
+        d_terms.clear();
+        d_lineStart.clear();
+        return false;
+    }
+    const int first = line < d_lineStart.size() ? d_lineStart[line] : d_terms.size();
+    const int last = line + 1 < d_lineStart.size() ? d_lineStart[line+1] : d_terms.size();
 
-    QList<Token> tokens =  lex.tokens(text.mid(start));
-    for( int i = 0; i < tokens.size(); ++i )
+    // text is the UTF-8 encoded line, so the byte columns of the model apply directly
+    int pos = 0;
+    int cmt = text.indexOf( '#' );
+    for( int i = first; i < last; i++ )
     {
-        Token &t = tokens[i];
-        t.d_colNr += start;
-
-        QTextCharFormat f;
-        if( t.d_type == Tok_Comment )
-            f = formatForCategory(C_Cmt); // one line comment
-        else if( t.d_type == Tok_string )
-            f = formatForCategory(C_Str);
-        else if( t.d_type == Tok_integer )
-            f = formatForCategory(C_Num);
-        else if( tokenTypeIsLiteral(t.d_type) )
-        {
-            f = formatForCategory(C_Op);
-        }else if( tokenTypeIsKeyword(t.d_type) )
+        const Token& t = d_terms[i]->d_tok;
+        const int col = t.d_colNr - 1;
+        if( col < pos || col + t.d_len > text.size() )
         {
-            f = formatForCategory(C_Kw);
-        }else if( t.d_type == Tok_identifier )
+            spans.clear();
+            return false;
+        }
+        if( cmt != -1 && cmt < pos )
+            cmt = text.indexOf( '#', pos ); // the previous one was part of a string
+        if( cmt != -1 && cmt < col )
+            break; // the rest of the line is a comment
+        addToken( t, spans );
+        pos = col + t.d_len;
+    }
+    if( cmt != -1 && cmt < pos )
+        cmt = text.indexOf( '#', pos );
+    if( cmt != -1 )
+        spans.append( Span( cmt, text.size() - cmt, C_Cmt ) );
+    return true;
+}
+
+void Highlighter::lexBlock(const QByteArray& text, Highlighter::Spans& spans)
+{
+    const QList<Token> tokens = d_lex->tokens(text);
+    foreach( const Token& t, tokens )
+        addToken( t, spans );
+}
+
+void Highlighter::addToken(const Token& t, Highlighter::Spans& spans)
+{
+    int cat = -1;
+    if( t.d_type == Tok_Comment )
+        cat = C_Cmt; // one line comment
+    else if( t.d_type == Tok_string )
+        cat = C_Str;
+    else if( t.d_type == Tok_integer )
+        cat = C_Num;
+    else if( tokenTypeIsLiteral(t.d_type) )
+        cat = C_Op;
+    else if( tokenTypeIsKeyword(t.d_type) )
+        cat = C_Kw;
+    else if( t.d_type == Tok_identifier )
+        cat = d_mdl->isKnownId(t.d_val) ? C_Known : C_Ident;
+    if( cat < 0 )
+        return;
+
+    spans.append( Span( t.d_colNr - 1, t.d_len, cat ) );
+    if( t.d_type == Tok_string )
+    {
+        CodeModel::Dollars dd = CodeModel::findDollars( t.d_val );
+        foreach( CodeModel::Dollar d, dd )
         {
-            if( d_mdl->isKnownId(t.d_val) )
-                f = formatForCategory(C_Known);
+            d.d_pos++;
+            d.d_len--;
+            if( t.d_val[d.d_pos] == '{' )
+            {
+                d.d_pos++;
+                d.d_len -= 2;
+            }else if( t.d_val[d.d_pos] == '0' )
+                continue;
+            // TODO: anscheinend ist auch ScopeAccess zulässig!
+            if( d_mdl->isKnownObj( Lexer::getSymbol(t.d_val.mid(d.d_pos, d.d_len ) ) ) )
+                cat = C_Known;
             else
-                f = formatForCategory(C_Ident);
+                cat = C_Ident;
+            spans.append( Span( t.d_colNr + d.d_pos - 1, d.d_len, cat ) );
         }
+    }
+}
 
-        if( f.isValid() )
+void Highlighter::highlightBlock(const QString& text)
+{
+    // formats are cached per block and only recomputed if the block was edited
+    BlockData* data = static_cast<BlockData*>( currentBlockUserData() );
+    if( data == 0 )
+    {
+        data = new BlockData();
+        setCurrentBlockUserData(data);
+    }
+    const int nr = currentBlock().blockNumber();
+    if( !isNearVisible(nr) )
+    {
+        // loading a large file must not lex or format every block; setVisibleRange catches up
+        data->d_deferred = true;
+        setCurrentBlockState( 0 );
+        return;
+    }
+    data->d_deferred = false;
+    const int rev = currentBlock().revision();
+    const QByteArray bytes = text.toUtf8();
+    if( data->d_revision != rev || data->d_generation != d_generation )
+    {
+        data->d_spans.clear();
+        if( !modelBlock( nr + 1, bytes, data->d_spans ) )
+            lexBlock( bytes, data->d_spans );
+        data->d_revision = rev;
+        data->d_generation = d_generation;
+    }
+
+    const bool ascii = bytes.size() == text.size();
+    foreach( const Span& s, data->d_spans )
+    {
+        if( ascii )
+            setFormat( s.d_pos, s.d_len, d_format[s.d_cat] );
+        else
         {
-            setFormat( t.d_colNr-1, t.d_len, f );
-            if( t.d_type == Tok_string )
-            {
-                CodeModel::Dollars dd = CodeModel::findDollars( t.d_val );
-                foreach( CodeModel::Dollar d, dd )
-                {
-                    d.d_pos++;
-                    d.d_len--;
-                    if( t.d_val[d.d_pos] == '{' )
-                    {
-                        d.d_pos++;
-                        d.d_len -= 2;
-                    }else if( t.d_val[d.d_pos] == '0' )
-                        continue;
-                    // TODO: anscheinend ist auch ScopeAccess zulässig!
-                    if( d_mdl->isKnownObj( Lexer::getSymbol(t.d_val.mid(d.d_pos, d.d_len ) ) ) )
-                        f = formatForCategory(C_Known);
-                    else
-                        f = formatForCategory(C_Ident);
-                    //f = formatForCategory(C_Dollar);
-                    setFormat( t.d_colNr + d.d_pos - 1, d.d_len, f );
-                }
-            }
+            const int pos = toCharPos( text, s.d_pos );
+            setFormat( pos, toCharPos( text, s.d_pos + s.d_len ) - pos, d_format[s.d_cat] );
         }
     }
 
-    setCurrentBlockState((braceDepth << 8) | lexerState );
+    setCurrentBlockState( 0 ); // no multi line constructs in GN
 }
 
 
@@ -22,10 +22,14 @@
 
 #include <QSyntaxHighlighter>
 #include <QSet>
+#include <QVector>
 
 namespace Gn
 {
     class CodeModel;
+    class Lexer;
+    class SynTree;
+    struct Token;
 
     class Highlighter : public QSyntaxHighlighter
     {
@@ -33,9 +37,43 @@ namespace Gn
         enum { TokenProp = QTextFormat::UserProperty };
         explicit Highlighter(CodeModel*, QTextDocument *parent = 0);
 
+        // Call before the text is loaded; as long as the document isn't edited the tokens
+        // of the file parsed by the model are used instead of lexing each block again.
+        void setSourcePath( const QByteArray& );
+
+        // Only blocks within the range (plus a margin) are highlighted, the others are deferred
+        // until the range reaches them; call with the visible blocks whenever the view scrolls.
+        void setVisibleRange( int firstBlock, int lastBlock );
+
+        // Model columns count UTF-8 bytes, the document counts UTF-16 characters.
+        static int toCharPos( const QString& line, int bytePos );
+        static int toBytePos( const QString& line, int charPos );
+
     protected:
         QTextCharFormat formatForCategory(int) const;
 
+        struct Span
+        {
+            quint16 d_pos;
+            quint16 d_len;
+            quint8 d_cat;
+            Span(quint16 pos = 0, quint16 len = 0, quint8 cat = 0):d_pos(pos),d_len(len),d_cat(cat){}
+        };
+        typedef QVector<Span> Spans;
+        class BlockData : public QTextBlockUserData
+        {
+        public:
+            BlockData():d_revision(-1),d_generation(0),d_deferred(false){}
+            int d_revision;     // QTextBlock::revision the spans were computed for
+            quint32 d_generation;
+            bool d_deferred;    // highlighting was skipped because the block wasn't near the visible range
+            Spans d_spans;
+        };
+        bool isNearVisible( int block ) const;
+        bool modelBlock( int line, const QByteArray& text, Spans& );
+        void lexBlock( const QByteArray& text, Spans& );
+        void addToken( const Token&, Spans& );
+
         // overrides
         void highlightBlock(const QString &text);
 
@@ -43,6 +81,12 @@ namespace Gn
         enum Category { C_Num, C_Str, C_Kw, C_Known, C_Ident, C_Op, C_Cmt, C_Dollar, C_Max };
         QTextCharFormat d_format[C_Max];
         CodeModel* d_mdl;
+        Lexer* d_lex;
+        QVector<const SynTree*> d_terms; // terminals of the parsed file in source order
+        QVector<int> d_lineStart; // index of first terminal in d_terms per line number
+        int d_loadRevision; // document revision the model tokens are valid for
+        quint32 d_generation; // invalidates all BlockData when a new file is loaded
+        int d_firstVisible, d_lastVisible;
     };
 
     class LogPainter : public QSyntaxHighlighter
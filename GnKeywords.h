@@ -0,0 +1,33 @@
+#ifndef __GN_KEYWORDS__
+#define __GN_KEYWORDS__
+// This file was automatically generated by syntax/run_kwgen from gn.keywords; don't modify it!
+
+#include <GnTools/GnTokenType.h>
+
+#ifndef Q_DECL_RELAXED_CONSTEXPR
+#define Q_DECL_RELAXED_CONSTEXPR
+#endif
+
+namespace Gn {
+	// Returns the keyword token type of str[0..len) or Tok_Invalid
+	inline Q_DECL_RELAXED_CONSTEXPR TokenType keywordFromString( const char* str, int len ) {
+		switch( len ) {
+		case 2:
+			if( str[0] == 'i' && str[1] == 'f' )
+				return Tok_if;
+			break;
+		case 4:
+			if( str[0] == 'e' && str[1] == 'l' && str[2] == 's' && str[3] == 'e' )
+				return Tok_else;
+			if( str[0] == 't' && str[1] == 'r' && str[2] == 'u' && str[3] == 'e' )
+				return Tok_true;
+			break;
+		case 5:
+			if( str[0] == 'f' && str[1] == 'a' && str[2] == 'l' && str[3] == 's' && str[4] == 'e' )
+				return Tok_false;
+			break;
+		}
+		return Tok_Invalid;
+	}
+}
+#endif // __GN_KEYWORDS__
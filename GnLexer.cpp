@@ -20,15 +20,19 @@
 #include "GnLexer.h"
 #include "GnErrors.h"
 #include "GnFileCache.h"
+#include "GnKeywords.h"
 #include <QBuffer>
 #include <QFile>
 #include <QIODevice>
+#include <QMutex>
 using namespace Gn;
 
-QHash<QByteArray,QByteArray> Lexer::d_symbols;
+Lexer::Symbols Lexer::d_symbols;
+static QMutex s_symbolLock; // files are lexed in parallel, e.g. by the Formatter
 
 Lexer::Lexer(QObject *parent) : QObject(parent),
-    d_lastToken(Tok_Invalid),d_lineNr(0),d_colNr(0),d_in(0),d_err(0),d_fcache(0),
+    d_lastToken(Tok_Invalid),d_lineNr(0),d_colNr(0),d_in(0),d_err(0),d_fcache(0),d_bufHead(0),d_bufCount(0),
+    d_lineOff(0),d_lineLen(0),
     d_ignoreComments(true), d_packComments(true),d_real("\\d*\\.?\\d+(e[-+]?\\d+)?")
 {
 
@@ -43,8 +47,13 @@ void Lexer::setStream(QIODevice* in, const QString& sourcePath)
         d_in = in;
         d_lineNr = 0;
         d_colNr = 0;
+        d_lineOff = 0;
+        d_lineLen = 0;
+        d_line.clear();
         d_sourcePath = getSymbol(sourcePath.toUtf8());
         d_lastToken = Tok_Invalid;
+        d_bufHead = 0;
+        d_bufCount = 0;
     }
 }
 
@@ -54,9 +63,9 @@ bool Lexer::setStream(const QString& sourcePath)
 
     if( d_fcache )
     {
-        bool found;
-        QByteArray content = d_fcache->getFile(sourcePath, &found );
-        if( found )
+        bool ok;
+        const QByteArray content = d_fcache->readFile(sourcePath, &ok );
+        if( ok )
         {
             QBuffer* buf = new QBuffer(this);
             buf->setData( content );
@@ -88,10 +97,11 @@ bool Lexer::setStream(const QString& sourcePath)
 Token Lexer::nextToken()
 {
     Token t;
-    if( !d_buffer.isEmpty() )
+    if( d_bufCount > 0 )
     {
-        t = d_buffer.first();
-        d_buffer.pop_front();
+        t = qMove( d_buffer[d_bufHead] );
+        d_bufHead = ( d_bufHead + 1 ) % MaxLookAhead;
+        d_bufCount--;
     }else
         t = nextTokenImp();
     if( t.d_type == Tok_Comment && d_ignoreComments )
@@ -99,12 +109,20 @@ Token Lexer::nextToken()
     return t;
 }
 
-Token Lexer::peekToken(quint8 lookAhead)
+const Token& Lexer::peekToken(quint8 lookAhead)
 {
-    Q_ASSERT( lookAhead > 0 );
-    while( d_buffer.size() < lookAhead )
-        d_buffer.push_back( nextTokenImp() );
-    return d_buffer[ lookAhead - 1 ];
+    Q_ASSERT( lookAhead > 0 && lookAhead <= MaxLookAhead );
+    // the buffer only holds MaxLookAhead tokens; a release build gets the nearest one instead of garbage
+    if( lookAhead == 0 )
+        lookAhead = 1;
+    else if( lookAhead > MaxLookAhead )
+        lookAhead = MaxLookAhead;
+    while( d_bufCount < lookAhead )
+    {
+        d_buffer[ ( d_bufHead + d_bufCount ) % MaxLookAhead ] = nextTokenImp();
+        d_bufCount++;
+    }
+    return d_buffer[ ( d_bufHead + lookAhead - 1 ) % MaxLookAhead ];
 }
 
 QList<Token> Lexer::tokens(const QString& code)
@@ -133,14 +151,18 @@ QByteArray Lexer::getSymbol(const QByteArray& str)
 {
     if( str.isEmpty() )
         return str;
-    QByteArray& sym = d_symbols[str];
-    if( sym.isEmpty() )
-        sym = str;
+    QMutexLocker lock(&s_symbolLock);
+    Symbols::const_iterator i = d_symbols.constFind(str);
+    if( i != d_symbols.constEnd() )
+        return i.value();
+    const QByteArray sym( str.constData(), str.size() ); // deep copy since str could be raw data of d_line
+    d_symbols.insert(sym,sym);
     return sym;
 }
 
 void Lexer::clearSymbols()
 {
+    QMutexLocker lock(&s_symbolLock);
     d_symbols.clear();
 }
 
@@ -202,7 +224,8 @@ Token Lexer::nextTokenImp()
             return token( Tok_Invalid, 1, QString("unexpected character '%1' %2").arg(char(ch)).arg(int(ch)).toUtf8() );
         else {
             const int len = pos - d_colNr;
-            return token( tt, len, d_line.mid(d_colNr,len) );
+            // the static token string serves as value, so no copy from d_line is needed
+            return token( tt, len, QByteArray::fromRawData( tokenTypeString(tt), len ) );
         }
     }
     Q_ASSERT(false);
@@ -221,7 +244,9 @@ void Lexer::nextLine()
 {
     d_colNr = 0;
     d_lineNr++;
+    d_lineOff += d_lineLen;
     d_line = d_in->readLine();
+    d_lineLen = d_line.size();
 
     if( d_line.endsWith("\r\n") )
         d_line.chop(2);
@@ -240,15 +265,13 @@ int Lexer::lookAhead(int off) const
 
 Token Lexer::token(TokenType tt, int len, const QByteArray& val)
 {
-    QByteArray v = val;
-    if( tt == Tok_identifier )
-        v = getSymbol(v);
-    Token t( tt, d_lineNr, d_colNr + 1, len, v );
+    Token t( tt, d_lineNr, d_colNr + 1, len, val );
+    t.d_offset = d_lineOff + d_colNr;
     d_lastToken = t;
     d_colNr += len;
     t.d_sourcePath = d_sourcePath; // sourcePath is symbol too
     if( tt == Tok_Invalid && d_err != 0 )
-        d_err->error(Errors::Syntax, t.d_sourcePath, t.d_lineNr, t.d_colNr, t.d_val );
+        d_err->error(Errors::Syntax, t.d_sourcePath, t.d_lineNr, t.d_colNr, Errors::Msg("%1", t.d_val) );
     return t;
 }
 
@@ -273,18 +296,13 @@ Token Lexer::ident()
         else
             off++;
     }
-    const QByteArray str = d_line.mid(d_colNr, off );
-    Q_ASSERT( !str.isEmpty() );
-
-    int pos = 0;
-    TokenType t = tokenTypeFromString( str, &pos );
-    if( t != Tok_Invalid && pos != str.size() )
-        t = Tok_Invalid;
+    const char* str = d_line.constData() + d_colNr;
 
+    const TokenType t = keywordFromString( str, off );
     if( t != Tok_Invalid )
         return token( t, off );
     else
-        return token( Tok_identifier, off, str );
+        return token( Tok_identifier, off, getSymbol( QByteArray::fromRawData( str, off ) ) );
 }
 
 Token Lexer::number()
@@ -44,8 +44,9 @@ namespace Gn
         void setIgnoreComments( bool b ) { d_ignoreComments = b; }
         void setPackComments( bool b ) { d_packComments = b; }
 
+        enum { MaxLookAhead = 4 };
         Token nextToken();
-        Token peekToken(quint8 lookAhead = 1);
+        const Token& peekToken(quint8 lookAhead = 1); // 1..MaxLookAhead, clamped otherwise
         QList<Token> tokens( const QString& code );
         QList<Token> tokens( const QByteArray& code, const QString& path = QString() );
         static QByteArray getSymbol( const QByteArray& );
@@ -68,10 +69,13 @@ namespace Gn
         QRegExp d_real;
         quint32 d_lineNr;
         quint16 d_colNr;
+        quint32 d_lineOff, d_lineLen; // offset of d_line in stream, length of d_line before chop
         QByteArray d_sourcePath;
         QByteArray d_line;
-        QList<Token> d_buffer;
-        static QHash<QByteArray,QByteArray> d_symbols;
+        Token d_buffer[MaxLookAhead]; // ring buffer of peeked tokens
+        quint8 d_bufHead, d_bufCount;
+        typedef QHash<QByteArray,QByteArray> Symbols;
+        static Symbols d_symbols;
         Token d_lastToken;
         bool d_ignoreComments;  // don't deliver comment tokens
         bool d_packComments;    // Only deliver one Tok_Comment for /**/ instead of Tok_Lcmt and Tok_Rcmt
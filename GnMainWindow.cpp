@@ -24,11 +24,16 @@
 #include "GnHighlighter.h"
 #include "GnLexer.h"
 #include "GnHelpEngine.h"
+#include "GnXrefMdl.h"
+#include "GnGotoDialog.h"
+#include "GnEvaluator.h"
+#include "GnErrors.h"
 #include <QDockWidget>
 #include <QFile>
 #include <QPainter>
 #include <QPlainTextEdit>
 #include <QTreeWidget>
+#include <QTreeView>
 #include <QtDebug>
 #include <QApplication>
 #include <QSettings>
@@ -45,6 +50,12 @@
 #include <QDialogButtonBox>
 #include <QComboBox>
 #include <QTextBrowser>
+#include <QTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QRegularExpression>
 using namespace Gn;
 
 Q_DECLARE_METATYPE(Gn::SynTree*)
@@ -91,7 +102,9 @@ void messageHander(QtMsgType type, const QMessageLogContext& ctx, const QString&
 	report(type,message);
 }
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),d_curFileItem(0),
+    d_xrefGen(0),d_xrefPending(0),d_xrefShown(0),d_xrefRes(0),d_evalGen(0),d_evalRes(0),d_evalRunning(0),
+    d_refreshing(false),d_refreshRes(0)
 {
     s_this = this;
 
@@ -127,6 +140,18 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     createLog();
     createHelp();
     createQueryList();
+    createSearch();
+
+    d_xrefPool = new QThreadPool(this);
+    d_xrefPool->setMaxThreadCount(1); // superseded tasks quit early, so one worker is enough
+    d_xrefTimer = new QTimer(this);
+    d_xrefTimer->setSingleShot(true);
+    d_xrefTimer->setInterval(150);
+    connect( d_xrefTimer, SIGNAL(timeout()), this, SLOT(onXrefTimeout()) );
+    d_evalPool = new QThreadPool(this);
+    d_evalPool->setMaxThreadCount(1);
+    d_refreshPool = new QThreadPool(this);
+    d_refreshPool->setMaxThreadCount(1);
 
     connect( d_codeView, SIGNAL( cursorPositionChanged() ), this, SLOT(  onCursorPositionChanged() ) );
     connect( d_codeView, SIGNAL(sigShowFile(QByteArray)), this, SLOT(onFileChanged(QByteArray)) );
@@ -136,7 +161,10 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
     new QShortcut(tr("CTRL+Q"),this,SLOT(close()) );
     new QShortcut(tr("CTRL+L"),this,SLOT(onGotoLine()) );
     new QShortcut(tr("CTRL+SHIFT+L"),this,SLOT(onGotoFileLine()) );
+    new QShortcut(tr("CTRL+P"),this,SLOT(onGotoAnything()) );
+    new QShortcut(tr("CTRL+E"),this,SLOT(onSetArgs()) );
     new QShortcut(tr("CTRL+F"),this,SLOT(onFindInFile()) );
+    new QShortcut(tr("CTRL+SHIFT+F"),this,SLOT(onSearchAll()) );
     new QShortcut(tr("CTRL+G"),this,SLOT(onFindAgain()) );
     new QShortcut(tr("F3"),this,SLOT(onFindAgain()) );
     new QShortcut(tr("F1"),this,SLOT(onHelp()) );
@@ -160,21 +188,48 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 
     if( d_helpView->parentWidget()->isVisible() )
         d_helpView->setText(tr("Press <F1> for help"));
+
+    d_evalArgs = s.value( "EvalArgs" ).toByteArray();
+}
+
+MainWindow::~MainWindow()
+{
+    cancelXref();
+    d_xrefPool->waitForDone();
+    delete d_xrefRes;
+    cancelEvaluation();
+    d_evalPool->waitForDone();
+    delete d_evalRes;
+    d_refreshPool->waitForDone();
+    delete d_refreshRes;
 }
 
 void MainWindow::showPath(const QString& path)
 {
+    // the running xref task reads the model, so it has to finish before the model is rebuilt
+    d_xrefTimer->stop();
+    cancelXref();
+    d_xrefPool->waitForDone();
+    d_xrefPending = 0;
+    d_xrefShown = 0;
+    // the running evaluation stops after the file it is currently running
+    cancelEvaluation();
+    d_evalPool->waitForDone();
+
     d_msgLog->clear();
     d_fileList->clear();
+    d_fileItems.clear();
+    d_curFileItem = 0;
     d_rootDir->clear();
     d_mdl->parseDir(path);
     d_stm->setScope(0);
-    d_xrefList->clear();
+    d_xrefMdl->clear();
     d_codeView->clear();
     d_sourceLoc->clear();
     d_xrefSearch->clear();
     d_queries->setCurrentIndex(0);
     d_queryResults->clear();
+    d_searchResults->clear();
 
     d_rootDir->setText( d_mdl->getSourceRoot().absolutePath() );
 
@@ -185,6 +240,7 @@ void MainWindow::showPath(const QString& path)
         item->setText( 0, d_mdl->getSourceRoot().relativeFilePath( QString::fromUtf8(file) ) );
         item->setToolTip(0,item->text(0));
         item->setData( 0, Qt::UserRole, file );
+        d_fileItems.insert( file, item );
     }
     setWindowTitle( tr("%3 - %1 v%2").arg( qApp->applicationName() ).arg( qApp->applicationVersion() )
                     .arg( d_rootDir->text() ));
@@ -194,6 +250,7 @@ void MainWindow::showPath(const QString& path)
         if( sc != 0 )
             d_codeView->setCursorPosition( sc->d_st, true, true );
     }
+    startEvaluation();
 }
 
 void MainWindow::showHelp()
@@ -246,7 +303,7 @@ void MainWindow::createScopeTree()
     d_defsList->setHeaderHidden(true);
     d_defsList->setSortingEnabled(false);
     d_defsList->setAllColumnsShowFocus(true);
-    d_defsList->setRootIsDecorated(false);
+    d_defsList->setRootIsDecorated(true); // nested scopes are fetched when expanded
     d_defsList->setExpandsOnDoubleClick(false);
     d_stm = new ScopeTreeMdl(d_defsList);
     d_defsList->setModel(d_stm);
@@ -267,16 +324,19 @@ void MainWindow::createXrefList()
     vbox->setSpacing(2);
     d_xrefSearch = new QLineEdit(pane);
     vbox->addWidget(d_xrefSearch);
-    d_xrefList = new QTreeWidget(pane);
+    d_xrefList = new QTreeView(pane);
     d_xrefList->setAlternatingRowColors(true);
     d_xrefList->setHeaderHidden(true);
     d_xrefList->setSortingEnabled(false);
     d_xrefList->setAllColumnsShowFocus(true);
     d_xrefList->setRootIsDecorated(false);
+    d_xrefList->setUniformRowHeights(true); // so only the visible rows are asked for
+    d_xrefMdl = new XrefMdl(d_mdl,d_xrefList);
+    d_xrefList->setModel(d_xrefMdl);
     vbox->addWidget(d_xrefList);
     dock->setWidget(pane);
     addDockWidget( Qt::RightDockWidgetArea, dock );
-    connect(d_xrefList, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)), this, SLOT(onXrefDblClicked()) );
+    connect(d_xrefList, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(onXrefDblClicked()) );
     connect(d_xrefSearch,SIGNAL(editingFinished()),this,SLOT(onXrefSearch()) );
 }
 
@@ -340,6 +400,40 @@ void MainWindow::createQueryList()
     connect(d_queries,SIGNAL(currentIndexChanged(int)),this,SLOT(onQuery(int)) );
 }
 
+void MainWindow::createSearch()
+{
+    QDockWidget* dock = new QDockWidget( tr("Search"), this );
+    dock->setObjectName("Search");
+    dock->setAllowedAreas( Qt::AllDockWidgetAreas );
+    dock->setFeatures( QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetClosable );
+    QWidget* pane = new QWidget(dock);
+    QVBoxLayout* vbox = new QVBoxLayout(pane);
+    vbox->setMargin(0);
+    vbox->setSpacing(2);
+    QHBoxLayout* hbox = new QHBoxLayout();
+    hbox->setMargin(0);
+    hbox->setSpacing(2);
+    d_searchText = new QLineEdit(pane);
+    hbox->addWidget(d_searchText);
+    d_searchCase = new QCheckBox(tr("Case"),pane);
+    hbox->addWidget(d_searchCase);
+    d_searchRegex = new QCheckBox(tr("Regex"),pane);
+    hbox->addWidget(d_searchRegex);
+    vbox->addLayout(hbox);
+    d_searchResults = new QTreeWidget(pane);
+    d_searchResults->setAlternatingRowColors(true);
+    d_searchResults->setHeaderHidden(true);
+    d_searchResults->setSortingEnabled(false);
+    d_searchResults->setAllColumnsShowFocus(true);
+    d_searchResults->setRootIsDecorated(false);
+    d_searchResults->setUniformRowHeights(true);
+    vbox->addWidget(d_searchResults);
+    dock->setWidget(pane);
+    addDockWidget( Qt::BottomDockWidgetArea, dock );
+    connect(d_searchResults, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)), this, SLOT(onSearchDblClicked()) );
+    connect(d_searchText,SIGNAL(returnPressed()),this,SLOT(onSearch()) );
+}
+
 static bool UsedByLessThan( const SynTree* lhs, const SynTree* rhs )
 {
     return lhs->d_tok.d_sourcePath < rhs->d_tok.d_sourcePath ||
@@ -363,127 +457,285 @@ void MainWindow::fillXrefList(const SynTree* id)
     fillXrefList(str, id);
 }
 
-void MainWindow::fillXrefList(const QByteArray& str, const SynTree* id )
+struct MainWindow::XrefResult
 {
-    d_xrefSearch->clear();
-    d_xrefList->clear();
+    int d_gen;
+    bool d_resolved; // str denoted something which could be looked up
+    QByteArray d_text;
+    XrefMdl::Hits d_hits;
+    QList<const SynTree*> d_nt; // refs in the current file, to be marked in the code view
+    XrefResult(int gen):d_gen(gen),d_resolved(false){}
+};
 
-    CodeModel::PathIdentPair pip = CodeModel::extractPathIdentFromString(str);
-    if( pip.first.isEmpty() && pip.second.isEmpty() )
-        return;
-    else if( pip.second.contains('$') )
-        return;
-    else if( !pip.second.isEmpty() )
-        pip.first = d_mdl->calcPath( pip.first, d_codeView->getSourcePath() ).toUtf8();
-    else
+namespace Gn
+{
+    class XrefTask : public QRunnable
     {
-        const QString path = d_mdl->calcPath( pip.first, d_codeView->getSourcePath() );
-        QFileInfo info(path);
-        if( info.exists() && !info.isDir() )
-            pip.first = path.toUtf8();
-        else if( !CodeModel::looksLikeFilePath(pip.first))
+    public:
+        XrefTask( MainWindow* w, const QByteArray& str, const SynTree* id, const QByteArray& curPath, int gen ):
+            d_win(w),d_str(str),d_id(id),d_curPath(curPath),d_gen(gen){}
+        void run()
         {
-            pip.second = pip.first;
-            pip.first.clear();
-        }else
-            return;
-    }
-
-//        if( !Lexer::isValidIdent(name) )
-//            return;
+            if( isStale() )
+                return;
+            MainWindow::XrefResult* res = new MainWindow::XrefResult(d_gen);
+            if( !lookup(res) )
+            {
+                delete res;
+                return;
+            }
+            QMutexLocker lock(&d_win->d_xrefLock);
+            if( isStale() )
+            {
+                delete res;
+                return;
+            }
+            delete d_win->d_xrefRes; // not picked up yet and superseded anyway
+            d_win->d_xrefRes = res;
+            QMetaObject::invokeMethod( d_win, "onXrefReady", Qt::QueuedConnection );
+        }
+    private:
+        bool isStale() const { return d_win->d_xrefGen.loadAcquire() != d_gen; }
+        bool lookup( MainWindow::XrefResult* res )
+        {
+            CodeModel* mdl = d_win->d_mdl;
+            CodeModel::PathIdentPair pip = CodeModel::extractPathIdentFromString(d_str);
+            if( pip.first.isEmpty() && pip.second.isEmpty() )
+                return true;
+            else if( pip.second.contains('$') )
+                return true;
+            else if( !pip.second.isEmpty() )
+                pip.first = mdl->calcPath( pip.first, d_curPath ).toUtf8();
+            else
+            {
+                const QString path = mdl->calcPath( pip.first, d_curPath );
+                QFileInfo info(path);
+                if( info.exists() && !info.isDir() )
+                    pip.first = path.toUtf8();
+                else if( !CodeModel::looksLikeFilePath(pip.first))
+                {
+                    pip.second = pip.first;
+                    pip.first.clear();
+                }else
+                    return true;
+            }
+            if( isStale() )
+                return false;
 
-    const QByteArray path = Lexer::getSymbol(pip.first);
-    const QByteArray name = Lexer::getSymbol(pip.second);
+            const QByteArray path = Lexer::getSymbol(pip.first);
+            const QByteArray name = Lexer::getSymbol(pip.second);
 
-    if( !name.isEmpty() )
-        d_xrefSearch->setText( QString::fromUtf8(name) );
-    else
-        d_xrefSearch->setText( QString::fromUtf8(str) );
+            res->d_resolved = true;
+            if( !name.isEmpty() )
+                res->d_text = name;
+            else
+                res->d_text = d_str;
 
-    QFont bold = d_xrefList->font();
-    bold.setBold(true);
+            if( d_id != 0 && d_id->d_tok.d_type == Tok_identifier && lookupFlow(res) )
+                return !isStale();
 
-    QList<const SynTree*> nt;
-    CodeModel::ObjRefs::const_iterator i1 = d_mdl->getAllObjDefs().find(name.constData());
-    if( i1 != d_mdl->getAllObjDefs().end() )
-    {
-        foreach( CodeModel::Scope* s, i1.value() )
-        {
-            QTreeWidgetItem* item = new QTreeWidgetItem(d_xrefList);
-            item->setText( 0, QString("Def: %1:%2:%3").arg(d_mdl->relativePath(s->d_st->d_tok.d_sourcePath))
-                                                          .arg(s->d_st->d_tok.d_lineNr).arg(s->d_st->d_tok.d_colNr) );
-            item->setToolTip( 0, item->text(0) );
-            item->setData( 0, Qt::UserRole, QVariant::fromValue(s->d_st) );
-            if( s->d_params == id )
-                item->setFont(0,bold);
-        }
-    }
-    CodeModel::VarRefs::const_iterator i2 = d_mdl->getAllFuncRefs().find(name.constData());
-    if( i2 != d_mdl->getAllFuncRefs().end() )
-    {
-        foreach( SynTree* s, i2.value() )
-        {
-            QTreeWidgetItem* item = new QTreeWidgetItem(d_xrefList);
-            item->setText( 0, QString("Ref: %1:%2:%3").arg(d_mdl->relativePath(s->d_tok.d_sourcePath))
-                                                          .arg(s->d_tok.d_lineNr).arg(s->d_tok.d_colNr) );
-            item->setToolTip( 0, item->text(0) );
-            item->setData( 0, Qt::UserRole, QVariant::fromValue(s) );
-            if( s == id )
-                item->setFont(0,bold);
-            else if( s->d_tok.d_sourcePath.constData() == d_codeView->getSourcePath().constData() )
-                nt.append(s);
-        }
-    }
-    i2 = d_mdl->getAllLhs().find(name.constData());
-    if( i2 != d_mdl->getAllLhs().end() )
-    {
-        foreach( SynTree* s, i2.value() )
-        {
-            QTreeWidgetItem* item = new QTreeWidgetItem(d_xrefList);
-            item->setText( 0, QString("Lhs: %1:%2:%3").arg(d_mdl->relativePath(s->d_tok.d_sourcePath))
-                                                          .arg(s->d_tok.d_lineNr).arg(s->d_tok.d_colNr) );
-            item->setToolTip( 0, item->text(0) );
-            item->setData( 0, Qt::UserRole, QVariant::fromValue(s) );
-            if( s == id )
-                item->setFont(0,bold);
-            else if( s->d_tok.d_sourcePath.constData() == d_codeView->getSourcePath().constData() )
-                nt.append(s);
+            CodeModel::ObjRefs::const_iterator i1 = mdl->getAllObjDefs().find(name.constData());
+            if( i1 != mdl->getAllObjDefs().end() )
+            {
+                foreach( CodeModel::Scope* s, i1.value() )
+                    res->d_hits.append( XrefMdl::Hit( s->d_st, XrefMdl::Def, s->d_params == d_id ) );
+            }
+            const char* curPath = d_curPath.constData();
+            struct { const CodeModel::VarRefs* d_refs; quint8 d_kind; } refs[] =
+            {
+                { &mdl->getAllFuncRefs(), XrefMdl::Ref },
+                { &mdl->getAllLhs(), XrefMdl::Lhs },
+                { &mdl->getAllRhs(), XrefMdl::Rhs },
+            };
+            for( int r = 0; r < 3; r++ )
+            {
+                if( isStale() )
+                    return false;
+                CodeModel::VarRefs::const_iterator i2 = refs[r].d_refs->find(name.constData());
+                if( i2 == refs[r].d_refs->end() )
+                    continue;
+                foreach( SynTree* s, i2.value() )
+                {
+                    res->d_hits.append( XrefMdl::Hit( s, refs[r].d_kind, s == d_id ) );
+                    if( s != d_id && s->d_tok.d_sourcePath.constData() == curPath )
+                        res->d_nt.append(s);
+                }
+            }
+            if( !path.isEmpty() )
+            {
+                CodeModel::VarRefs::const_iterator i2 = mdl->getAllImports().find(path.constData());
+                if( i2 != mdl->getAllImports().end() )
+                {
+                    foreach( SynTree* s, i2.value() )
+                        res->d_hits.append( XrefMdl::Hit( s, XrefMdl::Imp, s == d_id ) );
+                }
+            }
+            return !isStale();
         }
-    }
-    i2 = d_mdl->getAllRhs().find(name.constData());
-    if( i2 != d_mdl->getAllRhs().end() )
-    {
-        foreach( SynTree* s, i2.value() )
+
+        bool lookupFlow( MainWindow::XrefResult* res )
         {
-            QTreeWidgetItem* item = new QTreeWidgetItem(d_xrefList);
-            item->setText( 0, QString("Rhs: %1:%2:%3").arg(d_mdl->relativePath(s->d_tok.d_sourcePath))
-                                                          .arg(s->d_tok.d_lineNr).arg(s->d_tok.d_colNr) );
-            item->setToolTip( 0, item->text(0) );
-            item->setData( 0, Qt::UserRole, QVariant::fromValue(s) );
-            if( s == id )
-                item->setFont(0,bold);
-            else if( s->d_tok.d_sourcePath.constData() == d_codeView->getSourcePath().constData() )
-                nt.append(s);
+            // the defs reaching the ident and the uses they reach instead of all equal names; an LHS
+            // is always resolved, even if nothing reads it, while a builtin or an RHS the code model
+            // couldn't place falls back to name equality
+            CodeModel* mdl = d_win->d_mdl;
+            SynTree* id = const_cast<SynTree*>(d_id);
+            QList<SynTree*> defs = mdl->getDefs(id);
+            QList<SynTree*> uses = mdl->getUses(id);
+            const bool isDef = mdl->isDef(id);
+            if( !isDef && defs.isEmpty() && uses.isEmpty() )
+                return false;
+            const bool isUse = !defs.isEmpty();
+            if( isDef )
+                defs.prepend(id);
+            if( isUse )
+                uses.prepend(id);
+            // the other uses of the defs, and the other defs of the uses, e.g. a += beside the =
+            QSet<SynTree*> d = defs.toSet(), u = uses.toSet();
+            foreach( SynTree* def, defs )
+                u += mdl->getUses(def).toSet();
+            if( isStale() )
+                return false;
+            foreach( SynTree* use, uses )
+                d += mdl->getDefs(use).toSet();
+            const char* curPath = d_curPath.constData();
+            foreach( SynTree* s, d + u )
+            {
+                const quint8 kind = d.contains(s) || mdl->isModification(s) ? XrefMdl::Lhs : XrefMdl::Rhs;
+                res->d_hits.append( XrefMdl::Hit( s, kind, s == d_id ) );
+                if( s != d_id && s->d_tok.d_sourcePath.constData() == curPath )
+                    res->d_nt.append(s);
+            }
+            return true;
         }
-    }
-    if( !path.isEmpty() )
+
+        MainWindow* d_win;
+        QByteArray d_str;
+        const SynTree* d_id;
+        QByteArray d_curPath; // symbol
+        int d_gen;
+    };
+}
+
+void MainWindow::fillXrefList(const QByteArray& str, const SynTree* id )
+{
+    cancelXref();
+    d_xrefShown = id;
+    d_xrefPool->start( new XrefTask( this, str, id, d_codeView->getSourcePath(), d_xrefGen.loadAcquire() ) );
+}
+
+void MainWindow::cancelXref()
+{
+    d_xrefGen.ref(); // running tasks notice this and quit
+    d_xrefPool->clear(); // tasks not yet started are discarded
+}
+
+struct MainWindow::EvalResult
+{
+    int d_gen;
+    bool d_ok;
+    Evaluator::OutcomesByFile d_outcomes;
+    CodeBrowser::Instances d_instances;
+    EvalResult(int gen):d_gen(gen),d_ok(false){}
+};
+
+namespace Gn
+{
+    class EvalTask : public QRunnable
     {
-        i2 = d_mdl->getAllImports().find(path.constData());
-        if( i2 != d_mdl->getAllImports().end() )
+    public:
+        EvalTask( MainWindow* w, const QByteArray& args, int gen ):d_win(w),d_args(args),d_gen(gen){}
+        void run()
         {
-            foreach( SynTree* s, i2.value() )
+            if( isStale() )
+                return;
+            // the errors stay here; they would only repeat the diagnostics of a gn gen run
+            Errors errs( 0, true );
+            Evaluator eval( d_win->d_mdl, &errs );
+            {
+                // from here on cancelEvaluation() can stop this evaluation
+                QMutexLocker lock(&d_win->d_evalLock);
+                if( isStale() )
+                    return;
+                d_win->d_evalRunning = &eval;
+            }
+            eval.setArgs( d_args );
+            const bool ok = eval.evaluate();
+            QMutexLocker lock(&d_win->d_evalLock);
+            d_win->d_evalRunning = 0;
+            if( isStale() )
+                return;
+            MainWindow::EvalResult* res = new MainWindow::EvalResult(d_gen);
+            res->d_ok = ok;
+            res->d_outcomes = eval.getOutcomes();
+            // keyed by the name of the call, which is what the code browser finds at a position
+            Evaluator::ItemsByCall::const_iterator i;
+            for( i = eval.getInstances().begin(); i != eval.getInstances().end(); ++i )
             {
-                QTreeWidgetItem* item = new QTreeWidgetItem(d_xrefList);
-                item->setText( 0, QString("Imp: %1:%2:%3").arg(d_mdl->relativePath(s->d_tok.d_sourcePath))
-                                                              .arg(s->d_tok.d_lineNr).arg(s->d_tok.d_colNr) );
-                item->setToolTip( 0, item->text(0) );
-                item->setData( 0, Qt::UserRole, QVariant::fromValue(s) );
-                if( s == id )
-                    item->setFont(0,bold);
+                QByteArrayList& labels = res->d_instances[ i.key()->d_children.first() ];
+                foreach( const Evaluator::Item* item, i.value() )
+                    labels << item->d_label;
             }
+            delete d_win->d_evalRes;
+            d_win->d_evalRes = res;
+            QMetaObject::invokeMethod( d_win, "onEvalReady", Qt::QueuedConnection );
         }
+    private:
+        bool isStale() const { return d_win->d_evalGen.loadAcquire() != d_gen; }
+        MainWindow* d_win;
+        QByteArray d_args;
+        int d_gen;
+    };
+}
+
+void MainWindow::startEvaluation()
+{
+    cancelEvaluation();
+    // only a project with a dotfile can be evaluated
+    if( !QFileInfo( d_mdl->getSourceRoot().absoluteFilePath(".gn") ).isFile() )
+        return;
+    d_evalPool->start( new EvalTask( this, d_evalArgs, d_evalGen.loadAcquire() ) );
+}
+
+void MainWindow::cancelEvaluation()
+{
+    d_evalGen.ref();
+    d_evalPool->clear();
+    QMutexLocker lock(&d_evalLock);
+    if( d_evalRunning )
+        d_evalRunning->cancel();
+}
+
+void MainWindow::onEvalReady()
+{
+    d_evalLock.lock();
+    EvalResult* res = d_evalRes;
+    d_evalRes = 0;
+    d_evalLock.unlock();
+    if( res == 0 )
+        return;
+    if( res->d_gen != d_evalGen.loadAcquire() )
+    {
+        delete res;
+        return;
     }
-    d_codeView->markNonTerms(nt);
+    d_codeView->setOutcomes( res->d_outcomes );
+    d_codeView->setInstances( res->d_instances );
+    delete res;
+}
+
+void MainWindow::onSetArgs()
+{
+    bool ok;
+    const QString args = QInputDialog::getMultiLineText( this, tr("Evaluate with Args"),
+                                                         tr("Build arguments (as in args.gn):"),
+                                                         QString::fromUtf8(d_evalArgs), &ok );
+    if( !ok )
+        return;
+    d_evalArgs = args.toUtf8();
+    QSettings s;
+    s.setValue( "EvalArgs", d_evalArgs );
+    startEvaluation();
 }
 
 void MainWindow::addQueryResults(const MainWindow::Sorter& sorter)
@@ -534,15 +786,51 @@ void MainWindow::onCursorPositionChanged()
     }else
         d_sourceLoc->setText( QString("%1   %2:%3").arg(d_codeView->getSourcePath().constData()).arg(line).arg(col) );
 
-    fillXrefList( d_codeView->getCur() );
+    // the lookup is only started when the cursor rests for a moment, e.g. not while an arrow key is held
+    d_xrefPending = d_codeView->getCur();
+    if( d_xrefPending == d_xrefShown && d_xrefPending != 0 )
+        d_xrefTimer->stop();
+    else
+        d_xrefTimer->start();
 }
 
-void MainWindow::onXrefDblClicked()
+void MainWindow::onXrefTimeout()
+{
+    fillXrefList( d_xrefPending );
+}
+
+void MainWindow::onXrefReady()
 {
-    if( d_xrefList->currentItem() == 0 )
+    d_xrefLock.lock();
+    XrefResult* res = d_xrefRes;
+    d_xrefRes = 0;
+    d_xrefLock.unlock();
+    if( res == 0 )
         return;
+    if( res->d_gen != d_xrefGen.loadAcquire() )
+    {
+        delete res;
+        return;
+    }
+    if( res->d_text.isEmpty() )
+        d_xrefSearch->clear();
+    else
+        d_xrefSearch->setText( QString::fromUtf8(res->d_text) );
+    if( res->d_hits.isEmpty() )
+        d_xrefMdl->clear();
+    else
+        d_xrefMdl->setHits(res->d_hits);
+    const QModelIndex bold = d_xrefMdl->findBold();
+    if( bold.isValid() )
+        d_xrefList->scrollTo( bold );
+    if( res->d_resolved )
+        d_codeView->markNonTerms(res->d_nt);
+    delete res;
+}
 
-    SynTree* st = d_xrefList->currentItem()->data(0,Qt::UserRole).value<SynTree*>();
+void MainWindow::onXrefDblClicked()
+{
+    SynTree* st = d_xrefMdl->getSymbol( d_xrefList->currentIndex() );
     if( st == 0 )
         return;
     d_codeView->setCursorPosition( st, true, true );
@@ -617,22 +905,18 @@ void MainWindow::onFilesDblClicked()
 void MainWindow::onFileChanged(const QByteArray& path)
 {
     d_stm->setScope( d_mdl->getScope(path) );
-    d_defsList->expandAll();
-    QTreeWidgetItem* cur = 0;
-    QFont bold = d_fileList->font();
-    bold.setBold(true);
-    for( int i = 0; i < d_fileList->topLevelItemCount(); i++ )
+    d_defsList->expandToDepth(0); // deeper levels are only populated on demand
+    if( d_curFileItem )
+        d_curFileItem->setFont(0,d_fileList->font());
+    d_curFileItem = d_fileItems.value(path);
+    if( d_curFileItem )
     {
-        QTreeWidgetItem* item = d_fileList->topLevelItem(i);
-        if( item->data(0,Qt::UserRole).toByteArray() == path )
-        {
-            item->setFont(0, bold);
-            cur = item;
-        }else
-            item->setFont(0,d_fileList->font());
+        QFont bold = d_fileList->font();
+        bold.setBold(true);
+        d_curFileItem->setFont(0, bold);
     }
-    d_fileList->scrollToItem(cur);
-    d_fileList->setCurrentItem(cur);
+    d_fileList->scrollToItem(d_curFileItem);
+    d_fileList->setCurrentItem(d_curFileItem);
 }
 
 void MainWindow::onHelp()
@@ -672,6 +956,10 @@ void MainWindow::onHelp()
         d_helpView->append(tr("CTRL+L to go to a specific line in current file") );
         d_helpView->append(tr("CTRL+F to find a string in the current file") );
         d_helpView->append(tr("CTRL+G or F3 to find another match in the current file") );
+        d_helpView->append(tr("CTRL+SHIFT+F to search all files of the tree") );
+        d_helpView->append(tr("CTRL+P to go to a file, target, template or declared arg by fuzzy name") );
+        d_helpView->append(tr("CTRL+E to set the args the project is evaluated with; branches not taken are greyed out") );
+        d_helpView->append(tr("Hover over a template invocation to see the targets it generated") );
         d_helpView->append(tr("CTRL-click on the strings or idents in the source to navigate") );
         d_helpView->append(tr("ALT+LEFT to move backwards in the navigation history") );
         d_helpView->append(tr("ALT+RIGHT to move forward in the navigation history") );
@@ -805,6 +1093,138 @@ void MainWindow::onQueryDblClicked()
         fillXrefList(d_queryResults->currentItem()->data(0,Qt::UserRole).toByteArray());
 }
 
+void MainWindow::onSearchAll()
+{
+    QWidget* dock = d_searchText->parentWidget()->parentWidget();
+    dock->show();
+    dock->raise();
+    const QString sel = d_codeView->textCursor().selectedText();
+    if( !sel.isEmpty() && !sel.contains(QChar::ParagraphSeparator) )
+        d_searchText->setText(sel);
+    else if( d_codeView->getCur() && d_codeView->getCur()->d_tok.d_type == Tok_identifier )
+        d_searchText->setText( QString::fromUtf8(d_codeView->getCur()->d_tok.d_val) );
+    d_searchText->setFocus();
+    d_searchText->selectAll();
+    refreshSearchIndex(); // likely done before the query is entered
+}
+
+struct MainWindow::RefreshResult
+{
+    SearchIndex::Changes d_changes;
+};
+
+namespace Gn
+{
+    class RefreshTask : public QRunnable
+    {
+    public:
+        RefreshTask( MainWindow* w, const SearchIndex::Stamps& stamps ):d_win(w),d_stamps(stamps){}
+        void run()
+        {
+            // the file cache is thread-safe and survives a reparse of the model
+            MainWindow::RefreshResult* res = new MainWindow::RefreshResult();
+            res->d_changes = SearchIndex::findChanges( d_stamps, d_win->d_mdl->getFileCache() );
+            QMutexLocker lock(&d_win->d_refreshLock);
+            delete d_win->d_refreshRes;
+            d_win->d_refreshRes = res;
+            QMetaObject::invokeMethod( d_win, "onSearchIndexRefreshed", Qt::QueuedConnection );
+        }
+    private:
+        MainWindow* d_win;
+        SearchIndex::Stamps d_stamps;
+    };
+}
+
+void MainWindow::refreshSearchIndex()
+{
+    if( d_refreshing )
+        return;
+    d_refreshing = true;
+    d_refreshPool->start( new RefreshTask( this, d_mdl->getSearchIndex()->getStamps() ) );
+}
+
+void MainWindow::onSearchIndexRefreshed()
+{
+    d_refreshLock.lock();
+    RefreshResult* res = d_refreshRes;
+    d_refreshRes = 0;
+    d_refreshLock.unlock();
+    d_refreshing = false;
+    if( res == 0 )
+        return;
+    // files indexed again by a reparse in the meantime are skipped
+    const int updated = d_mdl->getSearchIndex()->apply( res->d_changes );
+    delete res;
+    if( updated > 0 && d_searchResults->topLevelItemCount() > 0 )
+        runSearch(); // the shown hits might be outdated
+}
+
+void MainWindow::onSearch()
+{
+    runSearch();
+    refreshSearchIndex(); // for the next query; the query doesn't wait for it
+}
+
+void MainWindow::runSearch()
+{
+    d_searchResults->clear();
+    const QString str = d_searchText->text();
+    if( str.isEmpty() )
+        return;
+
+    SearchIndex* idx = d_mdl->getSearchIndex();
+    SearchIndex::Hits hits;
+    if( d_searchRegex->isChecked() )
+    {
+        QRegularExpression re( str, d_searchCase->isChecked() ?
+                                   QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption );
+        if( !re.isValid() )
+        {
+            logMessage(tr("ERR: invalid regular expression: %1").arg(re.errorString()) );
+            return;
+        }
+        hits = idx->find( re );
+    }else
+        hits = idx->find( str.toUtf8(), d_searchCase->isChecked() );
+
+    foreach( const SearchIndex::Hit& h, hits )
+    {
+        QTreeWidgetItem* item = new QTreeWidgetItem(d_searchResults);
+        item->setText( 0, QString("%1:%2:%3: %4").arg(d_mdl->relativePath(h.d_file))
+                       .arg(h.d_line).arg(h.d_col).arg(h.d_text.trimmed()) );
+        item->setToolTip( 0, item->text(0) );
+        item->setData( 0, Qt::UserRole, h.d_file );
+        item->setData( 0, Qt::UserRole + 1, h.d_line );
+        item->setData( 0, Qt::UserRole + 2, h.d_col );
+        item->setData( 0, Qt::UserRole + 3, h.d_len );
+    }
+}
+
+void MainWindow::onSearchDblClicked()
+{
+    QTreeWidgetItem* item = d_searchResults->currentItem();
+    if( item == 0 )
+        return;
+    d_codeView->setCursorPosition( item->data(0,Qt::UserRole).toByteArray(),
+                                   item->data(0,Qt::UserRole+1).toInt() - 1,
+                                   item->data(0,Qt::UserRole+2).toInt() - 1, true );
+}
+
+void MainWindow::onGotoAnything()
+{
+    GotoDialog dlg( d_mdl, this );
+    if( dlg.exec() != QDialog::Accepted )
+        return;
+    const int entry = dlg.getSelected();
+    if( entry < 0 )
+        return;
+    const FuzzyIndex* idx = d_mdl->getFuzzyIndex();
+    if( idx->getKind(entry) == FuzzyIndex::File )
+        d_codeView->setCursorPosition( idx->getFile(entry), 0, 0, true );
+    else
+        d_codeView->setCursorPosition( idx->getSynTree(entry), true, true );
+}
+
 void MainWindow::onGotoFileLine()
 {
     bool ok	= false;
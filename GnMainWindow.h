@@ -21,10 +21,14 @@
 */
 
 #include <QMainWindow>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
 #include <GnTools/GnSynTree.h>
 
 class QPlainTextEdit;
 class QTreeWidget;
+class QTreeWidgetItem;
 class QTreeView;
 class QLabel;
 class QDir;
@@ -32,6 +36,9 @@ class QModelIndex;
 class QLineEdit;
 class QComboBox;
 class QTextBrowser;
+class QTimer;
+class QCheckBox;
+class QThreadPool;
 
 namespace Gn
 {
@@ -39,12 +46,15 @@ namespace Gn
     class CodeModel;
     class CodeBrowser;
     class HelpEngine;
+    class XrefMdl;
+    class Evaluator;
 
     class MainWindow : public QMainWindow
     {
         Q_OBJECT
     public:
         explicit MainWindow(QWidget *parent = 0);
+        ~MainWindow();
 
         void showPath(const QString& );
         void showHelp();
@@ -57,8 +67,14 @@ namespace Gn
         void createLog();
         void createHelp();
         void createQueryList();
+        void createSearch();
         void fillXrefList( const SynTree* );
         void fillXrefList( const QByteArray&, const SynTree* = 0 );
+        void cancelXref();
+        void startEvaluation();
+        void cancelEvaluation();
+        void refreshSearchIndex();
+        void runSearch();
         typedef QMap<QByteArray,const char*> Sorter;
         void addQueryResults( const Sorter& );
 
@@ -83,23 +99,68 @@ namespace Gn
         void onQuery(int);
         void onQueryDblClicked();
         void onGotoFileLine();
+        void onGotoAnything();
         void onEscape();
+        void onXrefTimeout();
+        void onXrefReady();
+        void onSearchAll();
+        void onSearch();
+        void onSearchDblClicked();
+        void onSearchIndexRefreshed();
+        void onSetArgs();
+        void onEvalReady();
 
     private:
         CodeModel* d_mdl;
         CodeBrowser* d_codeView;
         QTreeWidget* d_fileList;
+        QHash<QByteArray,QTreeWidgetItem*> d_fileItems; // source path -> item in d_fileList
+        QTreeWidgetItem* d_curFileItem;
         QLabel* d_rootDir;
         QLabel* d_sourceLoc;
         QPlainTextEdit* d_msgLog;
         QTreeView* d_defsList;
         ScopeTreeMdl* d_stm;
-        QTreeWidget* d_xrefList;
+        QTreeView* d_xrefList;
+        XrefMdl* d_xrefMdl;
         QLineEdit* d_xrefSearch;
         QTreeWidget* d_queryResults;
         QComboBox* d_queries;
         HelpEngine* d_heng;
         QTextBrowser* d_helpView;
+        QLineEdit* d_searchText;
+        QCheckBox* d_searchCase;
+        QCheckBox* d_searchRegex;
+        QTreeWidget* d_searchResults;
+
+        // xref lookups run in d_xrefPool; a result only gets applied if d_xrefGen didn't move meanwhile
+        struct XrefResult;
+        friend class XrefTask;
+        QTimer* d_xrefTimer;
+        QThreadPool* d_xrefPool;
+        QAtomicInt d_xrefGen;
+        const SynTree* d_xrefPending; // debounced cursor symbol
+        const SynTree* d_xrefShown; // symbol the xref list currently belongs to
+        QMutex d_xrefLock; // protects d_xrefRes
+        XrefResult* d_xrefRes;
+
+        // the project is evaluated in d_evalPool after parsing, for the condition outcomes shown in d_codeView
+        struct EvalResult;
+        friend class EvalTask;
+        QThreadPool* d_evalPool;
+        QAtomicInt d_evalGen;
+        QByteArray d_evalArgs; // as in args.gn
+        QMutex d_evalLock; // protects d_evalRes and d_evalRunning
+        EvalResult* d_evalRes;
+        Evaluator* d_evalRunning;
+
+        // changed files are found and read in d_refreshPool, only the index update is done here
+        struct RefreshResult;
+        friend class RefreshTask;
+        QThreadPool* d_refreshPool;
+        bool d_refreshing;
+        QMutex d_refreshLock; // protects d_refreshRes
+        RefreshResult* d_refreshRes;
     };
 }
 
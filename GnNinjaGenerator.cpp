@@ -0,0 +1,653 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnNinjaGenerator.h"
+#include "GnCodeModel.h"
+#include "GnLexer.h"
+#include <QDir>
+#include <string.h>
+using namespace Gn;
+
+static const char* s_sourceSubst[] =
+{
+    "source_file_part", "source_name_part", "source_dir", "source_out_dir", "source_gen_dir",
+    "source_root_relative_dir",
+    0
+};
+
+// set per link build statement; the other target substitutions are set per file
+static const char* s_linkSubst[] =
+{
+    "output_extension", "output_dir",
+    0
+};
+
+// the tool strings written to the rules
+static const char* s_ruleVars[] =
+{
+    "command", "description", "depfile", "deps", "rspfile", "rspfile_content",
+    0
+};
+
+NinjaGenerator::NinjaGenerator(Evaluator* e):Generator(e),d_toolchain(0)
+{
+}
+
+QByteArray NinjaGenerator::escapePath(const QByteArray& str)
+{
+    QByteArray res;
+    res.reserve( str.size() );
+    for( int i = 0; i < str.size(); i++ )
+    {
+        const char c = str[i];
+        if( c == '$' || c == ' ' || c == ':' )
+            res += '$';
+        res += c;
+    }
+    return res;
+}
+
+QByteArray NinjaGenerator::escape(const QByteArray& str)
+{
+    QByteArray res = str;
+    res.replace( '$', "$$" );
+    res.replace( '\n', ' ' );
+    return res;
+}
+
+QByteArray NinjaGenerator::shellQuote(const QByteArray& str)
+{
+    bool safe = !str.isEmpty();
+    for( int i = 0; i < str.size() && safe; i++ )
+    {
+        const char c = str[i];
+        safe = ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) ||
+                strchr( "_-+=/.,:@%{}", c ) != 0;
+    }
+    if( safe )
+        return str;
+    QByteArray res = str;
+    res.replace( "'", "'\\''" );
+    return "'" + res + "'";
+}
+
+QByteArray NinjaGenerator::toNinja(const QByteArray& pattern)
+{
+    QByteArray res;
+    res.reserve( pattern.size() );
+    int i = 0;
+    while( i < pattern.size() )
+    {
+        const int start = pattern.indexOf( "{{", i );
+        const int end = start == -1 ? -1 : pattern.indexOf( "}}", start + 2 );
+        if( end == -1 )
+        {
+            res += pattern.mid(i);
+            break;
+        }
+        res += pattern.mid( i, start - i );
+        const QByteArray name = pattern.mid( start + 2, end - start - 2 );
+        if( name == "source" || name == "inputs" )
+            res += "${in}";
+        else if( name == "output" )
+            res += "${out}";
+        else if( name == "inputs_newline" )
+            res += "${in_newline}";
+        else if( name == "response_file_name" )
+            res += "${rspfile}";
+        else
+            res += "${" + name + "}";
+        i = end + 2;
+    }
+    return res;
+}
+
+QByteArray NinjaGenerator::expand(const QByteArray& pattern, const Subst& subst)
+{
+    QByteArray res;
+    int i = 0;
+    while( i < pattern.size() )
+    {
+        const int start = pattern.indexOf( "{{", i );
+        const int end = start == -1 ? -1 : pattern.indexOf( "}}", start + 2 );
+        if( end == -1 )
+        {
+            res += pattern.mid(i);
+            break;
+        }
+        res += pattern.mid( i, start - i );
+        Subst::const_iterator v = subst.constFind( pattern.mid( start + 2, end - start - 2 ) );
+        if( v != subst.constEnd() )
+            res += v.value();
+        else
+            res += pattern.mid( start, end + 2 - start );
+        i = end + 2;
+    }
+    return res;
+}
+
+QByteArray NinjaGenerator::rel(const QByteArray& sourceAbsolute) const
+{
+    const QByteArray& build = d_eval->getBuildDir();
+    if( sourceAbsolute == build )
+        return ".";
+    if( sourceAbsolute.startsWith(build) && sourceAbsolute.size() > build.size() &&
+            sourceAbsolute[build.size()] == '/' )
+        return sourceAbsolute.mid( build.size() + 1 );
+    return QDir(d_outDir).relativeFilePath( d_eval->toFilePath(sourceAbsolute) ).toUtf8();
+}
+
+QString NinjaGenerator::ninjaFile(const Evaluator::Target* t) const
+{
+    return QDir(d_outDir).absoluteFilePath( QString::fromUtf8( rel( d_eval->outDir(t->d_dir) ) + "/" +
+                                                               t->d_name + ".ninja" ) );
+}
+
+static QByteArray canonical( const QByteArray& path )
+{
+    // like ninja sees the path, so "./foo" and "foo" are the same output
+    QByteArray res = QDir::cleanPath( QString::fromUtf8(path) ).toUtf8();
+    while( res.startsWith("./") )
+        res = res.mid(2);
+    return res;
+}
+
+QByteArray NinjaGenerator::stamp(const Evaluator::Target* t) const
+{
+    return canonical( rel( d_eval->outDir(t->d_dir) ) + "/" + t->d_name + ".stamp" );
+}
+
+const ValueScope*NinjaGenerator::tool(const QByteArray& name) const
+{
+    if( d_toolchain == 0 )
+        return 0;
+    return d_toolchain->d_tools.value(name).data();
+}
+
+QByteArray NinjaGenerator::toolString(const ValueScope* tool, const char* name) const
+{
+    const Value* v = tool ? tool->find( d_eval->getSymbol(name), false ) : 0;
+    if( v == 0 )
+        return QByteArray();
+    if( v->d_type == Value::List )
+        return v->toStringList().join(' ');
+    return v->toString();
+}
+
+QByteArray NinjaGenerator::toolForSource(const QByteArray& path)
+{
+    const QByteArray ext = path.mid( path.lastIndexOf('.') + 1 );
+    if( ext == "c" )
+        return "cc";
+    if( ext == "cc" || ext == "cpp" || ext == "cxx" || ext == "c++" )
+        return "cxx";
+    if( ext == "m" )
+        return "objc";
+    if( ext == "mm" )
+        return "objcxx";
+    if( ext == "s" || ext == "S" || ext == "asm" )
+        return "asm";
+    if( ext == "rc" )
+        return "rc";
+    return QByteArray(); // headers and other files aren't compiled
+}
+
+NinjaGenerator::Subst NinjaGenerator::sourceSubst(const QByteArray& source) const
+{
+    Subst s;
+    const QByteArray dir = Evaluator::dirOf(source);
+    const QByteArray file = source.mid( source.lastIndexOf('/') + 1 );
+    const int dot = file.lastIndexOf('.');
+    s.insert( "source", rel(source) );
+    s.insert( "source_file_part", file );
+    s.insert( "source_name_part", dot == -1 ? file : file.left(dot) );
+    s.insert( "source_dir", rel(dir) );
+    s.insert( "source_out_dir", rel( d_eval->outDir(dir) ) );
+    s.insert( "source_gen_dir", rel( d_eval->genDir(dir) ) );
+    s.insert( "source_root_relative_dir", dir.mid(2) );
+    return s;
+}
+
+NinjaGenerator::Subst NinjaGenerator::targetSubst(const Evaluator::Target* t) const
+{
+    Subst s;
+    s.insert( "root_out_dir", "." );
+    s.insert( "root_gen_dir", "gen" );
+    s.insert( "target_out_dir", rel( d_eval->outDir(t->d_dir) ) );
+    s.insert( "target_gen_dir", rel( d_eval->genDir(t->d_dir) ) );
+    s.insert( "label", t->d_label );
+    s.insert( "target_output_name", outputName( t, 0 ) );
+    return s;
+}
+
+QByteArray NinjaGenerator::outputName(const Evaluator::Target* t, const ValueScope* tool) const
+{
+    QByteArray name = t->getString(d_eval->getSymbol("output_name"));
+    if( name.isEmpty() )
+        name = t->d_name;
+    const QByteArray prefix = toolString( tool, "output_prefix" );
+    if( !name.startsWith(prefix) )
+        name = prefix + name;
+    return name;
+}
+
+static QByteArray linkTool( const QByteArray& type )
+{
+    if( type == "executable" )
+        return "link";
+    if( type == "static_library" )
+        return "alink";
+    if( type == "shared_library" )
+        return "solink";
+    if( type == "loadable_module" )
+        return "solink_module";
+    return QByteArray();
+}
+
+void NinjaGenerator::computeOutputs(int i)
+{
+    const Evaluator::Target* t = d_targets[i];
+    Info& info = d_infos[i];
+    const QByteArray type = t->d_type;
+    const Subst ts = targetSubst(t);
+    if( d_eval->isBinary(t) )
+    {
+        foreach( const QByteArray& src, d_eval->getSources(t) )
+        {
+            const ValueScope* tl = tool( toolForSource(src) );
+            if( tl == 0 )
+                continue;
+            const Value* outs = tl->find( d_eval->getSymbol("outputs"), false );
+            if( outs == 0 || outs->toStringList().isEmpty() )
+                continue;
+            Subst s = sourceSubst(src);
+            s.unite(ts);
+            info.d_objects.append( expand( outs->toStringList().first(), s ) );
+            info.d_sources.append( src );
+        }
+        QByteArray lt = linkTool(type);
+        if( lt == "solink_module" && tool(lt) == 0 )
+            lt = "solink";
+        const ValueScope* tl = tool(lt);
+        if( tl == 0 )
+        {
+            info.d_outputs.append( stamp(t) );
+            return;
+        }
+        Subst s = ts;
+        s.insert( "target_output_name", outputName( t, tl ) );
+        const Value* ext = t->d_values->find( d_eval->getSymbol("output_extension"), false );
+        if( ext && ext->d_type == Value::String )
+            s.insert( "output_extension", ext->d_str.isEmpty() ? QByteArray() : "." + ext->d_str );
+        else
+            s.insert( "output_extension", toolString( tl, "default_output_extension" ) );
+        const QByteArray outDir = t->getString(d_eval->getSymbol("output_dir"));
+        if( !outDir.isEmpty() )
+            s.insert( "output_dir", rel(outDir) );
+        else
+        {
+            const QByteArray def = toolString( tl, "default_output_dir" );
+            s.insert( "output_dir", def.isEmpty() ? QByteArray(".") : expand( def, s ) );
+        }
+        for( int k = 0; s_linkSubst[k]; k++ )
+            info.d_linkSubst.insert( s_linkSubst[k], s.value(s_linkSubst[k]) );
+        const QByteArrayList outs = toolString( tl, "outputs" ).isEmpty() ? QByteArrayList() :
+                tl->find( d_eval->getSymbol("outputs"), false )->toStringList();
+        if( outs.isEmpty() )
+            info.d_outputs.append( rel( d_eval->getBuildDir() + "/" + s.value("target_output_name") ) );
+        else
+            info.d_outputs.append( expand( outs.first(), s ) );
+    }else if( type == "action" )
+    {
+        foreach( const QByteArray& o, t->getList(d_eval->getSymbol("outputs")) )
+            info.d_outputs.append( rel(o) );
+    }else if( type == "action_foreach" || type == "copy" )
+    {
+        const QByteArrayList outs = t->getList(d_eval->getSymbol("outputs"));
+        foreach( const QByteArray& src, d_eval->getSources(t) )
+        {
+            Subst s = sourceSubst(src);
+            s.unite(ts);
+            // the substitutions are relative to the build dir already, so a pattern starting with one is too
+            foreach( const QByteArray& o, outs )
+                info.d_outputs.append( o.startsWith("{{") ? expand( o, s ) : rel( expand( o, s ) ) );
+        }
+    }else
+        info.d_outputs.append( stamp(t) );
+    for( int k = 0; k < info.d_outputs.size(); k++ )
+        info.d_outputs[k] = canonical( info.d_outputs[k] );
+    for( int k = 0; k < info.d_objects.size(); k++ )
+        info.d_objects[k] = canonical( info.d_objects[k] );
+}
+
+int NinjaGenerator::prepare()
+{
+    if( d_outDir.isEmpty() )
+        d_outDir = d_eval->toFilePath( d_eval->getBuildDir() );
+    d_targets.clear();
+    d_index.clear();
+    d_infos.clear();
+    d_toolText.clear();
+    d_toolchain = d_eval->findToolchain( d_eval->getDefaultToolchain() );
+    if( d_toolchain == 0 )
+    {
+        error( d_outDir, "no default toolchain; set_default_toolchain missing in the build config?" );
+        return 0;
+    }
+    Evaluator::Item::Tools::const_iterator i;
+    for( i = d_toolchain->d_tools.begin(); i != d_toolchain->d_tools.end(); ++i )
+    {
+        QByteArray text;
+        for( int k = 0; s_ruleVars[k]; k++ )
+            text += toolString( i.value().data(), s_ruleVars[k] ) + " ";
+        d_toolText.insert( i.key(), text );
+    }
+    foreach( const Evaluator::Target* t, d_eval->getTargets() )
+    {
+        d_index.insert( t, d_targets.size() );
+        d_targets.append(t);
+    }
+    // dependents need the outputs of their deps, so these are known before the units run
+    d_infos.resize( d_targets.size() );
+    for( int k = 0; k < d_targets.size(); k++ )
+        computeOutputs(k);
+    return d_targets.size();
+}
+
+void NinjaGenerator::linkInputs(const Evaluator::Target* t, QByteArrayList& inputs, QByteArrayList& solibs,
+                                QSet<const Evaluator::Target*>& visited) const
+{
+    // objects of source sets and static libraries are linked up to the next shared library or executable
+    TargetList link, order;
+    QSet<const Evaluator::Target*> seen;
+    collectDeps( t, link, order, seen );
+    foreach( const Evaluator::Target* d, link )
+    {
+        if( visited.contains(d) )
+            continue;
+        visited.insert(d);
+        const Info& info = d_infos.at( d_index.value(d) );
+        if( d->d_type == d_eval->getSymbol("source_set") )
+        {
+            inputs += info.d_objects;
+            linkInputs( d, inputs, solibs, visited );
+        }else if( d->d_type == d_eval->getSymbol("static_library") )
+        {
+            inputs += info.d_outputs;
+            linkInputs( d, inputs, solibs, visited );
+        }else
+            solibs += info.d_outputs;
+    }
+}
+
+static QByteArray join( const QByteArrayList& l )
+{
+    QByteArray res;
+    foreach( const QByteArray& s, l )
+        res += " " + NinjaGenerator::escapePath(s);
+    return res;
+}
+
+void NinjaGenerator::compile(QByteArray& out, const Evaluator::Target* t, const QByteArray& orderOnly)
+{
+    const Info& info = d_infos.at( d_index.value(t) );
+    for( int i = 0; i < info.d_objects.size(); i++ )
+    {
+        const QByteArray& src = info.d_sources[i];
+        const QByteArray tn = toolForSource(src);
+        out += "build " + escapePath( info.d_objects[i] ) + ": " + tn + " " + escapePath( rel(src) );
+        if( !orderOnly.isEmpty() )
+            out += " ||" + orderOnly;
+        out += "\n";
+        const QByteArray text = d_toolText.value(tn);
+        const Subst s = sourceSubst(src);
+        for( int k = 0; s_sourceSubst[k]; k++ )
+        {
+            if( text.contains( "{{" + QByteArray(s_sourceSubst[k]) + "}}" ) )
+                out += "  " + QByteArray(s_sourceSubst[k]) + " = " + escape( s.value(s_sourceSubst[k]) ) + "\n";
+        }
+    }
+}
+
+void NinjaGenerator::link(QByteArray& out, const Evaluator::Target* t, const QByteArray& orderOnly)
+{
+    const Info& info = d_infos.at( d_index.value(t) );
+    if( t->d_type == d_eval->getSymbol("source_set") || info.d_outputs.isEmpty() )
+    {
+        out += "build " + escapePath( stamp(t) ) + ": " + ( tool("stamp") ? "stamp" : "phony" ) +
+                join( info.d_objects );
+        if( !orderOnly.isEmpty() )
+            out += " ||" + orderOnly;
+        out += "\n";
+        return;
+    }
+    QByteArray tn = linkTool( t->d_type );
+    if( tn == "solink_module" && tool(tn) == 0 )
+        tn = "solink";
+    const ValueScope* tl = tool(tn);
+    if( tl == 0 )
+    {
+        out += "build " + escapePath( info.d_outputs.first() ) + ": phony" + join( info.d_objects ) + "\n";
+        return;
+    }
+    QByteArrayList inputs = info.d_objects, solibs;
+    QSet<const Evaluator::Target*> visited;
+    linkInputs( t, inputs, solibs, visited );
+    out += "build" + join( info.d_outputs ) + ": " + tn + join( inputs );
+    if( !solibs.isEmpty() )
+        out += " |" + join( solibs );
+    if( !orderOnly.isEmpty() )
+        out += " ||" + orderOnly;
+    out += "\n";
+
+    const Evaluator::Flags f = d_eval->getFlags(t);
+    QByteArray libSwitch = toolString( tl, "lib_switch" );
+    QByteArray dirSwitch = toolString( tl, "lib_dir_switch" );
+    QByteArrayList libs, flags;
+    foreach( const QByteArray& d, f.d_libDirs )
+        flags.append( shellQuote( dirSwitch + rel(d) ) );
+    foreach( const QByteArray& l, f.d_libs )
+        libs.append( shellQuote( l.startsWith("//") ? rel(l) : libSwitch + l ) );
+    foreach( const QByteArray& o, f.d_ldflags )
+        flags.append( shellQuote(o) );
+    out += "  ldflags = " + escape( flags.join(' ') ) + "\n";
+    out += "  libs = " + escape( libs.join(' ') ) + "\n";
+    out += "  solibs = " + escape( solibs.join(' ') ) + "\n";
+    out += "  target_output_name = " + escape( outputName( t, tl ) ) + "\n";
+    // e.g. "-o {{root_out_dir}}/{{target_output_name}}{{output_extension}}" has to name the declared output
+    const QByteArray text = d_toolText.value(tn);
+    for( int k = 0; s_linkSubst[k]; k++ )
+    {
+        if( text.contains( "{{" + QByteArray(s_linkSubst[k]) + "}}" ) )
+            out += "  " + QByteArray(s_linkSubst[k]) + " = " + escape( info.d_linkSubst.value(s_linkSubst[k]) ) + "\n";
+    }
+}
+
+void NinjaGenerator::action(QByteArray& out, const Evaluator::Target* t, const QByteArray& orderOnly)
+{
+    const Info& info = d_infos.at( d_index.value(t) );
+    const QByteArray rule = mangledName(t) + "_rule";
+    const QByteArray script = rel( t->getString(d_eval->getSymbol("script")) );
+    QByteArray cmd = "python3 " + shellQuote(script);
+    foreach( const QByteArray& a, t->getList(d_eval->getSymbol("args")) )
+        cmd += " " + shellQuote(a);
+    out += "rule " + rule + "\n";
+    out += "  command = " + toNinja( escape(cmd) ) + "\n";
+    out += "  description = ACTION " + escape( t->d_label ) + "\n";
+    out += "  restat = 1\n\n";
+
+    QByteArray implicit = " | " + escapePath(script) + join( rels( t->getList(d_eval->getSymbol("inputs")) ) );
+    if( !orderOnly.isEmpty() )
+        implicit += " ||" + orderOnly;
+    const QByteArrayList sources = d_eval->getSources(t);
+    if( t->d_type == d_eval->getSymbol("action") )
+    {
+        out += "build" + join( info.d_outputs ) + ": " + rule + join( rels(sources) ) + implicit + "\n";
+        return;
+    }
+    const int perSource = t->getList(d_eval->getSymbol("outputs")).size();
+    for( int i = 0; i < sources.size(); i++ )
+    {
+        out += "build" + join( info.d_outputs.mid( i * perSource, perSource ) ) + ": " + rule + " " +
+                escapePath( rel(sources[i]) ) + implicit + "\n";
+        const Subst s = sourceSubst(sources[i]);
+        for( int k = 0; s_sourceSubst[k]; k++ )
+        {
+            if( cmd.contains( "{{" + QByteArray(s_sourceSubst[k]) + "}}" ) )
+                out += "  " + QByteArray(s_sourceSubst[k]) + " = " + escape( s.value(s_sourceSubst[k]) ) + "\n";
+        }
+    }
+}
+
+void NinjaGenerator::copy(QByteArray& out, const Evaluator::Target* t, const QByteArray& orderOnly)
+{
+    const Info& info = d_infos.at( d_index.value(t) );
+    const QByteArrayList sources = d_eval->getSources(t);
+    if( tool("copy") == 0 )
+    {
+        error( ninjaFile(t), "the toolchain has no copy tool" );
+        return;
+    }
+    const int perSource = sources.isEmpty() ? 0 : info.d_outputs.size() / sources.size();
+    for( int i = 0; i < sources.size(); i++ )
+    {
+        out += "build" + join( info.d_outputs.mid( i * perSource, perSource ) ) + ": copy " +
+                escapePath( rel(sources[i]) );
+        if( !orderOnly.isEmpty() )
+            out += " ||" + orderOnly;
+        out += "\n";
+    }
+}
+
+QByteArrayList NinjaGenerator::rels(const QByteArrayList& l) const
+{
+    QByteArrayList res;
+    foreach( const QByteArray& s, l )
+        res.append( rel(s) );
+    return res;
+}
+
+void NinjaGenerator::generateUnit(int i)
+{
+    const Evaluator::Target* t = d_targets.at(i);
+    const QByteArray type = t->d_type;
+    const Subst ts = targetSubst(t);
+
+    QByteArray out;
+    out.reserve( 4096 );
+    if( d_eval->isBinary(t) )
+    {
+        const Evaluator::Flags f = d_eval->getFlags(t);
+        QByteArrayList defines, includes, cflags, cflagsC, cflagsCC, asmflags;
+        foreach( const QByteArray& d, f.d_defines )
+            defines.append( shellQuote( "-D" + d ) );
+        foreach( const QByteArray& d, f.d_includeDirs )
+            includes.append( shellQuote( "-I" + rel(d) ) );
+        foreach( const QByteArray& o, f.d_cflags )
+            cflags.append( shellQuote(o) );
+        foreach( const QByteArray& o, f.d_cflagsC )
+            cflagsC.append( shellQuote(o) );
+        foreach( const QByteArray& o, f.d_cflagsCC )
+            cflagsCC.append( shellQuote(o) );
+        foreach( const QByteArray& o, f.d_asmflags )
+            asmflags.append( shellQuote(o) );
+        out += "defines = " + escape( defines.join(' ') ) + "\n";
+        out += "include_dirs = " + escape( includes.join(' ') ) + "\n";
+        out += "cflags = " + escape( cflags.join(' ') ) + "\n";
+        out += "cflags_c = " + escape( cflagsC.join(' ') ) + "\n";
+        out += "cflags_cc = " + escape( cflagsCC.join(' ') ) + "\n";
+        out += "asmflags = " + escape( asmflags.join(' ') ) + "\n";
+    }
+    const char* vars[] = { "label", "root_out_dir", "root_gen_dir", "target_out_dir", "target_gen_dir",
+                           "target_output_name", 0 };
+    for( int k = 0; vars[k]; k++ )
+        out += QByteArray(vars[k]) + " = " + escape( ts.value(vars[k]) ) + "\n";
+    out += "\n";
+
+    // the outputs of all deps have to be there first, e.g. generated headers
+    QByteArrayList before;
+    foreach( const Evaluator::Target* d, d_eval->getDeps( t, true ) )
+        before += d_infos.at( d_index.value(d) ).d_outputs;
+    const QByteArray orderOnly = join(before);
+
+    if( d_eval->isBinary(t) )
+    {
+        compile( out, t, orderOnly );
+        link( out, t, orderOnly );
+    }else if( type == "action" || type == "action_foreach" )
+        action( out, t, orderOnly );
+    else if( type == "copy" )
+        copy( out, t, orderOnly );
+    else
+    {
+        // group and the types not supported
+        out += "build " + escapePath( stamp(t) ) + ": " + ( tool("stamp") ? "stamp" : "phony" ) + join(before) + "\n";
+    }
+    writeFile( ninjaFile(t), out );
+}
+
+void NinjaGenerator::finish()
+{
+    if( d_toolchain == 0 )
+        return;
+    const QDir dir(d_outDir);
+    const QByteArray header = "# Generated from the GN project " +
+            d_eval->getModel()->getSourceRoot().absolutePath().toUtf8() + "; do not edit\n\n";
+
+    QByteArray tc = header;
+    tc.reserve( 64 * d_targets.size() );
+    Evaluator::Item::Tools::const_iterator i;
+    for( i = d_toolchain->d_tools.begin(); i != d_toolchain->d_tools.end(); ++i )
+    {
+        tc += "rule " + i.key() + "\n";
+        for( int k = 0; s_ruleVars[k]; k++ )
+        {
+            const QByteArray v = toolString( i.value().data(), s_ruleVars[k] );
+            if( !v.isEmpty() )
+                tc += "  " + QByteArray(s_ruleVars[k]) + " = " + toNinja( escape(v) ) + "\n";
+        }
+        const Value* restat = i.value()->find( d_eval->getSymbol("restat"), false );
+        if( restat && restat->d_type == Value::Bool && restat->d_int )
+            tc += "  restat = 1\n";
+        tc += "\n";
+    }
+    foreach( const Evaluator::Target* t, d_targets )
+        tc += "subninja " + escapePath( dir.relativeFilePath( ninjaFile(t) ).toUtf8() ) + "\n";
+    writeFile( dir.absoluteFilePath("toolchain.ninja"), tc );
+
+    QByteArray build = header;
+    build += "ninja_required_version = 1.7.2\n\n";
+    build += "subninja toolchain.ninja\n\n";
+    // short names for the targets whose name is unique, like gn does
+    QHash<QByteArray,int> count;
+    foreach( const Evaluator::Target* t, d_targets )
+        count[t->d_name]++;
+    QByteArrayList all;
+    for( int k = 0; k < d_targets.size(); k++ )
+    {
+        const Evaluator::Target* t = d_targets[k];
+        all += d_infos[k].d_outputs;
+        // the outputs are canonical, so a binary linked to the build dir is named like the target
+        if( count.value(t->d_name) == 1 && !d_infos[k].d_outputs.contains( canonical(t->d_name) ) )
+            build += "build " + escapePath(t->d_name) + ": phony" + join( d_infos[k].d_outputs ) + "\n";
+    }
+    build += "\nbuild all: phony" + join(all) + "\n";
+    build += "default all\n";
+    writeFile( dir.absoluteFilePath("build.ninja"), build );
+}
@@ -0,0 +1,88 @@
+#ifndef GNNINJAGENERATOR_H
+#define GNNINJAGENERATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnGenerator.h>
+#include <QVector>
+
+/*
+ *  Writes ninja files for the default toolchain like 'gn gen' does, without needing the gn binary
+ *  - build.ninja includes toolchain.ninja, which has a rule per tool() and includes the obj/<dir>/<name>.ninja
+ *    file of each target; the output dir defaults to the build dir of the Evaluator
+ *  - Tool substitutions like {{cflags}} become ninja variables set per target; {{source}}, {{output}}
+ *    and {{inputs}} become $in and $out
+ *  - Supported are the binary target types, group, copy, action and action_foreach; other types are phony
+ *  - Each target is a unit, so the target files are written in parallel; each file is built in memory
+ *    and only written if its content changed, so ninja doesn't see spurious modification times
+*/
+
+namespace Gn
+{
+    class NinjaGenerator : public Generator
+    {
+    public:
+        explicit NinjaGenerator( Evaluator* );
+
+        static QByteArray escapePath( const QByteArray& ); // for build lines
+        static QByteArray escape( const QByteArray& ); // for variable values
+        static QByteArray shellQuote( const QByteArray& );
+    protected:
+        typedef QHash<QByteArray,QByteArray> Subst;
+        struct Info
+        {
+            QByteArrayList d_objects; // compiled by the target itself, relative to the build dir
+            QByteArrayList d_sources; // the source of each object, source absolute
+            QByteArrayList d_outputs; // the linked file, the stamp or the outputs of actions and copies
+            Subst d_linkSubst; // output_extension and output_dir of the link tool
+        };
+
+        int prepare();
+        void generateUnit( int );
+        void finish();
+        void compile( QByteArray& out, const Evaluator::Target*, const QByteArray& orderOnly );
+        void link( QByteArray& out, const Evaluator::Target*, const QByteArray& orderOnly );
+        void action( QByteArray& out, const Evaluator::Target*, const QByteArray& orderOnly );
+        void copy( QByteArray& out, const Evaluator::Target*, const QByteArray& orderOnly );
+        void linkInputs( const Evaluator::Target*, QByteArrayList& inputs, QByteArrayList& solibs,
+                         QSet<const Evaluator::Target*>& visited ) const;
+        const ValueScope* tool( const QByteArray& name ) const;
+        QByteArray toolString( const ValueScope*, const char* name ) const;
+        static QByteArray toolForSource( const QByteArray& path );
+        Subst sourceSubst( const QByteArray& source ) const;
+        Subst targetSubst( const Evaluator::Target* ) const;
+        static QByteArray expand( const QByteArray& pattern, const Subst& );
+        static QByteArray toNinja( const QByteArray& pattern ); // {{x}} -> ${x}
+        QByteArray outputName( const Evaluator::Target*, const ValueScope* tool ) const;
+        QByteArray rel( const QByteArray& sourceAbsolute ) const; // relative to the output dir
+        QByteArrayList rels( const QByteArrayList& ) const;
+        QString ninjaFile( const Evaluator::Target* ) const;
+        QByteArray stamp( const Evaluator::Target* ) const;
+        void computeOutputs( int );
+
+        const Evaluator::Toolchain* d_toolchain;
+        TargetList d_targets;
+        QHash<const Evaluator::Target*,int> d_index;
+        QVector<Info> d_infos; // parallel to d_targets
+        QHash<QByteArray,QByteArray> d_toolText; // all strings of a tool, to see which substitutions it uses
+    };
+}
+
+#endif // GNNINJAGENERATOR_H
@@ -51,7 +51,7 @@ void Parser::SemErr(const char* msg) {
 
 void Parser::Get() {
 	for (;;) {
-		d_cur = d_next;
+		qSwap( d_cur, d_next ); // d_next is overwritten anyway, so no need to copy
 		d_next = scanner->nextToken();
         bool deliverToParser = false;
         switch( d_next.d_type )
@@ -82,7 +82,7 @@ void Parser::Get() {
             }
         }
 
-		d_next = d_cur;
+		qSwap( d_cur, d_next );
 	}
 }
 
@@ -0,0 +1,324 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnQMakeGenerator.h"
+#include "GnCodeModel.h"
+#include <QDir>
+#include <QFileInfo>
+#include <ctype.h>
+using namespace Gn;
+
+QMakeGenerator::QMakeGenerator(Evaluator* e):Generator(e)
+{
+    d_project = e->getModel()->getSourceRoot().dirName().toUtf8();
+}
+
+QByteArray QMakeGenerator::quote(const QByteArray& str)
+{
+    // '$' and '#' have a meaning in qmake; values with blanks or quotes are quoted
+    QByteArray res = str;
+    res.replace( "$", "$$LITERAL_DOLLAR" );
+    res.replace( "#", "$$LITERAL_HASH" );
+    if( res.contains(' ') || res.contains('"') || res.contains('\t') )
+    {
+        res.replace( "\\", "\\\\" );
+        res.replace( "\"", "\\\"" );
+        res = "\"" + res + "\"";
+    }
+    return res;
+}
+
+static QByteArray assign( const char* var, const QByteArrayList& values, bool paths, const Evaluator* e )
+{
+    if( values.isEmpty() )
+        return QByteArray();
+    QByteArray res = QByteArray(var) + " +=";
+    foreach( const QByteArray& v, values )
+    {
+        res += " \\\n    ";
+        res += QMakeGenerator::quote( paths ? e->toFilePath(v).toUtf8() : v );
+    }
+    res += "\n";
+    return res;
+}
+
+static inline bool isSource( const QByteArray& path )
+{
+    const QByteArray ext = path.mid( path.lastIndexOf('.') + 1 );
+    return ext == "c" || ext == "cc" || ext == "cpp" || ext == "cxx" || ext == "c++" || ext == "m" || ext == "mm";
+}
+
+static inline bool isHeader( const QByteArray& path )
+{
+    const QByteArray ext = path.mid( path.lastIndexOf('.') + 1 );
+    return ext == "h" || ext == "hh" || ext == "hpp" || ext == "hxx" || ext == "inc";
+}
+
+int QMakeGenerator::prepare()
+{
+    d_targets.clear();
+    d_written.clear();
+    d_configs.clear();
+    d_targetConfigs.clear();
+    d_sharedNames.clear();
+    foreach( const Evaluator::Target* t, d_eval->getTargets() )
+    {
+        if( d_eval->isBinary(t) )
+        {
+            d_targets.append(t);
+            d_written.insert(t);
+        }
+    }
+    // all libraries go to $$GN_LIB_DIR and all executables to $$GN_BIN_DIR, where equal names would
+    // overwrite each other, and a -l of the name would be ambiguous
+    QHash<QByteArray,int> count;
+    foreach( const Evaluator::Target* t, d_targets )
+    {
+        // the mangled names are unique, but an output_name could still be the mangled name of another
+        const QByteArray mangled = mangledName(t);
+        count[ destName( t, mangled ) ]++;
+        const QByteArray name = t->getString(d_eval->getSymbol("output_name"));
+        if( !name.isEmpty() && name != mangled && t->d_type != d_eval->getSymbol("source_set") )
+            count[ destName( t, name ) ]++;
+    }
+    QHash<QByteArray,int>::const_iterator c;
+    for( c = count.begin(); c != count.end(); ++c )
+    {
+        if( c.value() > 1 )
+            d_sharedNames.insert( c.key() );
+    }
+    d_targetConfigs.resize( d_targets.size() );
+    QSet<const Evaluator::Config*> used;
+    for( int i = 0; i < d_targets.size(); i++ )
+    {
+        d_targetConfigs[i] = d_eval->getAllConfigs( d_targets[i] );
+        foreach( const Evaluator::Config* c, d_targetConfigs[i] )
+        {
+            if( !used.contains(c) )
+            {
+                used.insert(c);
+                d_configs.append(c);
+            }
+        }
+    }
+    return d_targets.size() + d_configs.size();
+}
+
+void QMakeGenerator::generateUnit(int i)
+{
+    if( i < d_targets.size() )
+        target( i );
+    else
+        config( d_configs.at( i - d_targets.size() ) );
+}
+
+QString QMakeGenerator::proFile(const Evaluator::Target* t) const
+{
+    const QByteArray name = mangledName(t);
+    const QString dir = t->d_dir == "//" ? QString() : QString::fromUtf8( t->d_dir.mid(2) ) + "/";
+    return QDir(d_outDir).absoluteFilePath( dir + QString::fromUtf8(name) + "/" + QString::fromUtf8(name) + ".pro" );
+}
+
+QString QMakeGenerator::priFile(const Evaluator::Config* c) const
+{
+    return QDir(d_outDir).absoluteFilePath( "configs/" + QString::fromUtf8( mangledName(c) ) + ".pri" );
+}
+
+QByteArray QMakeGenerator::destName(const Evaluator::Target* t, const QByteArray& name) const
+{
+    return ( t->d_type == d_eval->getSymbol("executable") ? "bin/" : "lib/" ) + name;
+}
+
+QByteArray QMakeGenerator::binaryName(const Evaluator::Target* t) const
+{
+    const QByteArray name = t->getString(d_eval->getSymbol("output_name"));
+    if( name.isEmpty() || t->d_type == d_eval->getSymbol("source_set") ||
+            d_sharedNames.contains( destName( t, name ) ) )
+        return mangledName(t);
+    return name;
+}
+
+QString QMakeGenerator::commonFile() const
+{
+    return QDir(d_outDir).absoluteFilePath( "gn_common.pri" );
+}
+
+void QMakeGenerator::values(QByteArray& out, const Evaluator::Item* i, const Evaluator* e)
+{
+    out += assign( "DEFINES", i->getList(e->getSymbol("defines")), false, e );
+    out += assign( "INCLUDEPATH", i->getList(e->getSymbol("include_dirs")), true, e );
+    const QByteArrayList cflags = i->getList(e->getSymbol("cflags"));
+    out += assign( "QMAKE_CFLAGS", cflags + i->getList(e->getSymbol("cflags_c")), false, e );
+    out += assign( "QMAKE_CXXFLAGS", cflags + i->getList(e->getSymbol("cflags_cc")), false, e );
+    out += assign( "QMAKE_LFLAGS", i->getList(e->getSymbol("ldflags")), false, e );
+    QByteArrayList libs;
+    foreach( const QByteArray& d, i->getList(e->getSymbol("lib_dirs")) )
+        libs.append( "-L" + e->toFilePath(d).toUtf8() );
+    foreach( const QByteArray& l, i->getList(e->getSymbol("libs")) )
+    {
+        if( l.startsWith("//") || l.startsWith('/') )
+            libs.append( e->toFilePath(l).toUtf8() );
+        else if( l.endsWith(".framework") )
+            libs << "-framework" << l.left( l.size() - 10 );
+        else
+            libs.append( "-l" + l );
+    }
+    out += assign( "LIBS", libs, false, e );
+}
+
+void QMakeGenerator::config(const Evaluator::Config* c)
+{
+    QByteArray out = "# " + c->d_label + "; generated, do not edit\n\n";
+    values( out, c, d_eval );
+    writeFile( priFile(c), out );
+}
+
+void QMakeGenerator::linkClosure(const Evaluator::Target* t, TargetList& res,
+                                 QSet<const Evaluator::Target*>& visited) const
+{
+    // static libraries don't carry their deps, so the final binary has to link all of them;
+    // dependents come before their deps as the linker expects
+    TargetList link, order;
+    QSet<const Evaluator::Target*> seen;
+    collectDeps( t, link, order, seen );
+    foreach( const Evaluator::Target* d, link )
+    {
+        if( visited.contains(d) )
+            continue;
+        visited.insert(d);
+        res.append(d);
+        if( d->d_type == d_eval->getSymbol("static_library") || d->d_type == d_eval->getSymbol("source_set") )
+            linkClosure( d, res, visited );
+    }
+}
+
+void QMakeGenerator::target(int index)
+{
+    const Evaluator::Target* t = d_targets.at(index);
+    const QString path = proFile(t);
+    const QDir dir = QFileInfo(path).absoluteDir();
+    const QByteArray type = t->d_type;
+
+    QByteArray out = "# " + t->d_label + "; generated, do not edit\n\n";
+    out += "include(" + quote( dir.relativeFilePath( commonFile() ).toUtf8() ) + ")\n\n";
+    if( type == "executable" )
+        out += "TEMPLATE = app\nDESTDIR = $$GN_BIN_DIR\n";
+    else
+    {
+        out += "TEMPLATE = lib\nDESTDIR = $$GN_LIB_DIR\n";
+        if( type == "static_library" || type == "source_set" )
+            out += "CONFIG += staticlib\n";
+        else if( type == "loadable_module" )
+            out += "CONFIG += plugin\n";
+    }
+    out += "TARGET = " + quote( binaryName(t) ) + "\n\n";
+
+    QByteArrayList sources, headers, other;
+    foreach( const QByteArray& s, d_eval->getSources(t) )
+    {
+        if( isSource(s) )
+            sources.append(s);
+        else if( isHeader(s) )
+            headers.append(s);
+        else
+            other.append(s);
+    }
+    out += assign( "SOURCES", sources, true, d_eval );
+    out += assign( "HEADERS", headers, true, d_eval );
+    out += assign( "OTHER_FILES", other, true, d_eval );
+    values( out, t, d_eval );
+
+    const QList<const Evaluator::Config*>& configs = d_targetConfigs.at(index);
+    if( !configs.isEmpty() )
+    {
+        out += "\n";
+        foreach( const Evaluator::Config* c, configs )
+            out += "include(" + quote( dir.relativeFilePath( priFile(c) ).toUtf8() ) + ")\n";
+    }
+
+    if( type == "executable" || type == "shared_library" || type == "loadable_module" )
+    {
+        TargetList libs;
+        QSet<const Evaluator::Target*> visited;
+        linkClosure( t, libs, visited );
+        QByteArrayList link, deps;
+        foreach( const Evaluator::Target* d, libs )
+        {
+            if( !d_written.contains(d) )
+                continue;
+            const QByteArray n = binaryName(d);
+            link.append( "-l" + n );
+            if( d->d_type != d_eval->getSymbol("shared_library") && d->d_type != d_eval->getSymbol("loadable_module") )
+                deps.append( "$$GN_LIB_DIR/$${QMAKE_PREFIX_STATICLIB}" + n + ".$${QMAKE_EXTENSION_STATICLIB}" );
+        }
+        if( !link.isEmpty() )
+        {
+            out += "\nLIBS += -L$$GN_LIB_DIR";
+            foreach( const QByteArray& l, link )
+                out += " \\\n    " + quote(l);
+            out += "\n";
+            if( !deps.isEmpty() )
+                out += "PRE_TARGETDEPS +=";
+            foreach( const QByteArray& d, deps )
+                out += " \\\n    " + d;
+            if( !deps.isEmpty() )
+                out += "\n";
+        }
+    }
+    writeFile( path, out );
+}
+
+void QMakeGenerator::finish()
+{
+    QByteArray common = "# Generated from the GN project " +
+            d_eval->getModel()->getSourceRoot().absolutePath().toUtf8() + "; do not edit\n\n";
+    common += "CONFIG -= qt\nCONFIG += c++14\n";
+    common += "GN_BIN_DIR = $$shadowed($$PWD)/bin\n";
+    common += "GN_LIB_DIR = $$shadowed($$PWD)/lib\n";
+    writeFile( commonFile(), common );
+
+    const QDir out(d_outDir);
+    QByteArray pro = "# Generated from the GN project " +
+            d_eval->getModel()->getSourceRoot().absolutePath().toUtf8() + "; do not edit\n\n";
+    pro += "TEMPLATE = subdirs\n";
+    foreach( const Evaluator::Target* t, d_targets )
+    {
+        const QByteArray name = mangledName(t);
+        pro += "\nSUBDIRS += " + name + "\n";
+        pro += name + ".file = " + quote( out.relativeFilePath( proFile(t) ).toUtf8() ) + "\n";
+        TargetList link, order;
+        QSet<const Evaluator::Target*> visited;
+        collectDeps( t, link, order, visited );
+        QByteArrayList deps;
+        foreach( const Evaluator::Target* d, link + order )
+        {
+            if( d_written.contains(d) )
+                deps.append( mangledName(d) );
+        }
+        if( !deps.isEmpty() )
+            pro += name + ".depends = " + deps.join(' ') + "\n";
+    }
+    QByteArray project = d_project;
+    for( int i = 0; i < project.size(); i++ )
+    {
+        if( !isalnum( (unsigned char)project[i] ) )
+            project[i] = '_';
+    }
+    writeFile( out.absoluteFilePath( QString::fromUtf8(project) + ".pro" ), pro );
+}
@@ -0,0 +1,71 @@
+#ifndef GNQMAKEGENERATOR_H
+#define GNQMAKEGENERATOR_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <GnTools/GnGenerator.h>
+#include <QVector>
+
+/*
+ *  Writes a qmake project for the executable, static_library, shared_library, loadable_module and
+ *  source_set targets of an Evaluator
+ *  - Each target gets its own dir with a .pro file (qmake writes one Makefile per dir); source sets
+ *    become static libraries
+ *  - Each config used by at least one target is written once to configs/<name>.pri, which the .pro
+ *    files include in the order the configs apply; only the own values of a target are in its .pro
+ *  - The top .pro is a subdirs project ordered by the deps; gn_common.pri sets the output dirs
+ *  - Static libraries and source sets are linked transitively up to the next shared library or executable
+ *  - A binary is named by its output_name, unless other targets with the same DESTDIR use the name too
+ *  - Each target and each config is a unit, so the files are written in parallel
+*/
+
+namespace Gn
+{
+    class QMakeGenerator : public Generator
+    {
+    public:
+        explicit QMakeGenerator( Evaluator* );
+        void setProjectName( const QByteArray& name ) { d_project = name; }
+
+        static QByteArray quote( const QByteArray& );
+    protected:
+        int prepare();
+        void generateUnit( int );
+        void finish();
+        void target( int );
+        void config( const Evaluator::Config* );
+        static void values( QByteArray& out, const Evaluator::Item*, const Evaluator* );
+        void linkClosure( const Evaluator::Target*, TargetList&, QSet<const Evaluator::Target*>& ) const;
+        QString proFile( const Evaluator::Target* ) const;
+        QString priFile( const Evaluator::Config* ) const;
+        QString commonFile() const;
+        QByteArray destName( const Evaluator::Target*, const QByteArray& name ) const; // e.g. "lib/foo"
+        QByteArray binaryName( const Evaluator::Target* ) const; // TARGET and -l name
+    private:
+        TargetList d_targets; // the ones written
+        QSet<const Evaluator::Target*> d_written;
+        QList<const Evaluator::Config*> d_configs; // used by at least one of d_targets
+        QVector< QList<const Evaluator::Config*> > d_targetConfigs; // parallel to d_targets
+        QSet<QByteArray> d_sharedNames; // destName()s used by more than one target
+        QByteArray d_project;
+    };
+}
+
+#endif // GNQMAKEGENERATOR_H
@@ -23,6 +23,7 @@
 #include <QPixmap>
 #include <QtDebug>
 #include <QTreeView>
+#include <algorithm>
 using namespace Gn;
 
 ScopeTreeMdl::ScopeTreeMdl(QTreeView* parent) :
@@ -39,9 +40,14 @@ QTreeView*ScopeTreeMdl::getParent() const
 void ScopeTreeMdl::setScope( CodeModel::Scope* s )
 {
     beginResetModel();
-    d_root = Slot();
+    foreach( Slot* sub, d_root.d_children )
+        delete sub;
+    d_root.d_children.clear();
+    d_root.d_fetched = false;
     d_root.d_scope = s;
-    fill(&d_root);
+    if( s == 0 )
+        d_sortKeys.clear(); // the model is parsed again, the scopes are gone
+    fill(&d_root); // only the top level
     endResetModel();
 }
 
@@ -56,7 +62,37 @@ CodeModel::Scope* ScopeTreeMdl::getSymbol(const QModelIndex& index) const
 
 QModelIndex ScopeTreeMdl::findSymbol(const CodeModel::Scope* nt)
 {
-    return findSymbol( &d_root, nt );
+    if( nt == 0 || d_root.d_scope == 0 )
+        return QModelIndex();
+    // fetch only the slots on the path from the root down to nt
+    QList<const CodeModel::Scope*> path;
+    while( nt != 0 && nt != d_root.d_scope )
+    {
+        path.prepend(nt);
+        nt = nt->d_outer;
+    }
+    if( nt == 0 )
+        return QModelIndex(); // not in this file
+    Slot* slot = &d_root;
+    QModelIndex index;
+    foreach( const CodeModel::Scope* s, path )
+    {
+        fetch( slot, index );
+        int row = -1;
+        for( int i = 0; i < slot->d_children.size(); i++ )
+        {
+            if( slot->d_children[i]->d_scope == s )
+            {
+                row = i;
+                break;
+            }
+        }
+        if( row == -1 )
+            return QModelIndex();
+        slot = slot->d_children[row];
+        index = createIndex( row, 0, slot );
+    }
+    return index;
 }
 
 QVariant ScopeTreeMdl::data(const QModelIndex& index, int role) const
@@ -133,35 +169,82 @@ Qt::ItemFlags ScopeTreeMdl::flags( const QModelIndex & index ) const
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable; //  | Qt::ItemIsDragEnabled;
 }
 
+bool ScopeTreeMdl::hasChildren(const QModelIndex& parent) const
+{
+    const Slot* s = getSlot(parent);
+    if( s->d_fetched )
+        return !s->d_children.isEmpty();
+    else
+        return s->d_scope != 0 && !s->d_scope->d_allScopes.isEmpty();
+}
+
+bool ScopeTreeMdl::canFetchMore(const QModelIndex& parent) const
+{
+    const Slot* s = getSlot(parent);
+    return !s->d_fetched && s->d_scope != 0 && !s->d_scope->d_allScopes.isEmpty();
+}
+
+void ScopeTreeMdl::fetchMore(const QModelIndex& parent)
+{
+    fetch( getSlot(parent), parent );
+}
+
+ScopeTreeMdl::Slot* ScopeTreeMdl::getSlot(const QModelIndex& index) const
+{
+    if( index.isValid() )
+    {
+        Slot* s = static_cast<Slot*>( index.internalPointer() );
+        Q_ASSERT( s != 0 );
+        return s;
+    }else
+        return const_cast<Slot*>(&d_root);
+}
+
+const QByteArray& ScopeTreeMdl::sortKey(CodeModel::Scope* s)
+{
+    QHash<const CodeModel::Scope*,QByteArray>::iterator i = d_sortKeys.find(s);
+    if( i == d_sortKeys.end() )
+        i = d_sortKeys.insert( s, ( s->d_kind + s->d_name ).toLower() );
+    return i.value();
+}
+
+typedef QPair<const QByteArray*,CodeModel::Scope*> SortEntry;
+static bool SortEntryLessThan( const SortEntry& lhs, const SortEntry& rhs )
+{
+    return *lhs.first < *rhs.first;
+}
+
 void ScopeTreeMdl::fill(ScopeTreeMdl::Slot* super)
 {
+    super->d_fetched = true;
     if( super->d_scope == 0 )
         return;
 
-    Sorter sort;
+    QVector<SortEntry> sort;
+    sort.reserve( super->d_scope->d_allScopes.size() );
     foreach( CodeModel::Scope* s, super->d_scope->d_allScopes )
-        sort.insert( ( s->d_kind + s->d_name ).toLower(), s );
-    Sorter::const_iterator i;
-    for( i = sort.begin(); i != sort.end(); ++i )
+        sort.append( SortEntry( &sortKey(s), s ) );
+    std::stable_sort( sort.begin(), sort.end(), SortEntryLessThan );
+    for( int i = 0; i < sort.size(); i++ )
     {
         Slot* s = new Slot( super );
-        s->d_scope = i.value();
-        fill( s );
+        s->d_scope = sort[i].second;
     }
 }
 
-QModelIndex ScopeTreeMdl::findSymbol(ScopeTreeMdl::Slot* slot, const CodeModel::Scope* nt) const
+void ScopeTreeMdl::fetch(ScopeTreeMdl::Slot* s, const QModelIndex& index)
 {
-    for( int i = 0; i < slot->d_children.size(); i++ )
+    if( s->d_fetched )
+        return;
+    const int count = s->d_scope ? s->d_scope->d_allScopes.size() : 0;
+    if( count == 0 )
     {
-        Slot* s = slot->d_children[i];
-        if( s->d_scope == nt )
-            return createIndex( i, 0, s );
-        QModelIndex index = findSymbol( s, nt );
-        if( index.isValid() )
-            return index;
+        s->d_fetched = true;
+        return;
     }
-    return QModelIndex();
+    beginInsertRows( index, 0, count - 1 );
+    fill( s );
+    endInsertRows();
 }
 
 
@@ -44,6 +44,9 @@ namespace Gn
         QModelIndex parent ( const QModelIndex & index ) const;
         int rowCount ( const QModelIndex & parent = QModelIndex() ) const;
         Qt::ItemFlags flags ( const QModelIndex & index ) const;
+        bool hasChildren( const QModelIndex & parent = QModelIndex() ) const;
+        bool canFetchMore( const QModelIndex & parent ) const;
+        void fetchMore( const QModelIndex & parent );
 
     private:
         struct Slot
@@ -51,13 +54,17 @@ namespace Gn
             CodeModel::Scope* d_scope;
             QList<Slot*> d_children;
             Slot* d_parent;
-            Slot(Slot* p = 0 ):d_parent(p),d_scope(0){ if( p ) p->d_children.append(this); }
+            bool d_fetched; // d_children are only created when the view asks for them
+            Slot(Slot* p = 0 ):d_parent(p),d_scope(0),d_fetched(false){ if( p ) p->d_children.append(this); }
             ~Slot() { foreach( Slot* s, d_children ) delete s; }
         };
-        typedef QMultiMap<QByteArray,CodeModel::Scope*> Sorter;
+        Slot* getSlot( const QModelIndex& ) const;
+        const QByteArray& sortKey( CodeModel::Scope* );
         void fill( Slot* );
-        QModelIndex findSymbol(Slot*, const CodeModel::Scope* nt) const;
+        void fetch( Slot*, const QModelIndex& );
         Slot d_root;
+        // lower case kind + name per scope; valid as long as the code model isn't parsed again
+        QHash<const CodeModel::Scope*,QByteArray> d_sortKeys;
     };
 }
 
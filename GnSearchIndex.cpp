@@ -0,0 +1,501 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnSearchIndex.h"
+#include "GnFileCache.h"
+#include <QRegularExpression>
+#include <QFileInfo>
+#include <QDateTime>
+#include <algorithm>
+#include <iterator>
+using namespace Gn;
+
+static inline quint32 gram( const char* p )
+{
+    return ( quint32(quint8(p[0])) << 16 ) | ( quint32(quint8(p[1])) << 8 ) | quint8(p[2]);
+}
+
+static inline bool isIdentChar( QChar c )
+{
+    return c.isLetterOrNumber() || c == QChar('_');
+}
+
+static void insertSorted( QVector<quint32>& ids, quint32 id )
+{
+    if( ids.isEmpty() || ids.last() < id )
+        ids.append(id);
+    else
+    {
+        QVector<quint32>::iterator i = std::lower_bound( ids.begin(), ids.end(), id );
+        if( i == ids.end() || *i != id )
+            ids.insert( i, id );
+    }
+}
+
+SearchIndex::SearchIndex()
+{
+}
+
+void SearchIndex::addFile(const QByteArray& path, const QByteArray& content, qint64 modified)
+{
+    quint32 id;
+    QHash<QByteArray,quint32>::const_iterator i = d_ids.constFind(path);
+    if( i != d_ids.constEnd() )
+    {
+        id = i.value();
+        unindex(id);
+    }else
+    {
+        id = d_files.size();
+        d_files.append( File() );
+        d_ids.insert( path, id );
+    }
+    File& f = d_files[id];
+    f.d_path = path;
+    f.d_content = content;
+    f.d_lower = content.toLower();
+    f.d_live = true;
+    f.d_modified = modified != -1 ? modified :
+                                    QFileInfo( QString::fromUtf8(path) ).lastModified().toMSecsSinceEpoch();
+    f.d_grams.clear();
+    collectGrams( f.d_lower, f.d_grams );
+    foreach( quint32 g, f.d_grams )
+        insertSorted( d_postings[g], id );
+}
+
+void SearchIndex::removeFile(const QByteArray& path)
+{
+    QHash<QByteArray,quint32>::iterator i = d_ids.find(path);
+    if( i == d_ids.end() )
+        return;
+    const quint32 id = i.value();
+    d_ids.erase(i);
+    unindex(id);
+    File& f = d_files[id];
+    f.d_live = false;
+    f.d_content.clear();
+    f.d_lower.clear();
+    f.d_grams.clear();
+}
+
+void SearchIndex::clear()
+{
+    d_files.clear();
+    d_ids.clear();
+    d_postings.clear();
+}
+
+SearchIndex::Stamps SearchIndex::getStamps() const
+{
+    Stamps res;
+    res.reserve( d_ids.size() );
+    QHash<QByteArray,quint32>::const_iterator i;
+    for( i = d_ids.begin(); i != d_ids.end(); ++i )
+        res.append( qMakePair( i.key(), d_files[i.value()].d_modified ) );
+    return res;
+}
+
+SearchIndex::Changes SearchIndex::findChanges(const SearchIndex::Stamps& stamps, FileCache* cache)
+{
+    Changes res;
+    typedef QPair<QByteArray,qint64> Stamp;
+    foreach( const Stamp& s, stamps )
+    {
+        const QString path = QString::fromUtf8(s.first);
+        QFileInfo info( path );
+        Change c;
+        c.d_path = s.first;
+        c.d_was = s.second;
+        if( !info.exists() )
+            c.d_removed = true;
+        else
+        {
+            c.d_modified = info.lastModified().toMSecsSinceEpoch();
+            if( c.d_modified == s.second )
+                continue;
+            bool ok;
+            c.d_content = cache->readFile( path, &ok );
+            c.d_removed = !ok;
+        }
+        res.append(c);
+    }
+    return res;
+}
+
+int SearchIndex::apply(const SearchIndex::Changes& changes)
+{
+    int res = 0;
+    foreach( const Change& c, changes )
+    {
+        QHash<QByteArray,quint32>::const_iterator i = d_ids.constFind(c.d_path);
+        if( i == d_ids.constEnd() || d_files[i.value()].d_modified != c.d_was )
+            continue;
+        if( c.d_removed )
+            removeFile( c.d_path );
+        else
+            addFile( c.d_path, c.d_content, c.d_modified );
+        res++;
+    }
+    return res;
+}
+
+int SearchIndex::refresh(FileCache* cache)
+{
+    return apply( findChanges( getStamps(), cache ) );
+}
+
+void SearchIndex::collectGrams(const QByteArray& str, SearchIndex::Grams& res)
+{
+    // trigrams never span lines since hits are reported per line
+    const char* p = str.constData();
+    const int n = str.size() - 2;
+    res.reserve( res.size() + qMax( 0, n ) );
+    for( int i = 0; i < n; i++ )
+    {
+        if( p[i+2] == '\n' || p[i+2] == '\r' )
+        {
+            i += 2;
+            continue;
+        }
+        if( p[i+1] == '\n' || p[i+1] == '\r' )
+        {
+            i += 1;
+            continue;
+        }
+        if( p[i] == '\n' || p[i] == '\r' )
+            continue;
+        res.append( gram( p + i ) );
+    }
+    std::sort( res.begin(), res.end() );
+    res.erase( std::unique( res.begin(), res.end() ), res.end() );
+}
+
+void SearchIndex::unindex(quint32 id)
+{
+    foreach( quint32 g, d_files[id].d_grams )
+    {
+        QHash<quint32,Ids>::iterator i = d_postings.find(g);
+        if( i == d_postings.end() )
+            continue;
+        Ids& ids = i.value();
+        Ids::iterator j = std::lower_bound( ids.begin(), ids.end(), id );
+        if( j != ids.end() && *j == id )
+            ids.erase(j);
+        if( ids.isEmpty() )
+            d_postings.erase(i);
+    }
+}
+
+SearchIndex::Ids SearchIndex::allFiles() const
+{
+    Ids res;
+    res.reserve( d_ids.size() );
+    for( int i = 0; i < d_files.size(); i++ )
+    {
+        if( d_files[i].d_live )
+            res.append(i);
+    }
+    return res;
+}
+
+static bool SmallerFirst( const QVector<quint32>* lhs, const QVector<quint32>* rhs )
+{
+    return lhs->size() < rhs->size();
+}
+
+SearchIndex::Ids SearchIndex::candidates(const QByteArray& lowerCase) const
+{
+    if( lowerCase.size() < 3 )
+        return allFiles();
+    Grams grams;
+    collectGrams( lowerCase, grams );
+    if( grams.isEmpty() )
+        return allFiles(); // the string consists of line breaks
+    QVector<const Ids*> lists;
+    foreach( quint32 g, grams )
+    {
+        QHash<quint32,Ids>::const_iterator i = d_postings.constFind(g);
+        if( i == d_postings.constEnd() )
+            return Ids();
+        lists.append( &i.value() );
+    }
+    // intersect starting with the shortest list, so the candidate set shrinks fastest
+    std::sort( lists.begin(), lists.end(), SmallerFirst );
+    Ids res = *lists.first();
+    for( int l = 1; l < lists.size() && !res.isEmpty(); l++ )
+    {
+        const Ids& other = *lists[l];
+        Ids tmp;
+        tmp.reserve( res.size() );
+        std::set_intersection( res.begin(), res.end(), other.begin(), other.end(), std::back_inserter(tmp) );
+        res = tmp;
+    }
+    return res;
+}
+
+qint16 SearchIndex::score(const QString& line, int col, int len)
+{
+    qint16 res = 0;
+    const int end = col + len;
+    if( ( col == 0 || !isIdentChar(line[col-1]) ) && ( end >= line.size() || !isIdentChar(line[end]) ) )
+        res += 2; // whole word
+    int i = end;
+    while( i < line.size() && line[i].isSpace() )
+        i++;
+    if( i < line.size() && ( line[i] == QChar('(') ||
+                             ( line[i] == QChar('=') && ( i + 1 >= line.size() || line[i+1] != QChar('=') ) ) ||
+                             ( line[i] == QChar('+') && i + 1 < line.size() && line[i+1] == QChar('=') ) ) )
+        res += 2; // assignment or call
+    i = 0;
+    while( i < line.size() && line[i].isSpace() )
+        i++;
+    if( i < line.size() && line[i] == QChar('#') )
+        res -= 2; // comment
+    return res;
+}
+
+static bool HitLessThan( const SearchIndex::Hit& lhs, const SearchIndex::Hit& rhs )
+{
+    if( lhs.d_score != rhs.d_score )
+        return lhs.d_score > rhs.d_score;
+    if( lhs.d_file != rhs.d_file )
+        return lhs.d_file < rhs.d_file;
+    if( lhs.d_line != rhs.d_line )
+        return lhs.d_line < rhs.d_line;
+    return lhs.d_col < rhs.d_col;
+}
+
+void SearchIndex::offer(SearchIndex::Hits& heap, const SearchIndex::Hit& h, int maxHits)
+{
+    // the front of the heap is the worst hit kept so far
+    if( heap.size() < maxHits )
+    {
+        heap.append(h);
+        std::push_heap( heap.begin(), heap.end(), HitLessThan );
+    }else if( HitLessThan( h, heap.first() ) )
+    {
+        std::pop_heap( heap.begin(), heap.end(), HitLessThan );
+        heap.last() = h;
+        std::push_heap( heap.begin(), heap.end(), HitLessThan );
+    }
+}
+
+void SearchIndex::sort(SearchIndex::Hits& heap)
+{
+    std::sort_heap( heap.begin(), heap.end(), HitLessThan );
+}
+
+SearchIndex::Hits SearchIndex::find(const QByteArray& str, bool caseSensitive, int maxHits) const
+{
+    Hits res;
+    if( str.isEmpty() || maxHits <= 0 )
+        return res;
+    const QByteArray lower = str.toLower();
+    const QByteArray& needle = caseSensitive ? str : lower;
+    const Ids ids = candidates(lower);
+    foreach( quint32 id, ids )
+    {
+        const File& f = d_files[id];
+        const QByteArray& hay = caseSensitive ? f.d_content : f.d_lower;
+        int pos = hay.indexOf(needle);
+        int lineStart = 0;
+        quint32 lineNr = 1;
+        int lastLine = -1;
+        while( pos != -1 )
+        {
+            for( int i = lineStart; i < pos; i++ )
+            {
+                if( hay[i] == '\n' )
+                {
+                    lineNr++;
+                    lineStart = i + 1;
+                }
+            }
+            int lineEnd = hay.indexOf( '\n', pos );
+            if( lineEnd == -1 )
+                lineEnd = hay.size();
+            if( lineEnd < pos + needle.size() )
+            {
+                // the needle contains a line break, which a line based hit can't show
+                pos = hay.indexOf( needle, pos + 1 );
+                continue;
+            }
+            Hit h;
+            h.d_file = f.d_path;
+            h.d_line = lineNr;
+            const QByteArray line = f.d_content.mid( lineStart, lineEnd - lineStart );
+            h.d_text = QString::fromUtf8(line);
+            h.d_col = QString::fromUtf8( line.constData(), pos - lineStart ).size() + 1;
+            h.d_len = QString::fromUtf8( f.d_content.constData() + pos, needle.size() ).size();
+            h.d_score = score( h.d_text, h.d_col - 1, h.d_len );
+            if( !caseSensitive && f.d_content.mid( pos, str.size() ) == str )
+                h.d_score += 4;
+            if( int(lineNr) == lastLine )
+                h.d_score -= 1; // prefer the first hit of a line
+            lastLine = lineNr;
+            offer( res, h, maxHits );
+            pos = hay.indexOf( needle, pos + needle.size() );
+        }
+    }
+    sort( res );
+    return res;
+}
+
+SearchIndex::Hits SearchIndex::find(const QRegularExpression& re, int maxHits) const
+{
+    Hits res;
+    if( !re.isValid() || re.pattern().isEmpty() || maxHits <= 0 )
+        return res;
+    const QByteArray literal = requiredLiteral( re.pattern() );
+    const Ids ids = literal.size() >= 3 ? candidates( literal.toLower() ) : allFiles();
+    foreach( quint32 id, ids )
+    {
+        const File& f = d_files[id];
+        const QString text = QString::fromUtf8(f.d_content);
+        QRegularExpressionMatchIterator i = re.globalMatch(text);
+        int lineStart = 0;
+        quint32 lineNr = 1;
+        while( i.hasNext() )
+        {
+            const QRegularExpressionMatch m = i.next();
+            const int pos = m.capturedStart();
+            if( m.capturedLength() == 0 )
+                continue;
+            for( int j = lineStart; j < pos; j++ )
+            {
+                if( text[j] == QChar('\n') )
+                {
+                    lineNr++;
+                    lineStart = j + 1;
+                }
+            }
+            int lineEnd = text.indexOf( QChar('\n'), pos );
+            if( lineEnd == -1 )
+                lineEnd = text.size();
+            Hit h;
+            h.d_file = f.d_path;
+            h.d_line = lineNr;
+            h.d_text = text.mid( lineStart, lineEnd - lineStart );
+            h.d_col = pos - lineStart + 1;
+            h.d_len = qMin( m.capturedLength(), lineEnd - pos );
+            h.d_score = score( h.d_text, h.d_col - 1, h.d_len );
+            offer( res, h, maxHits );
+        }
+    }
+    sort( res );
+    return res;
+}
+
+QByteArray SearchIndex::requiredLiteral(const QString& pattern)
+{
+    // longest run of characters each match must contain; conservative, i.e. groups, classes and
+    // optional characters interrupt a run, alternatives disable the narrowing altogether
+    if( pattern.contains(QChar('|')) )
+        return QByteArray();
+    QString best, cur;
+    const int n = pattern.size();
+    for( int i = 0; i < n; i++ )
+    {
+        const QChar c = pattern[i];
+        QChar lit;
+        switch( c.unicode() )
+        {
+        case '\\':
+            if( i + 1 < n && !pattern[i+1].isLetterOrNumber() )
+                lit = pattern[++i];
+            else
+            {
+                i++; // \d, \w, back references etc.
+                if( cur.size() > best.size() )
+                    best = cur;
+                cur.clear();
+                continue;
+            }
+            break;
+        case '[':
+            {
+                i++;
+                if( i < n && pattern[i] == QChar('^') )
+                    i++;
+                if( i < n && pattern[i] == QChar(']') )
+                    i++;
+                while( i < n && pattern[i] != QChar(']') )
+                {
+                    if( pattern[i] == QChar('\\') )
+                        i++;
+                    i++;
+                }
+            }
+            if( cur.size() > best.size() )
+                best = cur;
+            cur.clear();
+            continue;
+        case '(':
+            {
+                int depth = 1;
+                i++;
+                while( i < n && depth > 0 )
+                {
+                    if( pattern[i] == QChar('\\') )
+                        i++;
+                    else if( pattern[i] == QChar('(') )
+                        depth++;
+                    else if( pattern[i] == QChar(')') )
+                        depth--;
+                    i++;
+                }
+                i--;
+            }
+            if( cur.size() > best.size() )
+                best = cur;
+            cur.clear();
+            continue;
+        case '*':
+        case '?':
+        case '{':
+            if( !cur.isEmpty() )
+                cur.chop(1); // the previous character is optional
+            if( c == QChar('{') )
+            {
+                while( i < n && pattern[i] != QChar('}') )
+                    i++;
+            }
+            if( cur.size() > best.size() )
+                best = cur;
+            cur.clear();
+            continue;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+        case ')':
+            if( cur.size() > best.size() )
+                best = cur;
+            cur.clear();
+            continue;
+        default:
+            lit = c;
+            break;
+        }
+        cur += lit;
+    }
+    if( cur.size() > best.size() )
+        best = cur;
+    return best.toUtf8();
+}
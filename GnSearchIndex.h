@@ -0,0 +1,115 @@
+#ifndef GNSEARCHINDEX_H
+#define GNSEARCHINDEX_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN parser library.
+*
+* The following is the license that applies to this copy of the
+* library. For a license to use the library under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QPair>
+
+class QRegularExpression;
+
+/*
+ *  Full-text search over the contents of all parsed files
+ *  - Trigram index: each case folded three byte sequence of a line maps to the sorted ids of
+ *    the files containing it; a query only visits the files which contain all its trigrams
+ *  - Substring queries are verified in the candidate files, regular expressions are narrowed
+ *    by the longest literal they require (if any)
+ *  - Files can be added again or removed at any time; refresh() re-reads changed files, or
+ *    findChanges() does in the background and apply() updates the index afterwards
+ *  - Hits are ranked: exact case, whole word and assignment/call sites first; all matches are ranked,
+ *    a heap keeps the best maxHits of them
+*/
+
+namespace Gn
+{
+    class FileCache;
+
+    class SearchIndex
+    {
+    public:
+        struct Hit
+        {
+            QByteArray d_file;
+            quint32 d_line;   // starts with 1
+            quint16 d_col;    // character position in d_text, starts with 1
+            quint16 d_len;    // characters
+            qint16 d_score;
+            QString d_text;   // the line
+            Hit():d_line(0),d_col(0),d_len(0),d_score(0){}
+        };
+        typedef QList<Hit> Hits;
+        enum { MaxHits = 2000 };
+        typedef QList<QPair<QByteArray,qint64> > Stamps; // path, modification time as indexed
+        struct Change
+        {
+            QByteArray d_path;
+            QByteArray d_content;
+            qint64 d_was;      // modification time as indexed
+            qint64 d_modified; // on disk
+            bool d_removed;
+            Change():d_was(0),d_modified(0),d_removed(false){}
+        };
+        typedef QList<Change> Changes;
+
+        SearchIndex();
+
+        void addFile( const QByteArray& path, const QByteArray& content, qint64 modified = -1 );
+        void removeFile( const QByteArray& path );
+        void clear();
+        Stamps getStamps() const;
+        static Changes findChanges( const Stamps&, FileCache* ); // doesn't touch the index
+        int apply( const Changes& ); // skips files indexed again meanwhile
+        int refresh( FileCache* ); // returns the number of files updated or removed
+        int getFileCount() const { return d_ids.size(); }
+
+        Hits find( const QByteArray& str, bool caseSensitive = false, int maxHits = MaxHits ) const;
+        Hits find( const QRegularExpression&, int maxHits = MaxHits ) const;
+
+        static QByteArray requiredLiteral( const QString& pattern );
+    protected:
+        typedef QVector<quint32> Grams;
+        typedef QVector<quint32> Ids;
+        static void collectGrams( const QByteArray& lowerCase, Grams& );
+        void unindex( quint32 id );
+        Ids candidates( const QByteArray& lowerCase ) const;
+        Ids allFiles() const;
+        static qint16 score( const QString& line, int col, int len );
+        static void offer( Hits& heap, const Hit&, int maxHits );
+        static void sort( Hits& heap );
+    private:
+        struct File
+        {
+            QByteArray d_path;
+            QByteArray d_content;
+            QByteArray d_lower; // d_content case folded, same offsets
+            Grams d_grams; // sorted, unique
+            qint64 d_modified; // msecs since epoch
+            bool d_live;
+            File():d_modified(0),d_live(false){}
+        };
+        QVector<File> d_files;
+        QHash<QByteArray,quint32> d_ids; // path -> index in d_files, only live files
+        QHash<quint32,Ids> d_postings; // trigram -> sorted ids of live files
+    };
+}
+
+#endif // GNSEARCHINDEX_H
@@ -5,6 +5,7 @@ using namespace Gn;
 SynTree::SynTree(quint16 r, const Token& t ):d_tok(r){
 	d_tok.d_lineNr = t.d_lineNr;
 	d_tok.d_colNr = t.d_colNr;
+	d_tok.d_offset = t.d_offset;
 	d_tok.d_sourcePath = t.d_sourcePath;
 }
 
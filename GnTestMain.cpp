@@ -24,11 +24,33 @@
 #include <QDir>
 #include <QElapsedTimer>
 #include <QThread>
+#include <QScopedPointer>
 #include "GnErrors.h"
 #include "GnParser.h"
 #include "GnCodeModel.h"
+#include "GnFormatter.h"
+#include "GnDiagnostics.h"
+#include "GnEvaluator.h"
+#include "GnCMakeGenerator.h"
+#include "GnQMakeGenerator.h"
+#include "GnNinjaGenerator.h"
+#include "GnCompDbGenerator.h"
+#include "GnConfigurations.h"
+#include <stdio.h>
+#include <algorithm>
 
 static bool s_dumpTree = false;
+static bool s_timing = false;
+static bool s_format = false;
+static bool s_writeBack = false;
+static qint64 s_parseTime = 0; // nanoseconds spent in RunParser
+static Gn::DiagnosticsWriter* s_diag = 0;
+static QString s_gen; // generator to run on the evaluated project: "cmake", "qmake", "ninja" or "compdb"
+static QString s_outDir;
+static QByteArray s_args; // as in args.gn
+static QByteArray s_diffArgs; // of a second configuration to be compared with the one of s_args
+static bool s_toolchains = false; // also evaluate the toolchains other than the default one
+static bool s_instances = false; // list the targets generated by each template invocation
 
 static QStringList collectFiles( const QDir& dir )
 {
@@ -77,6 +99,144 @@ static void lexerTest( const QString& path )
     }
 }
 
+static bool formatsStable( const QString& path )
+{
+    // formatting the formatted text again must not change it
+    QFile in( path );
+    if( !in.open(QIODevice::ReadOnly) )
+        return false;
+    QByteArray once, twice;
+    Gn::Formatter f;
+    if( !f.format( in.readAll(), once, path ) || !f.format( once, twice, path ) )
+        return false;
+    if( once != twice )
+    {
+        qCritical() << "formatting is not idempotent for" << path;
+        const QByteArray d = Gn::Formatter::diff( once, twice, path );
+        fwrite( d.constData(), 1, d.size(), stdout );
+        return false;
+    }
+    return true;
+}
+
+static void instances( const Gn::Evaluator* eval )
+{
+    // sorted by file and line of the invocation
+    QMap<QByteArray,QByteArrayList> lines;
+    Gn::Evaluator::ItemsByCall::const_iterator i;
+    for( i = eval->getInstances().begin(); i != eval->getInstances().end(); ++i )
+    {
+        const Gn::SynTree* call = i.key();
+        QByteArrayList labels;
+        foreach( const Gn::Evaluator::Item* item, i.value() )
+            labels << item->d_label;
+        lines[call->d_tok.d_sourcePath].append( QByteArray::number(call->d_tok.d_lineNr).rightJustified(6) + " " +
+                call->d_children.first()->d_tok.d_val + ": " + labels.join(' ') + "\n" );
+    }
+    QMap<QByteArray,QByteArrayList>::iterator j;
+    for( j = lines.begin(); j != lines.end(); ++j )
+    {
+        std::sort( j.value().begin(), j.value().end() );
+        const QByteArray out = j.key() + "\n" + j.value().join();
+        fwrite( out.constData(), 1, out.size(), stdout );
+    }
+    fflush( stdout );
+}
+
+static int generate( Gn::CodeModel* mdl )
+{
+    Gn::Evaluator eval( mdl );
+    eval.setArgs( s_args );
+    QElapsedTimer t;
+    t.start();
+    if( !eval.evaluate() )
+        qWarning() << "evaluation reported errors";
+    if( s_toolchains )
+    {
+        if( !eval.evaluateToolchains() )
+            qWarning() << "evaluation of the toolchains reported errors";
+        QList<Gn::Evaluator*> passes;
+        passes << &eval << eval.getPasses();
+        foreach( const Gn::Evaluator* p, passes )
+        {
+            const Gn::Evaluator::Memory m = p->getMemory();
+            qDebug() << "toolchain" << p->getToolchain().constData() << ":" << p->getTargets().size() <<
+                        "targets," << ( m.d_bytes / 1024 ) << "KiB in" << m.d_scopes << "scopes and" <<
+                        m.d_values << "values";
+        }
+    }
+    const qint64 evalTime = t.restart();
+    if( s_instances )
+        instances( &eval );
+    if( s_gen.isEmpty() )
+        return 0; // only the toolchains or instances were asked for
+    QScopedPointer<Gn::Generator> gen;
+    if( s_gen == "cmake" )
+        gen.reset( new Gn::CMakeGenerator( &eval ) );
+    else if( s_gen == "qmake" )
+        gen.reset( new Gn::QMakeGenerator( &eval ) );
+    else if( s_gen == "ninja" )
+        gen.reset( new Gn::NinjaGenerator( &eval ) );
+    else if( s_gen == "compdb" )
+        gen.reset( new Gn::CompDbGenerator( &eval ) );
+    else
+    {
+        qCritical() << "unknown generator" << s_gen;
+        return -1;
+    }
+    if( !s_outDir.isEmpty() )
+        gen->setOutputDir( s_outDir );
+    else if( s_gen != "ninja" && s_gen != "compdb" ) // these go to the build dir by default
+        gen->setOutputDir( QDir::current().absoluteFilePath("out") );
+    const bool ok = gen->generate();
+    const Gn::Generator::Stats st = gen->getStats();
+    qDebug() << "evaluated" << eval.getTargets().size() << "targets in" << evalTime << "ms, generated in" <<
+                t.elapsed() << "ms:" << st.d_written << "files written," << st.d_unchanged << "unchanged," <<
+                st.d_failed << "failed";
+    return ok ? 0 : 1;
+}
+
+static int diff( Gn::CodeModel* mdl )
+{
+    Gn::Configurations cfgs( mdl );
+    const int a = cfgs.add( "a", s_args );
+    const int b = cfgs.add( "b", s_diffArgs );
+    if( !cfgs.evaluate() )
+        qWarning() << "evaluation reported errors";
+    const Gn::Configurations::Differences diffs = cfgs.diff( a, b );
+    foreach( const Gn::Configurations::Difference& d, diffs )
+    {
+        QByteArray line = d.d_label;
+        if( !d.d_name.isEmpty() )
+            line += "." + d.d_name;
+        switch( d.d_kind )
+        {
+        case Gn::Configurations::Difference::OnlyInA:
+            line = "- " + line;
+            if( !d.d_name.isEmpty() )
+                line += " = " + d.d_a.toString(true);
+            break;
+        case Gn::Configurations::Difference::OnlyInB:
+            line = "+ " + line;
+            if( !d.d_name.isEmpty() )
+                line += " = " + d.d_b.toString(true);
+            break;
+        default:
+            line = "! " + line + " = " + d.d_a.toString(true) + " -> " + d.d_b.toString(true);
+            break;
+        }
+        line += "\n";
+        fwrite( line.constData(), 1, line.size(), stdout );
+    }
+    fflush( stdout );
+    const Gn::ImportCache::Stats st = cfgs.getCache().getStats();
+    qDebug() << "evaluated in" << cfgs.getConfig(a).d_ms << "and" << cfgs.getConfig(b).d_ms << "ms;" <<
+                diffs.size() << "differences; import cache:" << st.d_entries << "entries," << st.d_hits <<
+                "hits," << st.d_misses << "misses; instances:" << st.d_instances << "entries," <<
+                st.d_instanceHits << "hits," << st.d_instanceMisses << "misses";
+    return 0;
+}
+
 static void dumpTree( Gn::SynTree* node, int level = 0)
 {
     QByteArray str;
@@ -118,14 +278,18 @@ static void parserTest( const QString& path )
         return;
     }
     Gn::Errors e;
-    e.setReportToConsole(true);
+    e.setReportToConsole(s_diag == 0);
+    e.setWriter(s_diag);
     Gn::Lexer lex;
     lex.setIgnoreComments(false);
     lex.setPackComments(true);
     lex.setStream( &in, path );
     lex.setErrors(&e);
     Gn::Parser p(&lex,&e);
+    QElapsedTimer t;
+    t.start();
     p.RunParser();
+    s_parseTime += t.nsecsElapsed();
     if( e.getErrCount() == 0 )
         qDebug() << "OK";
     else
@@ -140,13 +304,36 @@ int main(int argc, char *argv[])
 
     QString dirOrFilePath;
     bool isProject = false;
+    int diagFormat = -1;
     const QStringList args = QCoreApplication::arguments();
     for( int i = 1; i < args.size(); i++ ) // arg 0 enthaelt Anwendungspfad
     {
         if( args[i].startsWith( "-p" ) )
             isProject = true;
+        else if( args[i].startsWith( "-diff=" ) )
+            s_diffArgs = args[i].mid(6).toUtf8();
         else if( args[i].startsWith( "-d") )
             s_dumpTree = true;
+        else if( args[i] == "-instances" )
+            s_instances = true;
+        else if( args[i] == "-toolchains" )
+            s_toolchains = true;
+        else if( args[i].startsWith( "-t") )
+            s_timing = true;
+        else if( args[i].startsWith( "-f") )
+            s_format = true;
+        else if( args[i].startsWith( "-w") )
+            s_format = s_writeBack = true;
+        else if( args[i].startsWith( "-gen=" ) )
+            s_gen = args[i].mid(5);
+        else if( args[i].startsWith( "-out=" ) )
+            s_outDir = args[i].mid(5);
+        else if( args[i].startsWith( "-args=" ) )
+            s_args = args[i].mid(6).toUtf8();
+        else if( args[i] == "-jsonl" )
+            diagFormat = Gn::DiagnosticsWriter::JsonLines;
+        else if( args[i] == "-sarif" )
+            diagFormat = Gn::DiagnosticsWriter::Sarif;
         else if( !args[ i ].startsWith( '-' ) )
         {
             dirOrFilePath = args[ i ];
@@ -162,15 +349,42 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    QFile out;
+    QScopedPointer<Gn::DiagnosticsWriter> diag;
+    if( diagFormat >= 0 )
+    {
+        // diagnostics go to stdout, everything else to the Qt message handler (stderr)
+        out.open( stdout, QIODevice::WriteOnly );
+        diag.reset( new Gn::DiagnosticsWriter( &out, Gn::DiagnosticsWriter::Format(diagFormat) ) );
+        s_diag = diag.data();
+    }
+
     QStringList files;
     QFileInfo info(dirOrFilePath);
     if( isProject )
     {
         Gn::CodeModel mdl;
-        if( info.isDir() )
-            mdl.parseDir(info.absoluteFilePath());
-        else
-            mdl.parseDir(info.absoluteDir());
+        mdl.getErrs()->setReportToConsole(s_diag == 0);
+        mdl.getErrs()->setWriter(s_diag);
+        const QDir dir = info.isDir() ? QDir(info.absoluteFilePath()) : info.absoluteDir();
+        QElapsedTimer t;
+        t.start();
+        mdl.parseDir(dir);
+        if( s_timing )
+        {
+            const qint64 first = t.restart();
+            // the second run shows what the file cache saves
+            mdl.parseDir(dir);
+            const qint64 second = t.elapsed();
+            const Gn::FileCache::Stats st = mdl.getFileCache()->getStats();
+            qDebug() << "parsed project in" << first << "ms, again in" << second << "ms; file cache:" <<
+                        st.d_files << "files," << ( st.d_bytes / 1024 ) << "KiB," << st.d_hits << "hits," <<
+                        st.d_misses << "misses," << st.d_reloads << "reloads," << st.d_evictions << "evictions";
+        }
+        if( !s_diffArgs.isEmpty() )
+            return diff( &mdl );
+        if( !s_gen.isEmpty() || s_toolchains || s_instances )
+            return generate( &mdl );
     }else
     {
         if( info.isDir() )
@@ -178,11 +392,40 @@ int main(int argc, char *argv[])
         else
             files << dirOrFilePath;
 
+        if( s_format )
+        {
+            Gn::Errors e;
+            e.setReportToConsole(true);
+            QElapsedTimer t;
+            t.start();
+            const Gn::Formatter::Results res = Gn::Formatter::formatFiles( files, s_writeBack, &e );
+            const qint64 ms = t.elapsed();
+            int changed = 0, failed = 0;
+            foreach( const Gn::Formatter::Result& r, res )
+            {
+                if( !r.d_ok )
+                    failed++;
+                else if( r.d_changed )
+                {
+                    changed++;
+                    fwrite( r.d_diff.constData(), 1, r.d_diff.size(), stdout );
+                    if( !s_writeBack && !formatsStable( r.d_path ) )
+                        failed++;
+                }
+            }
+            fflush( stdout );
+            qDebug() << "formatted" << files.size() << "files in" << ms << "ms," << changed <<
+                        ( s_writeBack ? "rewritten," : "need formatting," ) << failed << "failed";
+            return ( changed != 0 && !s_writeBack ) || failed != 0 ? 1 : 0;
+        }
+
         foreach( const QString& path, files )
         {
             //lexerTest( path );
             parserTest( path );
         }
+        if( s_timing )
+            qDebug() << "parsed" << files.size() << "files in" << ( s_parseTime / 1000000 ) << "ms";
     }
 
     return 0 ;
@@ -38,10 +38,11 @@ namespace Gn
 #endif
         quint32 d_lineNr;
         quint16 d_colNr, d_len;
+        quint32 d_offset;       // byte offset in source; fills the alignment gap, so Token doesn't grow
         QByteArray d_val;       // string address unique for identifiers
         QByteArray d_sourcePath; // UTF8, string address unique
         Token(quint16 t = Tok_Invalid, quint32 line = 0, quint16 col = 0, quint16 len = 0, const QByteArray& val = QByteArray() ):
-            d_type(t),d_lineNr(line),d_colNr(col),d_len(len),d_val(val){}
+            d_type(t),d_lineNr(line),d_colNr(col),d_len(len),d_offset(0),d_val(val){}
         bool isValid() const;
         bool isEof() const;
         const char* getName() const;
@@ -32,7 +32,9 @@ SOURCES += \
     GnMainWindow.cpp \
     GnCodeBrowser.cpp \
     GnScopeTreeMdl.cpp \
-    GnHelpEngine.cpp
+    GnHelpEngine.cpp \
+    GnXrefMdl.cpp \
+    GnGotoDialog.cpp
 
 include( Gn.pri )
 
@@ -49,7 +51,10 @@ HEADERS += \
     GnMainWindow.h \
     GnCodeBrowser.h \
     GnScopeTreeMdl.h \
-    GnHelpEngine.h
+    GnHelpEngine.h \
+    GnXrefMdl.h \
+    GnGotoDialog.h \
+    GnHelpIndex.h
 
 RESOURCES += \
     GnViewer.qrc
@@ -0,0 +1,221 @@
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN Viewer application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "GnXrefMdl.h"
+#include "GnCodeModel.h"
+#include "GnSynTree.h"
+#include <QFont>
+#include <QBrush>
+#include <QTreeView>
+#include <QHash>
+#include <algorithm>
+#include <string.h>
+using namespace Gn;
+
+static const char* s_kindName[] = { "Def", "Ref", "Lhs", "Rhs", "Imp" };
+
+XrefMdl::XrefMdl(CodeModel* mdl, QTreeView* parent) :
+    QAbstractListModel(parent),d_mdl(mdl)
+{
+    Q_ASSERT( mdl != 0 );
+}
+
+void XrefMdl::clear()
+{
+    if( d_rows.isEmpty() )
+        return;
+    beginResetModel();
+    d_hits.clear();
+    d_groups.clear();
+    d_rows.clear();
+    endResetModel();
+}
+
+static bool HitLessThan( const XrefMdl::Hit& lhs, const XrefMdl::Hit& rhs )
+{
+    return lhs.d_st->d_tok.d_lineNr < rhs.d_st->d_tok.d_lineNr ||
+            ( lhs.d_st->d_tok.d_lineNr == rhs.d_st->d_tok.d_lineNr &&
+              lhs.d_st->d_tok.d_colNr < rhs.d_st->d_tok.d_colNr );
+}
+
+static bool GroupLessThan( const QPair<const char*,int>& lhs, const QPair<const char*,int>& rhs )
+{
+    return ::strcmp( lhs.first, rhs.first ) < 0;
+}
+
+void XrefMdl::setHits(const XrefMdl::Hits& hits)
+{
+    beginResetModel();
+    d_hits.clear();
+    d_groups.clear();
+    d_rows.clear();
+
+    // bucket by source path symbol, so the paths are compared once per file, not once per hit
+    QHash<const char*,int> bucketOf;
+    QVector<Hits> buckets;
+    foreach( const Hit& h, hits )
+    {
+        const char* file = h.d_st->d_tok.d_sourcePath.constData();
+        QHash<const char*,int>::const_iterator i = bucketOf.constFind(file);
+        int b;
+        if( i == bucketOf.constEnd() )
+        {
+            b = buckets.size();
+            bucketOf.insert( file, b );
+            buckets.append( Hits() );
+        }else
+            b = i.value();
+        buckets[b].append(h);
+    }
+    QList< QPair<const char*,int> > order;
+    for( QHash<const char*,int>::const_iterator i = bucketOf.begin(); i != bucketOf.end(); ++i )
+        order.append( qMakePair( i.key(), i.value() ) );
+    std::sort( order.begin(), order.end(), GroupLessThan );
+
+    d_hits.reserve( hits.size() );
+    d_groups.reserve( order.size() );
+    d_rows.reserve( hits.size() + order.size() );
+    for( int i = 0; i < order.size(); i++ )
+    {
+        Hits& b = buckets[order[i].second];
+        std::stable_sort( b.begin(), b.end(), HitLessThan );
+        Group g;
+        g.d_file = order[i].first;
+        g.d_first = d_hits.size();
+        g.d_count = b.size();
+        d_rows.append( ~qint32(d_groups.size()) );
+        d_groups.append(g);
+        for( int j = 0; j < b.size(); j++ )
+        {
+            d_rows.append( d_hits.size() );
+            d_hits.append( b[j] );
+        }
+    }
+    endResetModel();
+}
+
+SynTree* XrefMdl::getSymbol(const QModelIndex& index) const
+{
+    if( !index.isValid() || index.row() >= d_rows.size() )
+        return 0;
+    const qint32 r = d_rows[index.row()];
+    if( r < 0 )
+        return 0;
+    return d_hits[r].d_st;
+}
+
+QModelIndex XrefMdl::findBold() const
+{
+    for( int i = 0; i < d_rows.size(); i++ )
+    {
+        if( d_rows[i] >= 0 && d_hits[d_rows[i]].d_bold )
+            return createIndex( i, 0 );
+    }
+    return QModelIndex();
+}
+
+const QByteArray& XrefMdl::fetchLine(int hit) const
+{
+    // the last group starting at or before the hit
+    int lo = 0, hi = d_groups.size() - 1;
+    while( lo < hi )
+    {
+        const int mid = ( lo + hi + 1 ) / 2;
+        if( d_groups[mid].d_first <= hit )
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    const Group& g = d_groups[lo];
+    if( g.d_lines.isEmpty() )
+    {
+        // one lookup in the file cache for all hits of the file, not one per painted row
+        QList<int> lines;
+        for( int i = 0; i < g.d_count; i++ )
+            lines << d_hits[g.d_first + i].d_st->d_tok.d_lineNr;
+        g.d_lines = d_mdl->getFileCache()->fetchTextLines( QString::fromUtf8(g.d_file), lines );
+    }
+    return g.d_lines[hit - g.d_first];
+}
+
+QVariant XrefMdl::data(const QModelIndex& index, int role) const
+{
+    if( !index.isValid() || index.row() >= d_rows.size() )
+        return QVariant();
+
+    const qint32 r = d_rows[index.row()];
+    if( r < 0 )
+    {
+        const Group& g = d_groups[~r];
+        switch( role )
+        {
+        case Qt::DisplayRole:
+        case Qt::ToolTipRole:
+            if( g.d_name.isEmpty() )
+                g.d_name = d_mdl->relativePath( g.d_file );
+            return QString("%1 (%2)").arg(g.d_name).arg(g.d_count);
+        case Qt::FontRole:
+            {
+                QFont f = static_cast<QTreeView*>(QObject::parent())->font();
+                f.setItalic(true);
+                return f;
+            }
+        case Qt::ForegroundRole:
+            return QBrush(Qt::darkGray);
+        }
+        return QVariant();
+    }
+
+    const Hit& h = d_hits[r];
+    switch( role )
+    {
+    case Qt::DisplayRole:
+        {
+            const QByteArray& line = fetchLine(r);
+            return QString("    %1: %2:%3   %4").arg(s_kindName[h.d_kind])
+                .arg(h.d_st->d_tok.d_lineNr).arg(h.d_st->d_tok.d_colNr).arg(QString::fromUtf8(line.trimmed()));
+        }
+    case Qt::ToolTipRole:
+        return QString("%1: %2:%3:%4").arg(s_kindName[h.d_kind]).arg(d_mdl->relativePath(h.d_st->d_tok.d_sourcePath))
+                .arg(h.d_st->d_tok.d_lineNr).arg(h.d_st->d_tok.d_colNr);
+    case Qt::FontRole:
+        if( h.d_bold )
+        {
+            QFont f = static_cast<QTreeView*>(QObject::parent())->font();
+            f.setBold(true);
+            return f;
+        }
+        break;
+    }
+    return QVariant();
+}
+
+int XrefMdl::rowCount(const QModelIndex& parent) const
+{
+    if( parent.isValid() )
+        return 0;
+    return d_rows.size();
+}
+
+Qt::ItemFlags XrefMdl::flags(const QModelIndex& index) const
+{
+    if( index.isValid() && index.row() < d_rows.size() && d_rows[index.row()] < 0 )
+        return Qt::ItemIsEnabled;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
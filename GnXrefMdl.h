@@ -0,0 +1,78 @@
+#ifndef GnXrefMdl_H
+#define GnXrefMdl_H
+
+/*
+* Copyright 2019 Rochus Keller <mailto:me@rochus-keller.ch>
+*
+* This file is part of the GN Viewer application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.ch.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QByteArrayList>
+
+class QTreeView;
+
+namespace Gn
+{
+    class CodeModel;
+    class SynTree;
+
+    // Flat list of cross references grouped by file; a file header row precedes the hits of each file.
+    // Texts are only formatted when the view asks for a visible row.
+    class XrefMdl : public QAbstractListModel
+    {
+    public:
+        enum Kind { Def, Ref, Lhs, Rhs, Imp };
+        struct Hit
+        {
+            SynTree* d_st;
+            quint8 d_kind;
+            bool d_bold;
+            Hit(SynTree* st = 0, quint8 kind = Ref, bool bold = false):d_st(st),d_kind(kind),d_bold(bold){}
+        };
+        typedef QVector<Hit> Hits;
+
+        explicit XrefMdl(CodeModel*, QTreeView *parent = 0);
+
+        void clear();
+        void setHits( const Hits& ); // takes the hits in any order
+        SynTree* getSymbol( const QModelIndex & ) const;
+        QModelIndex findBold() const;
+        int getHitCount() const { return d_hits.size(); }
+
+        // overrides
+        QVariant data ( const QModelIndex & index, int role = Qt::DisplayRole ) const;
+        int rowCount ( const QModelIndex & parent = QModelIndex() ) const;
+        Qt::ItemFlags flags ( const QModelIndex & index ) const;
+
+    private:
+        struct Group
+        {
+            const char* d_file; // symbol
+            int d_first, d_count; // range in d_hits
+            mutable QString d_name; // relative path, computed on first display
+            mutable QByteArrayList d_lines; // of the hits, fetched together on first display of one of them
+        };
+        const QByteArray& fetchLine( int hit ) const;
+        CodeModel* d_mdl;
+        Hits d_hits; // sorted by file, line, col
+        QVector<Group> d_groups;
+        QVector<qint32> d_rows; // per row index into d_hits or ~index into d_groups
+    };
+}
+
+#endif // GnXrefMdl_H